@@ -12,17 +12,59 @@ CONFIG += c++17
 
 SOURCES += \
     Installwizard.cpp \
+    chrootsession.cpp \
+    commandrunner.cpp \
+    configtransaction.cpp \
+    goldenimagecache.cpp \
+    hardwareprobe.cpp \
     installerworker.cpp \
+    installjournal.cpp \
+    installscheduler.cpp \
+    installtrace.cpp \
+    isoimage.cpp \
+    linesplitter.cpp \
+    mirrorranker.cpp \
+    mounttable.cpp \
+    offlinerepository.cpp \
+    packageplan.cpp \
+    packageprefetcher.cpp \
+    processexecutor.cpp \
+    processreactor.cpp \
+    remoteiso.cpp \
     splashwindow.cpp \
+    squashfsextractor.cpp \
     systemworker.cpp \
+    targetconfig.cpp \
+    tarstream.cpp \
     main.cpp
 
 HEADERS += \
     Installwizard.h \
+    chrootsession.h \
+    commandrunner.h \
+    configtransaction.h \
+    goldenimagecache.h \
+    hardwareprobe.h \
     installerworker.h \
+    installjournal.h \
+    installscheduler.h \
+    installtrace.h \
+    isoimage.h \
+    linesplitter.h \
     main.h \
+    mirrorranker.h \
+    mounttable.h \
+    offlinerepository.h \
+    packageplan.h \
+    packageprefetcher.h \
+    processexecutor.h \
+    processreactor.h \
+    remoteiso.h \
     splashwindow.h \
-    systemworker.h
+    squashfsextractor.h \
+    systemworker.h \
+    targetconfig.h \
+    tarstream.h
 
 FORMS += \
     Installwizard.ui
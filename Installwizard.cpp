@@ -2,8 +2,15 @@
 #include "systemworker.h"
 #include "ui_Installwizard.h"
 #include "installerworker.h"
+#include "goldenimagecache.h"
+#include "hardwareprobe.h"
+#include "installtrace.h"
+#include "packageplan.h"
+#include "packageprefetcher.h"
+#include "remoteiso.h"
 #include <QMessageBox>
 #include <QThread>
+#include <QTimer>
 #include <QProcess>
 #include <QDir>
 #include <QFile>
@@ -22,6 +29,25 @@
 #include <QJsonArray>
 #include <QComboBox>
 
+// Firmware for this machine; ARCHAID_FIRMWARE=portable installs all of it,
+// for targets that will boot elsewhere
+static QStringList firmwareSelection()
+{
+    return HardwareProbe::packages(qEnvironmentVariable("ARCHAID_FIRMWARE") == "portable");
+}
+
+// Where SystemWorker looks for the installation source: the full ISO, or
+// just its root filesystem image
+static QString isoDownloadPath()
+{
+    return QDir::tempPath() + "/archlinux.iso";
+}
+
+static QString rootfsDownloadPath()
+{
+    return QDir::tempPath() + "/airootfs.sfs";
+}
+
 Installwizard::Installwizard(QWidget *parent)
     : QWizard(parent), ui(new Ui::Installwizard)
 {
@@ -35,7 +61,7 @@ Installwizard::Installwizard(QWidget *parent)
     // Connect Download button: use existing ISO if present, otherwise download.
     // Uses your existing downloadISO(...) and installDependencies() implementations.
     connect(ui->downloadButton, &QPushButton::clicked, this, [this]() {
-        const QString isoPath = QDir::tempPath() + "/archlinux.iso";  // same path used by downloadISO()
+        const QString isoPath = QFileInfo::exists(isoDownloadPath()) ? isoDownloadPath() : rootfsDownloadPath();
 
         if (QFileInfo::exists(isoPath)) {
             QMessageBox msg(this);
@@ -71,10 +97,14 @@ Installwizard::Installwizard(QWidget *parent)
             // else: fall through → user chose “Download new”
         }
 
-        // No ISO present, or user chose to replace → use your existing downloader.
-        // It already updates ui->progressBar, shows the success popup,
-        // and calls installDependencies() afterwards. No extra code needed.
-        downloadISO(ui->progressBar);
+        // No ISO present, or user chose to replace. Both downloaders update
+        // ui->progressBar, show the success popup and call
+        // installDependencies() afterwards. ARCHAID_PARTIAL_ISO=0 always
+        // fetches the whole image.
+        if (qEnvironmentVariable("ARCHAID_PARTIAL_ISO") == "0")
+            downloadISO(ui->progressBar);
+        else
+            fetchRootfsImage(ui->progressBar);
     });
 
 
@@ -107,6 +137,18 @@ Installwizard::Installwizard(QWidget *parent)
         }
     });
 
+    // Prefetch the chosen desktop once the selection has settled for a moment
+    desktopPrefetchTimer_ = new QTimer(this);
+    desktopPrefetchTimer_->setSingleShot(true);
+    desktopPrefetchTimer_->setInterval(1500);
+    connect(desktopPrefetchTimer_, &QTimer::timeout, this, [this]() {
+        const QString desktop = ui->comboDesktopEnvironment->currentText();
+        if (depsOk_ && !PackagePlan::isNoDesktop(desktop))
+            startPrefetch(PackagePlan::desktopPackages(desktop));
+    });
+    connect(ui->comboDesktopEnvironment, &QComboBox::currentTextChanged, desktopPrefetchTimer_,
+            qOverload<>(&QTimer::start));
+
     // Connect install button
     connect(ui->installButton, &QPushButton::clicked, this, &Installwizard::on_installButton_clicked);
 
@@ -147,9 +189,40 @@ connect(ui->createPartButton, &QPushButton::clicked, this, [this]() {
 }
 
 Installwizard::~Installwizard() {
+    if (prefetchThread_) {
+        prefetcher_->stop();
+        prefetchThread_->quit();
+        prefetchThread_->wait();
+    }
+    if (remoteIsoThread_) {
+        remoteIso_->stop();
+        remoteIsoThread_->quit();
+        remoteIsoThread_->wait();
+    }
     delete ui;
 }
 
+// Queues packages for the background prefetcher, starting it on first use
+void Installwizard::startPrefetch(const QStringList &packages)
+{
+    if (!qEnvironmentVariableIsEmpty("ARCHAID_OFFLINE_REPO"))
+        return;   // nothing may touch the network
+    if (!prefetchThread_) {
+        prefetchThread_ = new QThread(this);
+        prefetcher_ = new PackagePrefetcher;
+        prefetcher_->moveToThread(prefetchThread_);
+        connect(prefetcher_, &PackagePrefetcher::logMessage, this, &Installwizard::appendLog);
+        connect(prefetchThread_, &QThread::finished, prefetcher_, &QObject::deleteLater);
+        prefetchThread_->start();
+    }
+
+    PackagePrefetcher *prefetcher = prefetcher_;
+    const QString mirror = customMirrorUrl;
+    QMetaObject::invokeMethod(prefetcher, [prefetcher, packages, mirror]() {
+        prefetcher->prefetch(packages, mirror);
+    }, Qt::QueuedConnection);
+}
+
 
 
 QString Installwizard::getCustomMirrorUrl() const {
@@ -225,6 +298,9 @@ void Installwizard::runDependenciesInstall(const QStringList &packages, const QS
     depsOk_ = true;
     appendLog("✔️ Dependencies installed/verified. You can click Next.");
 
+    // Start downloading the base system while the user partitions
+    startPrefetch(PackagePlan(QString(), firmwareSelection()).packages());
+
     if (currentId() == 0) setWizardButtonEnabled(QWizard::NextButton, true);
 }
 
@@ -269,6 +345,8 @@ void Installwizard::onDependenciesCheckFinished(bool ok)
     depsOk_ = ok;
     if (!ok) {
         appendLog("Dependencies not satisfied. Next disabled.");
+    } else {
+        startPrefetch(PackagePlan(QString(), firmwareSelection()).packages());
     }
     // Only enable the Page 1 Next button; others remain gated by their own flags.
     if (currentId() == 0) {
@@ -482,26 +560,89 @@ void Installwizard::setWizardButtonEnabled(QWizard::WizardButton which, bool ena
         btn->setEnabled(enabled);
 }
 
-void Installwizard::downloadISO(QProgressBar *progressBar) {
-    QNetworkAccessManager *networkManager = new QNetworkAccessManager(this);
+// ARCHAID_ISO_URL names the image directly (e.g. one served locally);
+// otherwise it comes from the mirror field
+QString Installwizard::isoUrl() const
+{
+    const QString fromEnv = qEnvironmentVariable("ARCHAID_ISO_URL");
+    if (!fromEnv.isEmpty())
+        return fromEnv;
 
-    // Get mirror URL from wizard field
     QString mirrorUrl = getCustomMirrorUrl();
-    QString isoUrl;
-
     if (!mirrorUrl.isEmpty()) {
         if (!mirrorUrl.endsWith("/"))
             mirrorUrl += "/";
-        isoUrl = mirrorUrl + "iso/latest/archlinux-x86_64.iso";
-    } else {
-        isoUrl = "https://mirror.csclub.uwaterloo.ca/archlinux/iso/latest/archlinux-x86_64.iso";
+        return mirrorUrl + "iso/latest/archlinux-x86_64.iso";
     }
+    return "https://mirror.csclub.uwaterloo.ca/archlinux/iso/latest/archlinux-x86_64.iso";
+}
+
+void Installwizard::fetchRootfsImage(QProgressBar *progressBar)
+{
+    if (!remoteIsoThread_) {
+        remoteIsoThread_ = new QThread(this);
+        remoteIso_ = new RemoteIso;
+        remoteIso_->moveToThread(remoteIsoThread_);
+        // ARCHAID_ISO_SEGMENTS=<n> parallel range requests for the image
+        bool segmentsOk = false;
+        const int segments = qEnvironmentVariableIntValue("ARCHAID_ISO_SEGMENTS", &segmentsOk);
+        if (segmentsOk && segments > 0)
+            remoteIso_->setSegments(segments);
+        connect(remoteIso_, &RemoteIso::logMessage, this, &Installwizard::appendLog);
+        connect(remoteIsoThread_, &QThread::finished, remoteIso_, &QObject::deleteLater);
+        remoteIsoThread_->start();
+    }
+
+    // Connections last for this fetch only
+    auto *context = new QObject(this);
+    connect(remoteIso_, &RemoteIso::progress, context, [progressBar](qint64 received, qint64 total) {
+        if (total > 0)
+            progressBar->setValue(static_cast<int>((received * 100) / total));
+    });
+    const QString url = isoUrl();
+    const qint64 fetchStart = InstallTrace::now();
+    connect(remoteIso_, &RemoteIso::finished, context,
+            [this, context, progressBar, url, fetchStart](bool ok, const QString &error) {
+        context->deleteLater();
+        QJsonObject traceArgs;
+        traceArgs.insert(QStringLiteral("url"), url);
+        traceArgs.insert(QStringLiteral("bytes"), QFileInfo(rootfsDownloadPath()).size());
+        traceArgs.insert(QStringLiteral("ok"), ok);
+        InstallTrace::record(QStringLiteral("download"), QStringLiteral("rootfs image download"),
+                             fetchStart, InstallTrace::now(), traceArgs);
+        if (!ok) {
+            appendLog("Fetching only the root filesystem failed (" + error + "); downloading the whole ISO.");
+            downloadISO(progressBar);
+            return;
+        }
+        // An older full ISO would be picked over the new image
+        QFile::remove(isoDownloadPath());
+        progressBar->setValue(100);
+        QMessageBox::information(
+            this, "Success",
+            "Arch Linux root filesystem downloaded successfully\nto: " + rootfsDownloadPath() +
+                " \nNext is Installing dependencies and extracting it...");
+        installDependencies();
+    });
+
+    appendLog(QString("Fetching the root filesystem from %1").arg(url));
+    RemoteIso *remote = remoteIso_;
+    const QString destination = rootfsDownloadPath();
+    QMetaObject::invokeMethod(remote, [remote, url, destination]() {
+        remote->fetch(QUrl(url), QStringLiteral("arch/x86_64/airootfs.sfs"), destination);
+    }, Qt::QueuedConnection);
+}
+
+void Installwizard::downloadISO(QProgressBar *progressBar) {
+    QNetworkAccessManager *networkManager = new QNetworkAccessManager(this);
 
+    const QString isoUrl = this->isoUrl();
     QUrl url(isoUrl);
     QNetworkRequest request(url);
     QNetworkReply *reply = networkManager->get(request);
+    const qint64 downloadStart = InstallTrace::now();
 
-    QString finalIsoPath = QDir::tempPath() + "/archlinux.iso";
+    QString finalIsoPath = isoDownloadPath();
     QFile *file = new QFile(finalIsoPath);
 
     if (!file->open(QIODevice::WriteOnly)) {
@@ -530,7 +671,13 @@ void Installwizard::downloadISO(QProgressBar *progressBar) {
 
     connect(
         reply, &QNetworkReply::finished, this,
-        [this, file, reply, finalIsoPath]() {
+        [this, file, reply, finalIsoPath, isoUrl, downloadStart]() {
+            QJsonObject traceArgs;
+            traceArgs.insert(QStringLiteral("url"), isoUrl);
+            traceArgs.insert(QStringLiteral("bytes"), file->size());
+            traceArgs.insert(QStringLiteral("ok"), reply->error() == QNetworkReply::NoError);
+            InstallTrace::record(QStringLiteral("download"), QStringLiteral("ISO download"),
+                                 downloadStart, InstallTrace::now(), traceArgs);
             file->close();
 
             if (reply->error() == QNetworkReply::NoError) {
@@ -538,6 +685,7 @@ void Installwizard::downloadISO(QProgressBar *progressBar) {
                 QFile::setPermissions(finalIsoPath,
                                       QFile::ReadOwner | QFile::WriteOwner |
                                           QFile::ReadGroup | QFile::ReadOther);
+                QFile::remove(rootfsDownloadPath());
 
                 QMessageBox::information(
                     this, "Success",
@@ -900,6 +1048,48 @@ void Installwizard::on_installButton_clicked() {
         desktopEnv,
         efiInstall // true if EFI install, else legacy
         );
+    // ARCHAID_JOBS=1 forces the old strictly sequential order
+    bool jobsOk = false;
+    const int jobs = qEnvironmentVariableIntValue("ARCHAID_JOBS", &jobsOk);
+    if (jobsOk && jobs > 0)
+        worker->setParallelJobs(jobs);
+    worker->setCustomMirrorUrl(customMirrorUrl);
+    worker->setFirmwarePackages(firmwareSelection());
+    // ARCHAID_SYNC_WINDOW=<minutes> how long a sync-database snapshot is reused
+    bool windowOk = false;
+    const int syncWindow = qEnvironmentVariableIntValue("ARCHAID_SYNC_WINDOW", &windowOk);
+    if (windowOk && syncWindow >= 0)
+        worker->setSyncSnapshotWindow(syncWindow);
+    // ARCHAID_GOLDEN_CACHE=<dir> moves the golden image cache, =0 turns it off
+    const QString goldenCache = qEnvironmentVariable("ARCHAID_GOLDEN_CACHE");
+    if (goldenCache != "0")
+        worker->setGoldenImageCache(goldenCache.isEmpty() ? GoldenImageCache::defaultDir() : goldenCache);
+    // ARCHAID_HOST_CACHE=0 keeps the install away from the host's pacman cache
+    worker->setReuseHostCache(qEnvironmentVariable("ARCHAID_HOST_CACHE") != "0");
+    // ARCHAID_NO_FSYNC=1 trades crash safety of the target for speed
+    worker->setSuppressFsync(qEnvironmentVariableIntValue("ARCHAID_NO_FSYNC") != 0);
+    // ARCHAID_OFFLINE_REPO=<dir> installs from a local repository only;
+    // ARCHAID_OFFLINE_SOURCES (colon-separated) lists package directories to
+    // add to it first, defaulting to the host and prefetch caches
+    const QString offlineRepo = qEnvironmentVariable("ARCHAID_OFFLINE_REPO");
+    if (!offlineRepo.isEmpty()) {
+        QStringList sources = qEnvironmentVariable("ARCHAID_OFFLINE_SOURCES").split(':', Qt::SkipEmptyParts);
+        if (sources.isEmpty()) {
+            for (const QString &dir : {QStringLiteral("/var/cache/pacman/pkg"), PackagePrefetcher::cacheDir()}) {
+                if (QDir(dir).exists())
+                    sources << dir;
+            }
+        }
+        worker->setOfflineRepository(offlineRepo, sources);
+    }
+    if (prefetcher_) {
+        worker->addPackageCache(PackagePrefetcher::cacheDir());
+        // Direct: stop() is thread-safe, and the prefetch must give way
+        // before the target's pacman starts downloading the same files
+        PackagePrefetcher *prefetcher = prefetcher_;
+        connect(worker, &SystemWorker::packageTransactionStarting, prefetcher_,
+                [prefetcher]() { prefetcher->stop(); }, Qt::DirectConnection);
+    }
 
     setWizardButtonEnabled(QWizard::FinishButton, false); // can't finish until install completes
 
@@ -914,6 +1104,15 @@ void Installwizard::on_installButton_clicked() {
     connect(worker, &SystemWorker::errorOccurred, this, [this](const QString &msg) {
         QMessageBox::critical(this, "Error", msg);
     });
+    // Only the rootfs extraction reports progress; the file count is
+    // inferred from unsquashfs's percentage
+    connect(worker, &SystemWorker::extractionProgress, this,
+            [this](int percent, quint32 estimatedFilesDone, quint32 filesTotal) {
+        ui->installProgressBar->setVisible(true);
+        ui->installProgressBar->setFormat(QString("Extracting: %p% (~%1 of %2 files)")
+                                              .arg(estimatedFilesDone).arg(filesTotal));
+        ui->installProgressBar->setValue(percent);
+    });
     connect(worker, &SystemWorker::finished, this, [this]() {
         appendLog("✔️ Installation complete.");
         setWizardButtonEnabled(QWizard::FinishButton, true);
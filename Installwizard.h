@@ -6,6 +6,11 @@
 #include <QStringList>
 #include "installerworker.h"
 
+class PackagePrefetcher;
+class RemoteIso;
+class QThread;
+class QTimer;
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class Installwizard;
@@ -49,6 +54,11 @@ private:
     QString getUserHome();
     void populateDrives(); // Populate the dropdown with available drives
     void downloadISO(QProgressBar *progressBar);
+    QString isoUrl() const;
+    // Only airootfs.sfs, with range requests; falls back to downloadISO()
+    void fetchRootfsImage(QProgressBar *progressBar);
+    RemoteIso *remoteIso_ = nullptr;
+    QThread *remoteIsoThread_ = nullptr;
     void on_installButton_clicked();
     void unmountDrive(const QString &drive);
     // Declare the methods that were missing
@@ -64,5 +74,11 @@ private:
     void mountStandardPartitions(const QString &drive);
     void onPartitionSelected(const QModelIndex &index);
     QString targetPartition;
+
+    // Background download of the predicted package set (pages 2 and 3)
+    void startPrefetch(const QStringList &packages);
+    PackagePrefetcher *prefetcher_ = nullptr;
+    QThread *prefetchThread_ = nullptr;
+    QTimer *desktopPrefetchTimer_ = nullptr;
 };
 #endif // INSTALLWIZARD_H
@@ -0,0 +1,275 @@
+#include "chrootsession.h"
+#include "installtrace.h"
+#include "processexecutor.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <cstring>
+#include <signal.h>
+#include <unistd.h>
+
+ChrootSession::ChrootSession(const QString &root, MountMode mode) : m_root(root), m_mode(mode)
+{
+    // Scratch file (inside the target's /tmp) used when a caller wants
+    // stderr kept apart from stdout
+    static QAtomicInt counter;
+    m_stderrScratch = QStringLiteral("/tmp/.archaid-session-stderr-%1").arg(counter.fetchAndAddRelaxed(1));
+}
+
+ChrootSession::~ChrootSession()
+{
+    close();
+}
+
+bool ChrootSession::isOpen() const
+{
+    return m_shell != 0 && m_reactor.isRunning(m_shell);
+}
+
+// Same set of API filesystems arch-chroot(8) prepares, attached only once.
+bool ChrootSession::mountApiFilesystems(QString *error)
+{
+    InstallTrace::Span span(QStringLiteral("mount"), QStringLiteral("mount API filesystems"));
+    struct ApiMount {
+        QString source;
+        QString target;
+        QStringList options;
+        bool optional;
+    };
+
+    const QList<ApiMount> mounts = {
+        {"proc",    "/proc",                     {"-t", "proc", "-o", "nosuid,noexec,nodev"}, false},
+        {"sys",     "/sys",                      {"-t", "sysfs", "-o", "nosuid,noexec,nodev,ro"}, false},
+        {"efivarfs","/sys/firmware/efi/efivars", {"-t", "efivarfs", "-o", "nosuid,noexec,nodev"}, true},
+        {"udev",    "/dev",                      {"-t", "devtmpfs", "-o", "mode=0755,nosuid"}, false},
+        {"devpts",  "/dev/pts",                  {"-t", "devpts", "-o", "mode=0620,gid=5,nosuid,noexec"}, false},
+        {"shm",     "/dev/shm",                  {"-t", "tmpfs", "-o", "mode=1777,nosuid,nodev"}, false},
+        {"/run",    "/run",                      {"--bind", "--make-private"}, false},
+        {"tmp",     "/tmp",                      {"-t", "tmpfs", "-o", "mode=1777,strictatime,nodev,nosuid"}, false},
+    };
+
+    for (const ApiMount &m : mounts) {
+        const QString target = m_root + m.target;
+        if (m.optional && !QFileInfo(target).isDir())
+            continue;
+        QDir().mkpath(target);
+
+        QStringList args = m.options;
+        args << m.source << target;
+        if (ProcessExecutor::run(QStringList{"mount"} + args, nullptr).exitCode != 0) {
+            if (m.optional)
+                continue;
+            if (error)
+                *error = QStringLiteral("Failed to mount %1 for the chroot session.").arg(target);
+            unmountApiFilesystems();
+            return false;
+        }
+        m_mounted.append(target);
+    }
+    return true;
+}
+
+void ChrootSession::unmountApiFilesystems()
+{
+    if (m_mounted.isEmpty())
+        return;
+    InstallTrace::Span span(QStringLiteral("mount"), QStringLiteral("unmount API filesystems"));
+    // Reverse order so nested mounts (dev/pts, dev/shm) go before /dev
+    while (!m_mounted.isEmpty()) {
+        const QString target = m_mounted.takeLast();
+        if (ProcessExecutor::run({"umount", target}, nullptr).exitCode != 0)
+            ProcessExecutor::run({"umount", "-l", target}, nullptr);
+    }
+}
+
+bool ChrootSession::open(QString *error)
+{
+    if (isOpen())
+        return true;
+
+    if (!QFileInfo::exists(m_root + "/bin/bash")) {
+        if (error)
+            *error = QStringLiteral("%1 does not contain a usable /bin/bash.").arg(m_root);
+        return false;
+    }
+
+    if (m_mode == OwnMounts && !mountApiFilesystems(error))
+        return false;
+
+    // Minimal, non-login environment: nothing from /etc/profile gets sourced
+    // per command. libstdbuf (what stdbuf(1) preloads) keeps child output
+    // line-buffered for the whole session instead of wrapping each command.
+    QStringList env = {
+        "HOME=/root",
+        "TERM=dumb",
+        "LANG=C.UTF-8",
+        "PATH=/usr/local/sbin:/usr/local/bin:/usr/bin:/usr/sbin:/bin:/sbin",
+        "_STDBUF_O=L",
+        "_STDBUF_E=L",
+    };
+    const QString preload = preloadValue();
+    if (!preload.isEmpty())
+        env << "LD_PRELOAD=" + preload;
+    m_preloadChanged = false;
+
+    ProcessExecutor::Options opts;
+    opts.usePty = false;
+    opts.pipeStdin = true;
+
+    m_splitter.clear();
+    m_shellError.clear();
+    m_childTicks[0] = m_childTicks[1] = 0;
+    m_shell = m_reactor.start(
+        QStringList{"chroot", m_root, "/usr/bin/env", "-i"} + env
+            + QStringList{"/bin/bash", "--noprofile", "--norc"},
+        opts,
+        [this](const char *data, qsizetype size) {
+            m_lastStats.outputBytes += size;
+            m_splitter.feed(data, size, [this](const char *line, qsizetype len) { handleLine(line, len); });
+        },
+        [this](const ProcessExecutor::Result &r) {
+            m_shellError = r.started ? QStringLiteral("shell exited with status %1").arg(r.exitCode) : r.error;
+            m_shell = 0;
+        });
+    if (m_shell == 0) {
+        if (error)
+            *error = QStringLiteral("Failed to start a shell inside %1: %2").arg(m_root, m_shellError);
+        unmountApiFilesystems();
+        return false;
+    }
+    return true;
+}
+
+void ChrootSession::close()
+{
+    if (m_shell != 0) {
+        m_reactor.write(m_shell, "exit 0\n");
+        m_reactor.closeStdin(m_shell);
+
+        // Give the shell a few seconds to leave on its own, then force it
+        QElapsedTimer timer;
+        timer.start();
+        while (isOpen() && timer.elapsed() < 5000)
+            m_reactor.runOnce(static_cast<int>(5000 - timer.elapsed()));
+        if (isOpen()) {
+            m_reactor.kill(m_shell, SIGKILL);
+            while (isOpen())
+                m_reactor.runOnce(-1);
+        }
+        m_shell = 0;
+    }
+    m_splitter.clear();
+    unmountApiFilesystems();
+}
+
+void ChrootSession::updateStats(qint64 cutime, qint64 cstime)
+{
+    static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    if (ticksPerSecond > 0) {
+        m_lastStats.userTimeUs = (cutime - m_childTicks[0]) * 1000000 / ticksPerSecond;
+        m_lastStats.systemTimeUs = (cstime - m_childTicks[1]) * 1000000 / ticksPerSecond;
+    }
+    m_childTicks[0] = cutime;
+    m_childTicks[1] = cstime;
+}
+
+// Output callback: one complete line of shell output
+void ChrootSession::handleLine(const char *data, qsizetype size)
+{
+    if (m_done)
+        return;
+    if (size >= m_marker.size() && std::memcmp(data, m_marker.constData(), size_t(m_marker.size())) == 0) {
+        const QList<QByteArray> f = QByteArray(data + m_marker.size(), int(size - m_marker.size())).trimmed().split(' ');
+        m_code = f.value(0).toInt();
+        if (f.size() == 3)
+            updateStats(f.at(1).toLongLong(), f.at(2).toLongLong());
+        m_done = true;
+        return;
+    }
+    if (m_onLine && *m_onLine && !LineSplitter::isBlank(data, size))
+        (*m_onLine)(QString::fromUtf8(data, int(size)));
+}
+
+void ChrootSession::setPreload(const QStringList &libraries)
+{
+    if (libraries == m_preload)
+        return;
+    m_preload = libraries;
+    m_preloadChanged = isOpen();
+}
+
+// libstdbuf first, then whatever setPreload() asked for
+QString ChrootSession::preloadValue() const
+{
+    QStringList libs;
+    for (const QString &lib : QStringList{"/usr/lib/coreutils/libstdbuf.so"} + m_preload) {
+        if (QFileInfo::exists(m_root + lib))
+            libs << lib;
+    }
+    return libs.join(':');
+}
+
+int ChrootSession::run(const QStringList &argv, const LineHandler &onLine, QByteArray *stderrOut)
+{
+    return run(ProcessExecutor::shellJoin(argv), onLine, stderrOut);
+}
+
+int ChrootSession::run(const QString &command, const LineHandler &onLine, QByteArray *stderrOut)
+{
+    if (!isOpen())
+        return -1;
+
+    // Every command runs in its own subshell so `exit`, `cd` or `set -e` can't
+    // leak into the session, and stdin is detached so nothing eats our pipe.
+    // The marker line carries the exit status back, plus the shell's
+    // cumulative children CPU ticks (cutime/cstime from /proc/$$/stat) so
+    // each command's CPU time falls out as a difference.
+    const QByteArray marker = QByteArrayLiteral("__ARCHAID_DONE_") + QByteArray::number(++m_serial) + ' ';
+    const QByteArray errRedirect = stderrOut ? "2>" + m_stderrScratch.toUtf8() : QByteArray("2>&1");
+
+    QByteArray script;
+    if (m_preloadChanged) {
+        const QString preload = preloadValue();
+        script += preload.isEmpty() ? QByteArray("unset LD_PRELOAD\n")
+                                    : "export LD_PRELOAD=" + ProcessExecutor::shellQuote(preload).toUtf8() + '\n';
+        m_preloadChanged = false;
+    }
+    script += "(\n";
+    script += command.toUtf8();
+    script += "\n) </dev/null " + errRedirect
+              + "; __rc=$?; read -r __st < /proc/$$/stat; set -- $__st"
+              + "; printf '\\n%s%d %s %s\\n' '" + marker + "' \"$__rc\" \"${16}\" \"${17}\"\n";
+    m_lastStats = CommandStats();
+    m_onLine = &onLine;
+    m_code = -1;
+    m_done = false;
+    m_marker = marker;
+    m_reactor.write(m_shell, script);
+
+    while (!m_done && isOpen()) {
+        if (m_onIdle)
+            m_onIdle();
+        m_reactor.runOnce(-1);
+    }
+    m_onLine = nullptr;
+    const bool done = m_done;
+    const int code = m_code;
+    m_done = true;   // output between commands has no owner
+
+    if (!done) {
+        // The shell died; drop the mounts so the next open() starts clean
+        close();
+        return -1;
+    }
+
+    if (stderrOut) {
+        QFile f(m_root + m_stderrScratch);
+        if (f.open(QIODevice::ReadOnly)) {
+            *stderrOut = f.readAll();
+            f.close();
+        }
+    }
+    return code;
+}
@@ -0,0 +1,93 @@
+#ifndef CHROOTSESSION_H
+#define CHROOTSESSION_H
+
+#include "linesplitter.h"
+#include "processreactor.h"
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+// A long-lived shell inside the install target.
+//
+// arch-chroot mounts proc/sys/dev/run, spawns a shell and tears everything
+// down again on every call. A session does the mount work once in open(),
+// keeps a single bash running inside the target and feeds it commands over
+// stdin. Each command's exit status comes back on a marker line, so callers
+// get the same "exit code + streamed output" contract as a child process.
+// The shell is driven through a ProcessReactor, so waiting for a command
+// means sleeping in epoll_wait() until it prints or the shell dies.
+class ChrootSession {
+public:
+    using LineHandler = std::function<void(const QString &line)>;
+
+    // Accounting for the last run()
+    struct CommandStats {
+        qint64 userTimeUs = 0;     // CPU time of the command's processes
+        qint64 systemTimeUs = 0;
+        qint64 outputBytes = 0;
+    };
+
+    // SharedMounts: another, already open session owns the API mounts; this
+    // one only runs its own shell (used for concurrent install steps).
+    enum MountMode { OwnMounts, SharedMounts };
+
+    explicit ChrootSession(const QString &root = QStringLiteral("/mnt"), MountMode mode = OwnMounts);
+    ~ChrootSession();
+
+    ChrootSession(const ChrootSession &) = delete;
+    ChrootSession &operator=(const ChrootSession &) = delete;
+
+    bool open(QString *error = nullptr);
+    bool isOpen() const;
+    void close();
+
+    // Run a shell command line inside the target. Output (stdout+stderr unless
+    // stderrOut is given) is handed to onLine line by line. Returns the exit
+    // status, or -1 when the session shell itself went away.
+    int run(const QString &command, const LineHandler &onLine, QByteArray *stderrOut = nullptr);
+    // Same, for a plain argv; quoting for the session shell is done here.
+    int run(const QStringList &argv, const LineHandler &onLine, QByteArray *stderrOut = nullptr);
+
+    // Called from run() each time the command's output so far has been
+    // handed to onLine and the session is about to wait for more; a good
+    // moment to flush anything buffered on the caller's side.
+    void setIdleHandler(const std::function<void()> &onIdle) { m_onIdle = onIdle; }
+
+    // Extra libraries (paths inside the target) preloaded into every command
+    // from the next one on; libraries that don't exist are left out
+    void setPreload(const QStringList &libraries);
+
+    QString root() const { return m_root; }
+    const CommandStats &lastStats() const { return m_lastStats; }
+
+private:
+    bool mountApiFilesystems(QString *error);
+    void unmountApiFilesystems();
+    void updateStats(qint64 cutime, qint64 cstime);
+    void handleLine(const char *data, qsizetype size);
+    QString preloadValue() const;
+
+    QString m_root;
+    MountMode m_mode;
+    QString m_stderrScratch; // per-session, sessions may run side by side
+    ProcessReactor m_reactor;
+    int m_shell = 0;         // reactor handle, 0 when no shell is running
+    LineSplitter m_splitter; // shell output, split as it arrives
+    QString m_shellError;    // why the last shell went away
+    QStringList m_mounted;   // mount points we attached, in mount order
+    quint64 m_serial = 0;
+    CommandStats m_lastStats;
+    qint64 m_childTicks[2] = {0, 0};   // shell's cutime/cstime after the last command
+    std::function<void()> m_onIdle;
+    QStringList m_preload;
+    bool m_preloadChanged = false;   // the running shell still has the old LD_PRELOAD
+
+    // State of the command in flight
+    const LineHandler *m_onLine = nullptr;
+    QByteArray m_marker;
+    int m_code = -1;
+    bool m_done = true;
+};
+
+#endif // CHROOTSESSION_H
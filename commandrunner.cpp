@@ -0,0 +1,270 @@
+#include "commandrunner.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <memory>
+
+namespace {
+
+const QString kHost = QStringLiteral("host");
+const QString kTarget = QStringLiteral("target");
+
+// One recorded command, one JSON object per line in the recording:
+// {"kind":"host"|"target","cmd":...,"started":...,"error":...,"exit":...,
+//  "out":<base64>,"err":<base64>,"us":<duration>}
+struct Recorded {
+    bool started = true;
+    QString error;
+    int exitCode = 0;
+    QByteArray out;
+    QByteArray err;
+    qint64 durationUs = 0;
+};
+
+// Runs everything through another runner and appends each command to a file
+class RecordingRunner : public CommandRunner {
+public:
+    RecordingRunner(const QString &path, CommandRunner *inner) : m_inner(inner), m_file(path)
+    {
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            qWarning("Cannot write command recording to %s", qPrintable(path));
+    }
+
+    ProcessExecutor::Result run(const QStringList &argv,
+                                const ProcessExecutor::OutputHandler &onOutput,
+                                const ProcessExecutor::Options &options) override
+    {
+        QByteArray out;
+        QElapsedTimer timer;
+        timer.start();
+        const ProcessExecutor::Result r = m_inner->run(argv, [&](const char *data, qsizetype size) {
+            out.append(data, static_cast<int>(size));
+            if (onOutput)
+                onOutput(data, size);
+        }, options);
+
+        Recorded rec;
+        rec.started = r.started;
+        rec.error = r.error;
+        rec.exitCode = r.exitCode;
+        rec.out = out;
+        rec.err = r.stderrData;
+        rec.durationUs = timer.nsecsElapsed() / 1000;
+        append(kHost, ProcessExecutor::shellJoin(argv), rec);
+        return r;
+    }
+
+    int runInSession(ChrootSession &session, const QString &command,
+                     const ChrootSession::LineHandler &onLine, QByteArray *stderrOut,
+                     const QString &recordAs) override
+    {
+        QByteArray out;
+        QByteArray err;
+        QElapsedTimer timer;
+        timer.start();
+        const int code = m_inner->runInSession(session, command, [&](const QString &line) {
+            out += line.toUtf8() + '\n';
+            if (onLine)
+                onLine(line);
+        }, stderrOut ? &err : nullptr, recordAs);
+        if (stderrOut)
+            *stderrOut = err;
+
+        Recorded rec;
+        rec.exitCode = code;
+        rec.out = out;
+        rec.err = err;
+        rec.durationUs = timer.nsecsElapsed() / 1000;
+        append(kTarget, recordAs.isEmpty() ? command : recordAs, rec);
+        return code;
+    }
+
+private:
+    void append(const QString &kind, const QString &cmd, const Recorded &rec)
+    {
+        QJsonObject obj;
+        obj.insert(QStringLiteral("kind"), kind);
+        obj.insert(QStringLiteral("cmd"), cmd);
+        obj.insert(QStringLiteral("started"), rec.started);
+        if (!rec.error.isEmpty())
+            obj.insert(QStringLiteral("error"), rec.error);
+        obj.insert(QStringLiteral("exit"), rec.exitCode);
+        obj.insert(QStringLiteral("out"), QString::fromLatin1(rec.out.toBase64()));
+        if (!rec.err.isEmpty())
+            obj.insert(QStringLiteral("err"), QString::fromLatin1(rec.err.toBase64()));
+        obj.insert(QStringLiteral("us"), rec.durationUs);
+
+        QMutexLocker locker(&m_lock);
+        if (!m_file.isOpen())
+            return;
+        m_file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n');
+        m_file.flush();   // a crashed install still leaves a usable prefix
+    }
+
+    std::unique_ptr<CommandRunner> m_inner;
+    QMutex m_lock;
+    QFile m_file;
+};
+
+// Answers commands from a recording without running anything
+class ReplayRunner : public CommandRunner {
+public:
+    ReplayRunner(const QString &path, bool withDelays) : m_delays(withDelays)
+    {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) {
+            qWarning("Cannot read command recording %s", qPrintable(path));
+            return;
+        }
+        while (!f.atEnd()) {
+            const QByteArray line = f.readLine().trimmed();
+            if (line.isEmpty())
+                continue;
+            const QJsonObject obj = QJsonDocument::fromJson(line).object();
+            if (obj.isEmpty())
+                continue;
+            Recorded rec;
+            rec.started = obj.value(QStringLiteral("started")).toBool(true);
+            rec.error = obj.value(QStringLiteral("error")).toString();
+            rec.exitCode = obj.value(QStringLiteral("exit")).toInt();
+            rec.out = QByteArray::fromBase64(obj.value(QStringLiteral("out")).toString().toLatin1());
+            rec.err = QByteArray::fromBase64(obj.value(QStringLiteral("err")).toString().toLatin1());
+            rec.durationUs = static_cast<qint64>(obj.value(QStringLiteral("us")).toDouble());
+            m_entries[key(obj.value(QStringLiteral("kind")).toString(),
+                          obj.value(QStringLiteral("cmd")).toString())].enqueue(rec);
+        }
+    }
+
+    bool isLive() const override { return false; }
+
+    ProcessExecutor::Result run(const QStringList &argv,
+                                const ProcessExecutor::OutputHandler &onOutput,
+                                const ProcessExecutor::Options &options) override
+    {
+        const QString cmd = ProcessExecutor::shellJoin(argv);
+        ProcessExecutor::Result r;
+        Recorded rec;
+        if (!take(kHost, cmd, &rec)) {
+            r.started = true;
+            r.exitCode = 127;
+            r.stderrData = "not in the recording: " + cmd.toUtf8();
+            return r;
+        }
+
+        if (!rec.out.isEmpty() && onOutput)
+            onOutput(rec.out.constData(), rec.out.size());
+        r.started = rec.started;
+        r.error = rec.error;
+        r.exitCode = rec.exitCode;
+        r.outputBytes = rec.out.size();
+        if (!options.mergeStderr)
+            r.stderrData = rec.err;
+        return r;
+    }
+
+    int runInSession(ChrootSession &, const QString &command,
+                     const ChrootSession::LineHandler &onLine, QByteArray *stderrOut,
+                     const QString &recordAs) override
+    {
+        const QString cmd = recordAs.isEmpty() ? command : recordAs;
+        Recorded rec;
+        if (!take(kTarget, cmd, &rec)) {
+            if (stderrOut)
+                *stderrOut = "not in the recording: " + cmd.toUtf8();
+            return 127;
+        }
+
+        if (onLine) {
+            const QList<QByteArray> lines = rec.out.split('\n');
+            for (int i = 0; i < lines.size(); ++i) {
+                if (i == lines.size() - 1 && lines.at(i).isEmpty())
+                    break;   // trailing newline
+                onLine(QString::fromUtf8(lines.at(i)));
+            }
+        }
+        if (stderrOut)
+            *stderrOut = rec.err;
+        return rec.exitCode;
+    }
+
+private:
+    static QString key(const QString &kind, const QString &cmd) { return kind + '\n' + cmd; }
+
+    bool take(const QString &kind, const QString &cmd, Recorded *rec)
+    {
+        {
+            QMutexLocker locker(&m_lock);
+            auto it = m_entries.find(key(kind, cmd));
+            if (it == m_entries.end() || it->isEmpty())
+                return false;
+            *rec = it->dequeue();
+        }
+        if (m_delays && rec->durationUs > 0)
+            QThread::usleep(static_cast<unsigned long>(rec->durationUs));
+        return true;
+    }
+
+    bool m_delays;
+    QMutex m_lock;
+    QHash<QString, QQueue<Recorded>> m_entries;
+};
+
+std::unique_ptr<CommandRunner> &runnerSlot()
+{
+    static std::unique_ptr<CommandRunner> runner;
+    return runner;
+}
+
+QMutex runnerLock;
+
+} // namespace
+
+int CommandRunner::execute(const QString &program, const QStringList &args)
+{
+    ProcessExecutor::Options opts;
+    opts.usePty = false;
+    const ProcessExecutor::Result r = run(QStringList{program} + args, nullptr, opts);
+    return r.started ? r.exitCode : -2;
+}
+
+CommandRunner &CommandRunner::instance()
+{
+    QMutexLocker locker(&runnerLock);
+    std::unique_ptr<CommandRunner> &runner = runnerSlot();
+    if (!runner) {
+        const QString replay = qEnvironmentVariable("ARCHAID_REPLAY");
+        const QString record = qEnvironmentVariable("ARCHAID_RECORD");
+        if (!replay.isEmpty())
+            runner.reset(new ReplayRunner(replay, qEnvironmentVariableIntValue("ARCHAID_REPLAY_DELAYS") != 0));
+        else if (!record.isEmpty())
+            runner.reset(new RecordingRunner(record, new SystemCommandRunner));
+        else
+            runner.reset(new SystemCommandRunner);
+    }
+    return *runner;
+}
+
+void CommandRunner::setInstance(CommandRunner *runner)
+{
+    QMutexLocker locker(&runnerLock);
+    runnerSlot().reset(runner);
+}
+
+ProcessExecutor::Result SystemCommandRunner::run(const QStringList &argv,
+                                                 const ProcessExecutor::OutputHandler &onOutput,
+                                                 const ProcessExecutor::Options &options)
+{
+    return ProcessExecutor::run(argv, onOutput, options);
+}
+
+int SystemCommandRunner::runInSession(ChrootSession &session, const QString &command,
+                                      const ChrootSession::LineHandler &onLine, QByteArray *stderrOut,
+                                      const QString &)
+{
+    return session.run(command, onLine, stderrOut);
+}
@@ -0,0 +1,67 @@
+#ifndef COMMANDRUNNER_H
+#define COMMANDRUNNER_H
+
+#include "chrootsession.h"
+#include "processexecutor.h"
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// The one place the installer workers hand commands to the system.
+//
+// Host programs and commands in the target's chroot session both go through
+// the process-wide runner. The default one executes them; the others make an
+// install reproducible without disks or root:
+//
+//   ARCHAID_RECORD=<file>   execute as usual and append every command, its
+//                           output, exit status and duration to <file>
+//   ARCHAID_REPLAY=<file>   execute nothing; answer each command from the
+//                           recording (as fast as possible, or with the
+//                           recorded durations when ARCHAID_REPLAY_DELAYS=1)
+//
+// Replay matches commands by their text, first come first served, so
+// concurrent steps may interleave differently from the recording. A command
+// that was never recorded fails with exit status 127.
+class CommandRunner {
+public:
+    virtual ~CommandRunner() = default;
+
+    // A host program; same contract as ProcessExecutor::run()
+    virtual ProcessExecutor::Result run(const QStringList &argv,
+                                        const ProcessExecutor::OutputHandler &onOutput,
+                                        const ProcessExecutor::Options &options) = 0;
+
+    // A shell command line in the chroot session; same contract as
+    // ChrootSession::run(). Commands carrying secrets pass a recordAs text,
+    // which is what gets recorded and matched instead of the command itself.
+    virtual int runInSession(ChrootSession &session, const QString &command,
+                             const ChrootSession::LineHandler &onLine, QByteArray *stderrOut = nullptr,
+                             const QString &recordAs = QString()) = 0;
+
+    // false: nothing really runs, so callers skip the host-side work around
+    // commands (mounting the target, opening sessions, touching its files)
+    virtual bool isLive() const { return true; }
+
+    // QProcess::execute() without the shell: output discarded, exit status
+    // returned (-2 when the program could not be started)
+    int execute(const QString &program, const QStringList &args);
+
+    // Chosen from the environment on first use
+    static CommandRunner &instance();
+    // Replaces the process-wide runner (takes ownership); call before any
+    // worker starts
+    static void setInstance(CommandRunner *runner);
+};
+
+// Executes everything for real
+class SystemCommandRunner : public CommandRunner {
+public:
+    ProcessExecutor::Result run(const QStringList &argv,
+                                const ProcessExecutor::OutputHandler &onOutput,
+                                const ProcessExecutor::Options &options) override;
+    int runInSession(ChrootSession &session, const QString &command,
+                     const ChrootSession::LineHandler &onLine, QByteArray *stderrOut = nullptr,
+                     const QString &recordAs = QString()) override;
+};
+
+#endif // COMMANDRUNNER_H
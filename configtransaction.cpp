@@ -0,0 +1,210 @@
+#include "configtransaction.h"
+#include "chrootsession.h"
+#include "commandrunner.h"
+#include "processexecutor.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+static const char kStepMarker[] = "__ARCHAID_STEP_";
+
+ConfigTransaction::ConfigTransaction(const QString &root) : m_root(root) {}
+
+// Map a target path onto the host, following a symlink in the last component
+// the way the target would (absolute link targets are relative to its root,
+// not ours).
+QString ConfigTransaction::hostPath(const QString &path) const
+{
+    QString current = QDir::cleanPath(m_root + '/' + path);
+    for (int hops = 0; hops < 8; ++hops) {
+        const QFileInfo fi(current);
+        if (!fi.isSymLink())
+            break;
+        QByteArray raw(4096, '\0');
+        const ssize_t n = ::readlink(QFile::encodeName(current).constData(), raw.data(), raw.size() - 1);
+        if (n <= 0)
+            break;
+        raw.truncate(static_cast<int>(n));
+        const QString target = QFile::decodeName(raw);
+        current = target.startsWith('/')
+                      ? QDir::cleanPath(m_root + '/' + target)
+                      : QDir::cleanPath(fi.absolutePath() + '/' + target);
+    }
+    return current;
+}
+
+void ConfigTransaction::add(const QString &label, bool fatal, std::function<QString()> apply, const QString &script)
+{
+    Step step;
+    step.label = label;
+    step.fatal = fatal;
+    step.apply = std::move(apply);
+    step.script = script;
+    m_steps.append(step);
+}
+
+void ConfigTransaction::writeFile(const QString &label, const QString &path, const QByteArray &content, bool fatal)
+{
+    const QString host = QDir::cleanPath(m_root + '/' + path);
+    add(label, fatal, [host, content]() -> QString {
+        // Replace a symlink rather than writing through it
+        if (QFileInfo(host).isSymLink())
+            QFile::remove(host);
+        QDir().mkpath(QFileInfo(host).absolutePath());
+        QFile f(host);
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return f.errorString();
+        if (f.write(content) != content.size())
+            return f.errorString();
+        f.close();
+        return QString();
+    });
+}
+
+void ConfigTransaction::replaceInFile(const QString &label, const QString &path,
+                                      const QRegularExpression &pattern, const QString &replacement, bool fatal)
+{
+    add(label, fatal, [this, path, pattern, replacement]() -> QString {
+        QFile f(hostPath(path));
+        if (!f.open(QIODevice::ReadOnly))
+            return f.errorString();
+        QString text = QString::fromUtf8(f.readAll());
+        f.close();
+
+        const QString edited = QString(text).replace(pattern, replacement);
+        if (edited == text)
+            return QString();   // nothing to change, like a sed that didn't match
+
+        // Truncating in place keeps the file's mode (sudoers must stay 0440)
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return f.errorString();
+        const QByteArray bytes = edited.toUtf8();
+        if (f.write(bytes) != bytes.size())
+            return f.errorString();
+        f.close();
+        return QString();
+    });
+}
+
+void ConfigTransaction::symlink(const QString &label, const QString &linkTarget, const QString &path, bool fatal)
+{
+    const QString host = QDir::cleanPath(m_root + '/' + path);
+    add(label, fatal, [host, linkTarget]() -> QString {
+        const QByteArray link = QFile::encodeName(host);
+        ::unlink(link.constData());
+        if (::symlink(QFile::encodeName(linkTarget).constData(), link.constData()) != 0)
+            return QString::fromLocal8Bit(strerror(errno));
+        return QString();
+    });
+}
+
+void ConfigTransaction::removeMatching(const QString &label, const QString &dir, const QString &nameFilter, bool fatal)
+{
+    const QString host = QDir::cleanPath(m_root + '/' + dir);
+    add(label, fatal, [host, nameFilter]() -> QString {
+        QDir d(host);
+        const QStringList names = d.entryList({nameFilter}, QDir::Files | QDir::System | QDir::Hidden);
+        for (const QString &name : names) {
+            if (!d.remove(name))
+                return QStringLiteral("could not remove %1").arg(d.filePath(name));
+        }
+        return QString();
+    });
+}
+
+void ConfigTransaction::makeDir(const QString &label, const QString &path, bool fatal)
+{
+    const QString host = QDir::cleanPath(m_root + '/' + path);
+    add(label, fatal, [host]() -> QString {
+        return QDir().mkpath(host) ? QString() : QStringLiteral("mkdir failed");
+    });
+}
+
+void ConfigTransaction::run(const QString &label, const QStringList &argv, bool fatal)
+{
+    add(label, fatal, nullptr, ProcessExecutor::shellJoin(argv));
+}
+
+void ConfigTransaction::runScript(const QString &label, const QString &script, bool fatal)
+{
+    add(label, fatal, nullptr, script);
+}
+
+// One session round-trip for steps [first, last]
+bool ConfigTransaction::runBatch(ChrootSession &session, int first, int last, const LineHandler &onLine)
+{
+    QString script;
+    for (int i = first; i <= last; ++i) {
+        const Step &step = m_steps.at(i);
+        script += QStringLiteral("(\n") + step.script
+                  + QStringLiteral("\n); __s=$?; printf '\\n%s%d\\n' '") + QLatin1String(kStepMarker)
+                  + QString::number(i) + QStringLiteral(" ' \"$__s\"\n");
+        if (step.fatal)
+            script += QStringLiteral("[ \"$__s\" -eq 0 ] || exit \"$__s\"\n");
+    }
+
+    const int batchCode = CommandRunner::instance().runInSession(session, script, [&](const QString &line) {
+        if (line.startsWith(QLatin1String(kStepMarker))) {
+            const QStringList parts = line.mid(int(sizeof(kStepMarker)) - 1).split(' ', Qt::SkipEmptyParts);
+            const int idx = parts.value(0).toInt();
+            if (idx >= first && idx <= last && parts.size() == 2) {
+                StepResult &r = m_results[idx];
+                r.ran = true;
+                r.exitCode = parts.at(1).toInt();
+                r.ok = (r.exitCode == 0);
+            }
+            return;
+        }
+        if (onLine)
+            onLine(line);
+    });
+
+    bool ok = true;
+    for (int i = first; i <= last; ++i) {
+        StepResult &r = m_results[i];
+        if (!r.ran && batchCode < 0)
+            r.message = QStringLiteral("chroot session terminated");
+        if (r.fatal && !r.ok)
+            ok = false;
+    }
+    return ok;
+}
+
+bool ConfigTransaction::commit(ChrootSession &session, const LineHandler &onLine)
+{
+    m_results.clear();
+    for (const Step &step : std::as_const(m_steps)) {
+        StepResult r;
+        r.label = step.label;
+        r.fatal = step.fatal;
+        m_results.append(r);
+    }
+
+    int i = 0;
+    while (i < m_steps.size()) {
+        if (m_steps.at(i).apply) {
+            StepResult &r = m_results[i];
+            r.ran = true;
+            // Under replay the target tree is not ours to touch
+            if (CommandRunner::instance().isLive())
+                r.message = m_steps.at(i).apply();
+            r.ok = r.message.isEmpty();
+            if (!r.ok && r.fatal)
+                return false;
+            ++i;
+            continue;
+        }
+
+        // Group the run of consecutive target steps into one script
+        int last = i;
+        while (last + 1 < m_steps.size() && !m_steps.at(last + 1).apply)
+            ++last;
+        if (!runBatch(session, i, last, onLine))
+            return false;
+        i = last + 1;
+    }
+    return true;
+}
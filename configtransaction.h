@@ -0,0 +1,72 @@
+#ifndef CONFIGTRANSACTION_H
+#define CONFIGTRANSACTION_H
+
+#include <QByteArray>
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+class ChrootSession;
+
+// A batch of configuration steps applied to the install target in one pass.
+//
+// File-level steps (write, regex edit, symlink, remove, mkdir) are done
+// in-process on the target tree. Steps that need the target's own binaries
+// (locale-gen, systemctl, ...) are concatenated into a single script that the
+// chroot session runs once; each step reports its exit status on a marker
+// line, so failures are still attributed to the step that caused them.
+// Consecutive steps of the same kind are grouped, so queue file steps first.
+class ConfigTransaction {
+public:
+    using LineHandler = std::function<void(const QString &line)>;
+
+    struct StepResult {
+        QString label;
+        bool fatal = false;
+        bool ran = false;        // false: skipped after an earlier fatal failure
+        bool ok = false;
+        int exitCode = 0;        // target steps only
+        QString message;         // in-process failure reason
+    };
+
+    explicit ConfigTransaction(const QString &root = QStringLiteral("/mnt"));
+
+    // Paths are as seen from inside the target ("/etc/hostname").
+    void writeFile(const QString &label, const QString &path, const QByteArray &content, bool fatal = false);
+    void replaceInFile(const QString &label, const QString &path,
+                       const QRegularExpression &pattern, const QString &replacement, bool fatal = false);
+    void symlink(const QString &label, const QString &linkTarget, const QString &path, bool fatal = false);
+    void removeMatching(const QString &label, const QString &dir, const QString &nameFilter, bool fatal = false);
+    void makeDir(const QString &label, const QString &path, bool fatal = false);
+
+    void run(const QString &label, const QStringList &argv, bool fatal = false);
+    void runScript(const QString &label, const QString &script, bool fatal = false);
+
+    bool isEmpty() const { return m_steps.isEmpty(); }
+    int size() const { return m_steps.size(); }
+
+    // Applies every step in order. Returns false when a fatal step failed;
+    // everything after it is skipped. Per-step outcomes are in results().
+    bool commit(ChrootSession &session, const LineHandler &onLine);
+    const QList<StepResult> &results() const { return m_results; }
+
+private:
+    struct Step {
+        QString label;
+        bool fatal = false;
+        std::function<QString()> apply;   // in-process: returns an error, empty on success
+        QString script;                   // target step when apply is empty
+    };
+
+    QString hostPath(const QString &path) const;
+    void add(const QString &label, bool fatal, std::function<QString()> apply, const QString &script = QString());
+    bool runBatch(ChrootSession &session, int first, int last, const LineHandler &onLine);
+
+    QString m_root;
+    QList<Step> m_steps;
+    QList<StepResult> m_results;
+};
+
+#endif // CONFIGTRANSACTION_H
@@ -0,0 +1,175 @@
+#include "goldenimagecache.h"
+#include "commandrunner.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStorageInfo>
+
+static const int kImagesKept = 2;
+static const qint64 kSpaceMargin = qint64(1) << 30;
+// zstd -3 gets an installed system to well under half its size
+static const int kExpectedRatio = 2;
+
+// Installer state and caches that aren't part of the system; the fsync shim
+// copy is removed at the end of every install. The pacman keyring holds a
+// master secret key, which must not be shared between machines.
+static const QStringList kExcluded = {
+    "./etc/pacman.d/gnupg",
+    "./var/cache/pacman/pkg/*",
+    "./var/cache/archaid",
+    "./var/lib/archaid",
+    "./usr/lib/archaid-eatmydata.so",
+    "./tmp/*",
+};
+
+static QStringList tarOptions()
+{
+    return {"--use-compress-program", "zstd -T0 -3", "--xattrs", "--xattrs-include=*",
+            "--acls", "--numeric-owner"};
+}
+
+GoldenImageCache::GoldenImageCache(const QString &dir) : m_dir(QDir::cleanPath(dir)) {}
+
+QByteArray GoldenImageCache::fileDigest(const QString &path) const
+{
+    const QFileInfo info(path);
+    const QByteArray absolute = info.absoluteFilePath().toUtf8();
+    const QByteArray stamp = QByteArray::number(info.size()) + '\t'
+                             + QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + '\t'
+                             + absolute;
+
+    // One "digest <tab> size <tab> mtime <tab> path" line per file
+    QFile memo(m_dir + "/digests");
+    QByteArray kept;
+    if (memo.open(QIODevice::ReadOnly)) {
+        while (!memo.atEnd()) {
+            const QByteArray line = memo.readLine();
+            const int tab = line.indexOf('\t');
+            if (tab <= 0)
+                continue;
+            if (line.mid(tab + 1).trimmed() == stamp)
+                return line.left(tab);
+            if (!line.endsWith('\t' + absolute + '\n'))   // stale entries for this path go
+                kept += line;
+        }
+        memo.close();
+    }
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&f))
+        return QByteArray();
+    const QByteArray digest = hash.result().toHex();
+
+    if (QDir().mkpath(m_dir) && memo.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        memo.write(kept + digest + '\t' + stamp + '\n');
+    return digest;
+}
+
+QByteArray GoldenImageCache::databaseDigest(const QString &syncDir)
+{
+    const QDir dir(syncDir);
+    const QStringList dbs = dir.entryList({"*.db"}, QDir::Files, QDir::Name);
+    if (dbs.isEmpty())
+        return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (const QString &db : dbs) {
+        QFile f(dir.filePath(db));
+        if (!f.open(QIODevice::ReadOnly) || !hash.addData(&f))
+            return QByteArray();
+        hash.addData(db.toUtf8());
+    }
+    return hash.result().toHex();
+}
+
+QByteArray GoldenImageCache::key(const QByteArray &sourceDigest, const QStringList &packages,
+                                 const QByteArray &databaseDigest)
+{
+    QStringList sorted = packages;
+    sorted.sort();
+    sorted.removeDuplicates();
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData("archaid-golden-2\n");   // 2: the keyring is no longer archived
+    hash.addData("source " + sourceDigest + '\n');
+    hash.addData("packages " + sorted.join(' ').toUtf8() + '\n');
+    hash.addData("databases " + databaseDigest + '\n');
+    return hash.result().toHex().left(32);
+}
+
+QString GoldenImageCache::imagePath(const QByteArray &key) const
+{
+    return m_dir + "/" + QString::fromLatin1(key) + ".tar.zst";
+}
+
+bool GoldenImageCache::contains(const QByteArray &key) const
+{
+    return !key.isEmpty() && QFileInfo::exists(imagePath(key));
+}
+
+bool GoldenImageCache::isEmpty() const
+{
+    return QDir(m_dir).entryList({"*.tar.zst"}, QDir::Files).isEmpty();
+}
+
+bool GoldenImageCache::capture(const QString &root, const QByteArray &key, QString *error)
+{
+    if (!QDir().mkpath(m_dir)) {
+        *error = "cannot create " + m_dir;
+        return false;
+    }
+    const QStorageInfo target(root);
+    const QStorageInfo cache(m_dir);
+    const qint64 needed = (target.bytesTotal() - target.bytesFree()) / kExpectedRatio + kSpaceMargin;
+    if (cache.bytesAvailable() < needed) {
+        *error = QString("%1 has %2 MiB free, about %3 MiB are needed")
+                     .arg(m_dir).arg(cache.bytesAvailable() >> 20).arg(needed >> 20);
+        return false;
+    }
+
+    const QString part = imagePath(key) + ".part";
+    QStringList args{"--create", "--file", part, "--one-file-system", "--sparse"};
+    args += tarOptions();
+    for (const QString &pattern : kExcluded)
+        args << "--exclude=" + pattern;
+    args << "-C" << root << ".";
+    if (CommandRunner::instance().execute("tar", args) != 0) {
+        QFile::remove(part);
+        *error = "tar could not archive " + root;
+        return false;
+    }
+    QFile::remove(imagePath(key));
+    if (!QFile::rename(part, imagePath(key))) {
+        QFile::remove(part);
+        *error = "cannot move " + part + " into place";
+        return false;
+    }
+    prune(kImagesKept);
+    return true;
+}
+
+bool GoldenImageCache::deploy(const QString &root, const QByteArray &key, QString *error) const
+{
+    QStringList args{"--extract", "--file", imagePath(key), "--preserve-permissions"};
+    args += tarOptions();
+    args << "-C" << root;
+    if (CommandRunner::instance().execute("tar", args) != 0) {
+        *error = "tar could not unpack " + imagePath(key);
+        return false;
+    }
+    // Recently used images outlive the others
+    QFile image(imagePath(key));
+    if (image.open(QIODevice::ReadWrite))
+        image.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return true;
+}
+
+void GoldenImageCache::prune(int keep)
+{
+    const QFileInfoList images = QDir(m_dir).entryInfoList({"*.tar.zst"}, QDir::Files, QDir::Time);
+    for (int i = keep; i < images.size(); ++i)
+        QFile::remove(images.at(i).absoluteFilePath());
+}
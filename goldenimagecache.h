@@ -0,0 +1,45 @@
+#ifndef GOLDENIMAGECACHE_H
+#define GOLDENIMAGECACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Finished package trees of earlier installs, kept as zstd-compressed tar
+// archives so installs of the same system can start from one.
+//
+// An image is keyed by everything that decides its contents: the rootfs
+// source (ISO or airootfs.sfs) by digest, the package list, and the sync
+// databases pacman resolved them against. Archives keep ownership, modes,
+// ACLs and xattrs and stay on the target's filesystem, so API mounts and
+// bind-mounted caches are left out, and so is the pacman keyring, which the
+// deploying install initializes anew. The newest few are kept.
+class GoldenImageCache {
+public:
+    explicit GoldenImageCache(const QString &dir);
+
+    static QString defaultDir() { return QStringLiteral("/var/cache/archaid/golden"); }
+
+    // SHA-256, remembered per path, size and mtime so a multi-GiB ISO is
+    // read once
+    QByteArray fileDigest(const QString &path) const;
+    // Over the *.db files of a pacman sync directory
+    static QByteArray databaseDigest(const QString &syncDir);
+    static QByteArray key(const QByteArray &sourceDigest, const QStringList &packages,
+                          const QByteArray &databaseDigest);
+
+    QString imagePath(const QByteArray &key) const;
+    bool contains(const QByteArray &key) const;
+    bool isEmpty() const;
+
+    // root is the target's mount point; capture() keeps the newest images
+    bool capture(const QString &root, const QByteArray &key, QString *error);
+    bool deploy(const QString &root, const QByteArray &key, QString *error) const;
+
+private:
+    void prune(int keep);
+
+    QString m_dir;
+};
+
+#endif // GOLDENIMAGECACHE_H
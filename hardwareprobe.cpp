@@ -0,0 +1,146 @@
+#include "hardwareprobe.h"
+#include <QDir>
+#include <QFile>
+#include <QSet>
+
+namespace {
+
+// Device vendor -> split firmware package. Vendors are the ID as it
+// appears in the modalias (upper-case hex), per bus.
+struct VendorFirmware {
+    const char *bus;
+    const char *vendor;
+    const char *package;
+};
+
+const VendorFirmware kVendorFirmware[] = {
+    {"pci",  "1002", "linux-firmware-amdgpu"},
+    {"pci",  "1002", "linux-firmware-radeon"},
+    {"pci",  "10DE", "linux-firmware-nvidia"},
+    {"pci",  "8086", "linux-firmware-intel"},
+    {"usb",  "8087", "linux-firmware-intel"},      // Intel Bluetooth
+    {"pci",  "10EC", "linux-firmware-realtek"},
+    {"usb",  "0BDA", "linux-firmware-realtek"},
+    {"pci",  "168C", "linux-firmware-atheros"},
+    {"pci",  "17CB", "linux-firmware-atheros"},    // Qualcomm
+    {"usb",  "0CF3", "linux-firmware-atheros"},
+    {"pci",  "14E4", "linux-firmware-broadcom"},
+    {"usb",  "0A5C", "linux-firmware-broadcom"},
+    {"sdio", "02D0", "linux-firmware-broadcom"},
+    {"pci",  "14C3", "linux-firmware-mediatek"},
+    {"usb",  "0E8D", "linux-firmware-mediatek"},
+    {"pci",  "1013", "linux-firmware-cirrus"},
+    {"acpi", "CSC",  "linux-firmware-cirrus"},     // laptop amplifiers
+    {"pci",  "15B3", "linux-firmware-mellanox"},
+    {"pci",  "1077", "linux-firmware-qlogic"},
+    {"pci",  "19EE", "linux-firmware-nfp"},
+    {"pci",  "177D", "linux-firmware-liquidio"},
+};
+
+const QString kOtherFirmware = QStringLiteral("linux-firmware-other");
+const QStringList kMicrocode = {"intel-ucode", "amd-ucode"};
+
+// "pci:v00008086d...bc02sc80i00" -> bus "pci", vendor "8086", class "02"
+struct Modalias {
+    QString bus;
+    QString vendor;
+    QString baseClass;
+};
+
+Modalias parseModalias(const QString &alias)
+{
+    Modalias m;
+    const int colon = alias.indexOf(':');
+    if (colon <= 0)
+        return m;
+    m.bus = alias.left(colon);
+    const QString rest = alias.mid(colon + 1);
+    if (m.bus == "pci" && rest.startsWith("v0000")) {
+        m.vendor = rest.mid(5, 4).toUpper();
+        const int bc = rest.indexOf("bc");
+        if (bc >= 0)
+            m.baseClass = rest.mid(bc + 2, 2).toUpper();
+    } else if (m.bus == "usb" && rest.startsWith('v')) {
+        m.vendor = rest.mid(1, 4).toUpper();
+    } else if (m.bus == "sdio") {
+        const int v = rest.indexOf('v');
+        if (v >= 0)
+            m.vendor = rest.mid(v + 1, 4).toUpper();
+    } else if (m.bus == "acpi") {
+        m.vendor = rest.left(3).toUpper();
+    }
+    return m;
+}
+
+} // namespace
+
+HardwareProbe::HardwareProbe(const QString &sysRoot, const QString &cpuinfo)
+{
+    QSet<QString> firmware;
+    const QDir buses(sysRoot + "/bus");
+    for (const QString &bus : buses.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        const QDir devices(buses.filePath(bus + "/devices"));
+        for (const QString &dev : devices.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::System)) {
+            QFile f(devices.filePath(dev + "/modalias"));
+            if (!f.open(QIODevice::ReadOnly))
+                continue;
+            const Modalias m = parseModalias(QString::fromLatin1(f.readAll()).trimmed());
+            if (m.vendor.isEmpty())
+                continue;
+
+            bool known = false;
+            for (const VendorFirmware &vf : kVendorFirmware) {
+                if (m.bus == QLatin1String(vf.bus) && m.vendor == QLatin1String(vf.vendor)) {
+                    firmware.insert(QString::fromLatin1(vf.package));
+                    known = true;
+                }
+            }
+            // Network (02) and wireless (0D) controllers of other vendors
+            if (!known && m.bus == "pci" && (m.baseClass == "02" || m.baseClass == "0D"))
+                firmware.insert(kOtherFirmware);
+            else if (!known && m.bus == "sdio")
+                firmware.insert(kOtherFirmware);
+        }
+    }
+    for (const VendorFirmware &vf : kVendorFirmware) {   // stable order
+        const QString pkg = QString::fromLatin1(vf.package);
+        if (firmware.contains(pkg) && !m_firmware.contains(pkg))
+            m_firmware << pkg;
+    }
+    if (firmware.contains(kOtherFirmware))
+        m_firmware << kOtherFirmware;
+
+    QFile cpu(cpuinfo);
+    if (cpu.open(QIODevice::ReadOnly)) {
+        while (!cpu.atEnd()) {
+            const QByteArray line = cpu.readLine();
+            if (!line.startsWith("vendor_id"))
+                continue;
+            if (line.contains("GenuineIntel"))
+                m_microcode << "intel-ucode";
+            else if (line.contains("AuthenticAMD"))
+                m_microcode << "amd-ucode";
+            break;
+        }
+    }
+}
+
+QStringList HardwareProbe::packages(bool portable)
+{
+    if (portable)
+        return QStringList{"linux-firmware"} + kMicrocode;
+    const HardwareProbe probe;
+    return probe.firmwarePackages() + probe.microcodePackages();
+}
+
+QStringList HardwareProbe::knownPackages()
+{
+    QStringList all{"linux-firmware"};
+    for (const VendorFirmware &vf : kVendorFirmware) {
+        const QString pkg = QString::fromLatin1(vf.package);
+        if (!all.contains(pkg))
+            all << pkg;
+    }
+    all << kOtherFirmware;
+    return all + kMicrocode;
+}
@@ -0,0 +1,38 @@
+#ifndef HARDWAREPROBE_H
+#define HARDWAREPROBE_H
+
+#include <QString>
+#include <QStringList>
+
+// Picks the firmware and CPU microcode packages this machine needs.
+//
+// Device vendors come from the modalias of every device under
+// /sys/bus/*/devices and are mapped onto Arch's split linux-firmware-*
+// packages; the CPU vendor in /proc/cpuinfo picks intel-ucode or amd-ucode.
+// Network devices from vendors without a package of their own get
+// linux-firmware-other. A portable selection is everything, for installs
+// meant to boot on other machines too.
+class HardwareProbe {
+public:
+    // Probes the running machine unless pointed at a captured /sys tree
+    explicit HardwareProbe(const QString &sysRoot = QStringLiteral("/sys"),
+                           const QString &cpuinfo = QStringLiteral("/proc/cpuinfo"));
+
+    QStringList firmwarePackages() const { return m_firmware; }
+    QStringList microcodePackages() const { return m_microcode; }
+
+    // firmware + microcode, or the portable set
+    static QStringList packages(bool portable);
+
+    // Every package a selection can contain, plus the linux-firmware meta
+    // package; what isn't selected gets removed from the target
+    static QStringList knownPackages();
+    // Shared by every split firmware package; never removed
+    static QString firmwareBasePackage() { return QStringLiteral("linux-firmware-whence"); }
+
+private:
+    QStringList m_firmware;
+    QStringList m_microcode;
+};
+
+#endif // HARDWAREPROBE_H
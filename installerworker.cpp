@@ -1,5 +1,7 @@
 #include "installerworker.h"
-#include <QProcess>
+#include "commandrunner.h"
+#include "installjournal.h"
+#include "installtrace.h"
 #include <QFileInfo>
 #include <QStandardPaths>
 #include <QThread>
@@ -10,8 +12,6 @@
 #include <QRegularExpression>
 #include <QSet>
 #include <QChar>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include "Installwizard.h"
 
 // --- Helper to locate parted ---
@@ -25,28 +25,45 @@ static QString locatePartedBinary() {
     return QString();
 }
 
-static QString targetStateFilePath()
+// Host commands go through the process-wide CommandRunner, so a partitioning
+// run can be recorded and replayed, and each one gets a trace span.
+static ProcessExecutor::Result runTraced(const QString &program, const QStringList &args, QByteArray *stdoutData)
 {
-    return QStringLiteral("/tmp/archaid-target.json");
+    const QStringList argv = QStringList{program} + args;
+    InstallTrace::Span span(QStringLiteral("command"),
+                            program == QLatin1String("sudo") && !args.isEmpty() ? args.first() : program);
+    span.setArg(QStringLiteral("argv"), ProcessExecutor::shellJoin(argv));
+
+    ProcessExecutor::Options opts;
+    opts.usePty = false;
+    opts.mergeStderr = !stdoutData;   // captures are stdout only, like readAllStandardOutput()
+    ProcessExecutor::OutputHandler onOutput;
+    if (stdoutData)
+        onOutput = [stdoutData](const char *data, qsizetype size) { stdoutData->append(data, static_cast<int>(size)); };
+    const ProcessExecutor::Result r = CommandRunner::instance().run(argv, onOutput, opts);
+    span.setArgs(InstallTrace::processArgs(r));
+    return r;
 }
 
-static void recordTargetMountState(const QString &rootDev, const QString &espDev)
+// QProcess::execute() replacement: exit status, -2 if it could not start
+static int tracedExecute(const QString &program, const QStringList &args)
 {
-    QJsonObject obj;
-    obj.insert(QStringLiteral("root"), rootDev);
-    if (!espDev.isEmpty())
-        obj.insert(QStringLiteral("esp"), espDev);
-
-    QFile f(targetStateFilePath());
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
-        qWarning() << "Failed to persist target mount state:" << f.errorString();
-        return;
-    }
+    const ProcessExecutor::Result r = runTraced(program, args, nullptr);
+    return r.started ? r.exitCode : -2;
+}
+
+// stdout of a finished host command
+static QByteArray captureOutput(const QString &program, const QStringList &args)
+{
+    QByteArray out;
+    runTraced(program, args, &out);
+    return out;
+}
 
-    const QJsonDocument doc(obj);
-    f.write(doc.toJson(QJsonDocument::Compact));
-    f.write("\n");
-    f.close();
+// A freshly partitioned target starts a new install journal
+static void recordTargetMountState(const QString &rootDev, const QString &espDev)
+{
+    InstallJournal().reset({rootDev, espDev});
 }
 
 // Return child partition kernel names for devPath (e.g. "sdb1", "nvme0n1p2")
@@ -55,10 +72,7 @@ static QSet<QString> childPartitionsSet(const QString &devPath)
     QString base = devPath.startsWith("/dev/") ? devPath.mid(5) : devPath;
     QSet<QString> out;
 
-    QProcess p;
-    p.start("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME");
-    p.waitForFinished();
-    const QStringList rows = QString::fromUtf8(p.readAllStandardOutput())
+    const QStringList rows = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME"))
                                  .split('\n', Qt::SkipEmptyParts);
 
     for (const QString &r : rows) {
@@ -74,10 +88,7 @@ static QSet<QString> childPartitionsSet(const QString &devPath)
 // Is this partition already VFAT/FAT32? (Used to validate existing ESP)
 static bool isPartitionVfat(const QString &partPath)
 {
-    QProcess p;
-    p.start("lsblk", QStringList() << "-no" << "FSTYPE" << partPath);
-    p.waitForFinished();
-    const QString fstype = QString::fromUtf8(p.readAllStandardOutput()).trimmed().toLower();
+    const QString fstype = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-no" << "FSTYPE" << partPath)).trimmed().toLower();
     return (fstype == "vfat" || fstype == "fat32" || fstype == "msdos");
 }
 
@@ -106,10 +117,7 @@ static QString partitionNodeFor(const QString &baseName, int partNum) {
 // Find an existing EFI System Partition (ESP) on this disk. Returns full /dev/… path or empty string.
 static QString findExistingEsp(const QString &partedBin, const QString &devPath) {
     // 1) Try lsblk with PARTTYPE/PARTLABEL/FSTYPE (most robust).
-    QProcess p;
-    p.start("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME,PARTTYPE,PARTLABEL,FSTYPE");
-    p.waitForFinished();
-    const QStringList rows = QString::fromUtf8(p.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+    const QStringList rows = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME,PARTTYPE,PARTLABEL,FSTYPE")).split('\n', Qt::SkipEmptyParts);
 
     QString base = devPath.startsWith("/dev/") ? devPath.mid(5) : devPath;
     const QString espGuid = "c12a7328-f81f-11d2-ba4b-00a0c93ec93b"; // EFI System Partition
@@ -135,10 +143,7 @@ static QString findExistingEsp(const QString &partedBin, const QString &devPath)
     }
 
     // 2) Fallback to parted flags.
-    QProcess pp;
-    pp.start("sudo", QStringList{partedBin, devPath, "-m", "unit", "MiB", "print"});
-    pp.waitForFinished();
-    const QStringList plines = QString::fromUtf8(pp.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+    const QStringList plines = QString::fromUtf8(captureOutput("sudo", QStringList{partedBin, devPath, "-m", "unit", "MiB", "print"})).split('\n', Qt::SkipEmptyParts);
     for (const QString &line : plines) {
         // parted -m lines look like: number:start:end:size:fs:name:flags
         const QStringList cols = line.split(':');
@@ -159,16 +164,10 @@ static QString findExistingEsp(const QString &partedBin, const QString &devPath)
 // Returns full /dev/… path or empty string if none is present.
 static QString findExistingBiosGrub(const QString &partedBin, const QString &devPath)
 {
-    QProcess process;
-    process.start("sudo", QStringList{partedBin, devPath, "-m", "unit", "MiB", "print"});
-    process.waitForFinished();
 
-    const QStringList lines = QString(process.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+    const QStringList lines = QString(captureOutput("sudo", QStringList{partedBin, devPath, "-m", "unit", "MiB", "print"})).split('\n', Qt::SkipEmptyParts);
     const QString base = devPath.startsWith("/dev/") ? devPath.mid(5) : devPath;
-    QProcess p;
-    p.start("sudo", QStringList{partedBin, devPath, "-m", "unit", "MiB", "print"});
-    p.waitForFinished();
-    const QStringList lines = QString::fromUtf8(p.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+    const QStringList lines = QString::fromUtf8(captureOutput("sudo", QStringList{partedBin, devPath, "-m", "unit", "MiB", "print"})).split('\n', Qt::SkipEmptyParts);
 
     QString base = devPath.startsWith("/dev/") ? devPath.mid(5) : devPath;
 
@@ -225,10 +224,7 @@ static QString resolveBaseDisk(const QString &devOrMapper)
 
     // Walk up PKNAME until TYPE == "disk"
     for (int hop = 0; hop < 6; ++hop) { // depth guard for dm-crypt→lvm→part→disk chains
-        QProcess p;
-        p.start("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME" << cur);
-        p.waitForFinished();
-        const QString out = QString::fromUtf8(p.readAllStandardOutput()).trimmed();
+        const QString out = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME" << cur)).trimmed();
         if (out.isEmpty()) break;
 
         const QStringList cols = out.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
@@ -251,10 +247,7 @@ static QString resolveBaseDisk(const QString &devOrMapper)
 // Where is "/" mounted from? (handles UUID=/LABEL= via blkid)
 static QString rootSourceDevice()
 {
-    QProcess p;
-    p.start("findmnt", QStringList() << "-no" << "SOURCE" << "/");
-    p.waitForFinished();
-    QString src = QString::fromUtf8(p.readAllStandardOutput()).trimmed();
+    QString src = QString::fromUtf8(captureOutput("findmnt", QStringList() << "-no" << "SOURCE" << "/")).trimmed();
 
     if (src.isEmpty()) {
         QFile f("/proc/mounts");
@@ -271,14 +264,10 @@ static QString rootSourceDevice()
     }
 
     if (!src.startsWith("/dev/") && (src.startsWith("UUID=") || src.startsWith("LABEL="))) {
-        QProcess r;
-        if (src.startsWith("UUID=")) {
-            r.start("blkid", QStringList() << "-U" << src.mid(5));
-        } else {
-            r.start("blkid", QStringList() << "-L" << src.mid(6));
-        }
-        r.waitForFinished();
-        const QString dev = QString::fromUtf8(r.readAllStandardOutput()).trimmed();
+        const QByteArray out = src.startsWith("UUID=")
+                                   ? captureOutput("blkid", QStringList() << "-U" << src.mid(5))
+                                   : captureOutput("blkid", QStringList() << "-L" << src.mid(6));
+        const QString dev = QString::fromUtf8(out).trimmed();
         if (dev.startsWith("/dev/"))
             src = dev;
     }
@@ -303,46 +292,43 @@ static bool isSystemDisk(const QString &devPath)
 static void safePreflightUnmounts(const QString &devPath)
 {
     // Always clean our staging
-    QProcess::execute("sudo", {"umount", "-Rl", "/mnt/boot/efi"});
-    QProcess::execute("sudo", {"umount", "-Rl", "/mnt/boot"});
-    QProcess::execute("sudo", {"umount", "-Rl", "/mnt"});
+    tracedExecute("sudo", {"umount", "-Rl", "/mnt/boot/efi"});
+    tracedExecute("sudo", {"umount", "-Rl", "/mnt/boot"});
+    tracedExecute("sudo", {"umount", "-Rl", "/mnt"});
 
     // If this is the system disk, stop here — do not touch host mounts.
     if (isSystemDisk(devPath)) {
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"udevadm", "settle"});
         return;
     }
 
     // For non-system disks, unmount only "external" mountpoints on this disk.
-    QProcess p;
-    p.start("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,MOUNTPOINT" << devPath);
-    p.waitForFinished();
-    const QStringList lines = QString::fromUtf8(p.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+    const QStringList lines = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,MOUNTPOINT" << devPath)).split('\n', Qt::SkipEmptyParts);
     for (const QString &line : lines) {
         const QStringList cols = line.split(QRegularExpression("\\s+"));
         if (cols.size() >= 2 && cols[1] == "part") {
             const QString node = "/dev/" + cols[0];
             const QString mp   = (cols.size() >= 3 ? cols[2] : QString());
             if (!mp.isEmpty() && (mp.startsWith("/media/") || mp.startsWith("/run/media/") || mp.startsWith("/mnt/"))) {
-                QProcess::execute("sudo", {"umount", "-l", node});
+                tracedExecute("sudo", {"umount", "-l", node});
             }
         }
     }
-    QProcess::execute("sudo", {"udevadm", "settle"});
+    tracedExecute("sudo", {"udevadm", "settle"});
 }
 
 // Strong device-detach to avoid "resource busy", BUT safe on the system disk.
 static void bestEffortDetachDevice(const QString &devPath)
 {
     // Always clean our staging points first
-    QProcess::execute("sudo", {"umount", "-Rl", "/mnt/boot/efi"});
-    QProcess::execute("sudo", {"umount", "-Rl", "/mnt/boot"});
-    QProcess::execute("sudo", {"umount", "-Rl", "/mnt"});
+    tracedExecute("sudo", {"umount", "-Rl", "/mnt/boot/efi"});
+    tracedExecute("sudo", {"umount", "-Rl", "/mnt/boot"});
+    tracedExecute("sudo", {"umount", "-Rl", "/mnt"});
 
     // If the target is the disk that hosts "/", DO NOT try to unmount/kill holders on it.
     if (isSystemDisk(devPath)) {
         qWarning() << "[detach] Target is system disk; skipping device-wide unmounts/kills for" << devPath;
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"udevadm", "settle"});
         return;
     }
 
@@ -351,29 +337,26 @@ static void bestEffortDetachDevice(const QString &devPath)
 
     // 1) Ask udisks to unmount anything user-mounted from this disk
     for (const QString &pn : parts)
-        QProcess::execute("sudo", {"udisksctl", "unmount", "-b", "/dev/" + pn});
+        tracedExecute("sudo", {"udisksctl", "unmount", "-b", "/dev/" + pn});
 
     // 2) Swapoff any swap partitions on this disk
     {
-        QProcess psw; psw.start("cat", QStringList() << "/proc/swaps"); psw.waitForFinished();
-        const QString swaps = QString::fromUtf8(psw.readAllStandardOutput());
+        const QString swaps = QString::fromUtf8(captureOutput("cat", QStringList() << "/proc/swaps"));
         for (const QString &pn : parts)
             if (swaps.contains("/dev/" + pn))
-                QProcess::execute("sudo", {"swapoff", "/dev/" + pn});
+                tracedExecute("sudo", {"swapoff", "/dev/" + pn});
     }
 
     // 3) Close any LUKS mappings whose PKNAME is on this disk
     {
-        QProcess pl; pl.start("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME");
-        pl.waitForFinished();
-        const QStringList rows = QString::fromUtf8(pl.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+        const QStringList rows = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME")).split('\n', Qt::SkipEmptyParts);
         const QSet<QString> partSet = parts; // fast lookup
         for (const QString &r : rows) {
             const QStringList cols = r.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
             if (cols.size() < 3) continue;
             const QString name = cols[0], type = cols[1], pk = cols[2];
             if (type == "crypt" && (partSet.contains(pk))) {
-                QProcess::execute("sudo", {"cryptsetup", "close", "/dev/" + name});
+                tracedExecute("sudo", {"cryptsetup", "close", "/dev/" + name});
             }
         }
     }
@@ -381,23 +364,19 @@ static void bestEffortDetachDevice(const QString &devPath)
     // 4) Deactivate LVM VGs that live on this disk
     {
         QSet<QString> vgs;
-        QProcess pl; pl.start("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME");
-        pl.waitForFinished();
-        const QStringList rows = QString::fromUtf8(pl.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+        const QStringList rows = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME,TYPE,PKNAME")).split('\n', Qt::SkipEmptyParts);
         const QSet<QString> partSet = parts;
         for (const QString &r : rows) {
             const QStringList cols = r.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
             if (cols.size() < 3) continue;
             const QString name = cols[0], type = cols[1], pk = cols[2];
             if ((type == "lvm" || type == "dm") && partSet.contains(pk)) {
-                QProcess g; g.start("lvs", QStringList() << "--noheadings" << "-o" << "vg_name" << ("/dev/" + name));
-                g.waitForFinished();
-                const QString vg = QString::fromUtf8(g.readAllStandardOutput()).trimmed();
+                const QString vg = QString::fromUtf8(captureOutput("lvs", QStringList() << "--noheadings" << "-o" << "vg_name" << ("/dev/" + name))).trimmed();
                 if (!vg.isEmpty()) vgs.insert(vg);
             }
         }
         for (const QString &vg : vgs)
-            QProcess::execute("sudo", {"vgchange", "-an", vg});
+            tracedExecute("sudo", {"vgchange", "-an", vg});
     }
 
     // 5) Kill remaining holders (safe here because we verified it's NOT the system disk)
@@ -405,7 +384,7 @@ static void bestEffortDetachDevice(const QString &devPath)
         QStringList nodes; nodes << devPath;
         for (const QString &pn : parts) nodes << ("/dev/" + pn);
         for (const QString &n : nodes)
-            QProcess::execute("sudo", {"fuser", "-km", n}); // kill processes using n
+            tracedExecute("sudo", {"fuser", "-km", n}); // kill processes using n
     }
 
     // 6) Remove any dm holders
@@ -414,16 +393,16 @@ static void bestEffortDetachDevice(const QString &devPath)
         QDir holders(holdersPath);
         if (holders.exists()) {
             for (const QString &h : holders.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
-                QProcess::execute("sudo", {"dmsetup", "remove", "-f", h});
+                tracedExecute("sudo", {"dmsetup", "remove", "-f", h});
         }
     }
 
     // 7) Reread table & settle; and (best-effort) power-off if removable
-    QProcess::execute("sudo", {"blockdev", "--rereadpt", devPath});
-    QProcess::execute("sudo", {"partprobe", devPath});
-    QProcess::execute("sudo", {"udevadm", "settle"});
+    tracedExecute("sudo", {"blockdev", "--rereadpt", devPath});
+    tracedExecute("sudo", {"partprobe", devPath});
+    tracedExecute("sudo", {"udevadm", "settle"});
     QThread::sleep(1);
-    QProcess::execute("sudo", {"udisksctl", "power-off", "-b", devPath}); // best-effort; harmless if non-removable
+    tracedExecute("sudo", {"udisksctl", "power-off", "-b", devPath}); // best-effort; harmless if non-removable
 }
 
 // Parse parted's "MiB" strings which may be decimal (e.g. "1.00MiB").
@@ -489,7 +468,7 @@ void InstallerWorker::setMode(InstallMode m) { mode = m; }
 void InstallerWorker::setTargetPartition(const QString &part) { targetPartition = part; }
 void InstallerWorker::setEfiInstall(bool efi) { efiInstall = efi; }
 
-void InstallerWorker::wipeDriveAndPartition(QProcess &process, const QString &partedBin, const QString &devPath)
+void InstallerWorker::wipeDriveAndPartition(const QString &partedBin, const QString &devPath)
 {
     emit logMessage(QString("Preparing drive for %1 wipe (GPT)...").arg(efiInstall ? "EFI" : "BIOS/GRUB"));
 
@@ -497,23 +476,23 @@ void InstallerWorker::wipeDriveAndPartition(QProcess &process, const QString &pa
     bestEffortDetachDevice(devPath);
 
     // Extra safety: wipe signatures; zap any lingering GPT
-    QProcess::execute("sudo", {"wipefs", "-a", devPath});
+    tracedExecute("sudo", {"wipefs", "-a", devPath});
     const QString sgdisk = QStandardPaths::findExecutable("sgdisk");
     if (!sgdisk.isEmpty()) {
-        QProcess::execute("sudo", {sgdisk, "--zap-all", "--clear", devPath});
+        tracedExecute("sudo", {sgdisk, "--zap-all", "--clear", devPath});
     }
 
-    QProcess::execute("sudo", {"blockdev", "--rereadpt", devPath});
-    QProcess::execute("sudo", {"udevadm", "settle"});
+    tracedExecute("sudo", {"blockdev", "--rereadpt", devPath});
+    tracedExecute("sudo", {"udevadm", "settle"});
     QThread::sleep(1);
 
     // Create GPT label
-    if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mklabel", "gpt"}) != 0) {
+    if (tracedExecute("sudo", {partedBin, devPath, "--script", "mklabel", "gpt"}) != 0) {
         emit errorOccurred("Failed to create GPT partition table.");
         return;
     }
-    QProcess::execute("sudo", {"partprobe", devPath});
-    QProcess::execute("sudo", {"udevadm", "settle"});
+    tracedExecute("sudo", {"partprobe", devPath});
+    tracedExecute("sudo", {"udevadm", "settle"});
     QThread::sleep(1);
 
     // Partition layout
@@ -523,10 +502,8 @@ void InstallerWorker::wipeDriveAndPartition(QProcess &process, const QString &pa
         const QString espEnd   = "513MiB";
 
         // Determine last MiB by asking parted for disk size
-        process.start("sudo", {partedBin, devPath, "-m", "unit", "MiB", "print"});
-        process.waitForFinished();
         long long diskEndMiB = 0;
-        for (const QString &line : QString::fromUtf8(process.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts)) {
+        for (const QString &line : QString::fromUtf8(captureOutput("sudo", {partedBin, devPath, "-m", "unit", "MiB", "print"})).split('\n', Qt::SkipEmptyParts)) {
             // disk line example: /dev/sdb:51200MiB:scsi:512:512:gpt:...
             if (line.startsWith(devPath + ":")) {
                 const QStringList cols = line.split(':');
@@ -541,38 +518,36 @@ void InstallerWorker::wipeDriveAndPartition(QProcess &process, const QString &pa
         const QString rootStart = espEnd;
         const QString rootEnd   = QString::number(diskEndMiB - 1) + "MiB";
 
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "fat32", espStart, espEnd}) != 0 ||
-            QProcess::execute("sudo", {partedBin, devPath, "--script", "name", "1", "ESP"}) != 0 ||
-            QProcess::execute("sudo", {partedBin, devPath, "--script", "set",  "1", "esp", "on"}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "fat32", espStart, espEnd}) != 0 ||
+            tracedExecute("sudo", {partedBin, devPath, "--script", "name", "1", "ESP"}) != 0 ||
+            tracedExecute("sudo", {partedBin, devPath, "--script", "set",  "1", "esp", "on"}) != 0) {
             emit errorOccurred("Failed to create/flag ESP.");
             return;
         }
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
             emit errorOccurred("Failed to create root partition.");
             return;
         }
 
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         // Detect devices (assume #1 is ESP, last is root)
-        process.start("lsblk", QStringList() << "-ln" << "-o" << "NAME" << devPath);
-        process.waitForFinished();
-        const QStringList parts = QString::fromUtf8(process.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+        const QStringList parts = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME" << devPath)).split('\n', Qt::SkipEmptyParts);
         if (parts.size() < 2) { emit errorOccurred("Could not detect created partitions."); return; }
         const QString espPart  = "/dev/" + parts.first();
         const QString rootPart = "/dev/" + parts.last();
 
         // Format + mount
-        if (QProcess::execute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) { emit errorOccurred("Failed to format ESP."); return; }
-        if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
-        QProcess::execute("sudo", {"e2fsck", "-f", rootPart});
+        if (tracedExecute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) { emit errorOccurred("Failed to format ESP."); return; }
+        if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
+        tracedExecute("sudo", {"e2fsck", "-f", rootPart});
 
         emit logMessage("Mounting new partitions...");
-        QProcess::execute("sudo", {"mount", rootPart, "/mnt"});
-        QProcess::execute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
-        QProcess::execute("sudo", {"mount", espPart, "/mnt/boot/efi"});
+        tracedExecute("sudo", {"mount", rootPart, "/mnt"});
+        tracedExecute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
+        tracedExecute("sudo", {"mount", espPart, "/mnt/boot/efi"});
         recordTargetMountState(rootPart, espPart);
         emit installComplete();
         return;
@@ -581,20 +556,18 @@ void InstallerWorker::wipeDriveAndPartition(QProcess &process, const QString &pa
         const QString biosStart = "1MiB";
         const QString biosEnd   = "2MiB";
 
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStart, biosEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStart, biosEnd}) != 0) {
             emit errorOccurred("Failed to create bios_grub partition.");
             return;
         }
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "set", "1", "bios_grub", "on"}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "set", "1", "bios_grub", "on"}) != 0) {
             emit errorOccurred("Failed to set bios_grub flag.");
             return;
         }
 
         // Compute disk end and create root
-        process.start("sudo", {partedBin, devPath, "-m", "unit", "MiB", "print"});
-        process.waitForFinished();
         long long diskEndMiB = 0;
-        for (const QString &line : QString::fromUtf8(process.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts)) {
+        for (const QString &line : QString::fromUtf8(captureOutput("sudo", {partedBin, devPath, "-m", "unit", "MiB", "print"})).split('\n', Qt::SkipEmptyParts)) {
             if (line.startsWith(devPath + ":")) {
                 const QStringList cols = line.split(':');
                 if (cols.size() >= 2) {
@@ -608,27 +581,25 @@ void InstallerWorker::wipeDriveAndPartition(QProcess &process, const QString &pa
         const QString rootStart = "2MiB";
         const QString rootEnd   = QString::number(diskEndMiB - 1) + "MiB";
 
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
             emit errorOccurred("Failed to create root partition.");
             return;
         }
 
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         // Detect root (assume last)
-        process.start("lsblk", QStringList() << "-ln" << "-o" << "NAME" << devPath);
-        process.waitForFinished();
-        const QStringList parts = QString::fromUtf8(process.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+        const QStringList parts = QString::fromUtf8(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME" << devPath)).split('\n', Qt::SkipEmptyParts);
         if (parts.isEmpty()) { emit errorOccurred("Could not detect created root partition."); return; }
         const QString rootPart = "/dev/" + parts.last();
 
-        if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
-        QProcess::execute("sudo", {"e2fsck", "-f", rootPart});
+        if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
+        tracedExecute("sudo", {"e2fsck", "-f", rootPart});
 
         emit logMessage("Mounting root partition...");
-        QProcess::execute("sudo", {"mount", rootPart, "/mnt"});
+        tracedExecute("sudo", {"mount", rootPart, "/mnt"});
         recordTargetMountState(rootPart, QString());
         emit installComplete();
         return;
@@ -636,7 +607,6 @@ void InstallerWorker::wipeDriveAndPartition(QProcess &process, const QString &pa
 }
 
 bool InstallerWorker::getPartitionGeometry(const QString &targetPartition, const QString &selectedDrive, QString &startMiB, QString &endMiB) {
-    QProcess process;
     QString partName = targetPartition;
     if (partName.startsWith("/dev/"))
         partName = partName.mid(5);
@@ -649,9 +619,7 @@ bool InstallerWorker::getPartitionGeometry(const QString &targetPartition, const
     QString partNum = match.captured(1);
     emit logMessage(QString("DEBUG: Extracted partition number: %1").arg(partNum));
 
-    process.start("sudo", QStringList() << "parted" << "/dev/" + selectedDrive << "unit" << "MiB" << "print");
-    process.waitForFinished();
-    QString output = process.readAllStandardOutput();
+    QString output = captureOutput("sudo", QStringList() << "parted" << "/dev/" + selectedDrive << "unit" << "MiB" << "print");
     emit logMessage(QString("DEBUG: parted output:\n%1").arg(output));
 
     QRegularExpression partLineRe("^\\s*" + partNum + "\\s+([0-9.]+)MiB\\s+([0-9.]+)MiB", QRegularExpression::MultilineOption);
@@ -674,7 +642,7 @@ bool InstallerWorker::getPartitionGeometry(const QString &targetPartition, const
     return false;
 }
 
-void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QString &partedBin, const QString &devPath)
+void InstallerWorker::recreateFromSelectedPartition(const QString &partedBin, const QString &devPath)
 {
     // Query geometry before deletion
     QString startStr, endStr;
@@ -697,15 +665,15 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
     }
 
     // Unmount and delete selected partition
-    QProcess::execute("sudo", {"umount", "-l", targetPartition});
+    tracedExecute("sudo", {"umount", "-l", targetPartition});
     QString partNum = partitionNumberFromPath(targetPartition);
     if (partNum.isEmpty()) { emit errorOccurred("Could not determine selected partition number."); return; }
-    if (QProcess::execute("sudo", {partedBin, devPath, "--script", "rm", partNum}) != 0) {
+    if (tracedExecute("sudo", {partedBin, devPath, "--script", "rm", partNum}) != 0) {
         emit errorOccurred("Failed to delete selected partition.");
         return;
     }
-    QProcess::execute("sudo", {"partprobe", devPath});
-    QProcess::execute("sudo", {"udevadm", "settle"});
+    tracedExecute("sudo", {"partprobe", devPath});
+    tracedExecute("sudo", {"udevadm", "settle"});
     QThread::sleep(1);
 
     QString espPart, rootPart;
@@ -718,26 +686,26 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
 
             const QString rootStart = QString::number(startMiB) + "MiB";
             const QString rootEnd   = QString::number(endMiB - 1) + "MiB";
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
                 emit errorOccurred("Failed to create root (existing partition).");
                 return;
             }
 
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
 
             rootPart = detectNewPartitionNode(devPath, before);
             if (rootPart.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
             espPart  = existingEsp;
 
-            if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
-            QProcess::execute("sudo", {"e2fsck", "-f", rootPart});
+            if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
+            tracedExecute("sudo", {"e2fsck", "-f", rootPart});
 
             emit logMessage("Mounting root partition...");
-            if (QProcess::execute("sudo", {"mount", rootPart, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
-            QProcess::execute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
-            if (QProcess::execute("sudo", {"mount", espPart, "/mnt/boot/efi"}) != 0) {
+            if (tracedExecute("sudo", {"mount", rootPart, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
+            tracedExecute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
+            if (tracedExecute("sudo", {"mount", espPart, "/mnt/boot/efi"}) != 0) {
                 emit errorOccurred("Failed to mount existing ESP at /mnt/boot/efi.");
                 return;
             }
@@ -753,12 +721,12 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
 
         const QString espStart = QString::number(startMiB) + "MiB";
         const QString espEnd   = QString::number(startMiB + 512) + "MiB";
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "fat32", espStart, espEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "fat32", espStart, espEnd}) != 0) {
             emit errorOccurred("Failed to create ESP (existing partition).");
             return;
         }
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         espPart = detectNewPartitionNode(devPath, baseline);
@@ -766,32 +734,32 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
 
         const QString espNum = partitionNumberFromPath(espPart);
         if (espNum.isEmpty()) { emit errorOccurred("Could not determine ESP partition number."); return; }
-        QProcess::execute("sudo", {partedBin, devPath, "--script", "name", espNum, "ESP"});
-        QProcess::execute("sudo", {partedBin, devPath, "--script", "set",  espNum, "esp", "on"});
+        tracedExecute("sudo", {partedBin, devPath, "--script", "name", espNum, "ESP"});
+        tracedExecute("sudo", {partedBin, devPath, "--script", "set",  espNum, "esp", "on"});
 
         const QSet<QString> beforeRoot = childPartitionsSet(devPath);
         const QString rootStart = espEnd;
         const QString rootEnd   = QString::number(endMiB - 1) + "MiB";
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
             emit errorOccurred("Failed to create root (existing partition).");
             return;
         }
 
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         rootPart = detectNewPartitionNode(devPath, beforeRoot);
         if (rootPart.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
 
-        if (QProcess::execute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) { emit errorOccurred("Failed to format ESP."); return; }
-        if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
-        QProcess::execute("sudo", {"e2fsck", "-f", rootPart});
+        if (tracedExecute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) { emit errorOccurred("Failed to format ESP."); return; }
+        if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) { emit errorOccurred("Failed to format root."); return; }
+        tracedExecute("sudo", {"e2fsck", "-f", rootPart});
 
         emit logMessage("Mounting root partition...");
-        if (QProcess::execute("sudo", {"mount", rootPart, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
-        QProcess::execute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
-        QProcess::execute("sudo", {"mount", espPart, "/mnt/boot/efi"});
+        if (tracedExecute("sudo", {"mount", rootPart, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
+        tracedExecute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
+        tracedExecute("sudo", {"mount", espPart, "/mnt/boot/efi"});
 
         recordTargetMountState(rootPart, espPart);
 
@@ -816,12 +784,12 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
             const QString biosStartStr = QString::number(startMiB) + "MiB";
             const QString biosEndStr   = QString::number(biosEndMiB) + "MiB";
             const QSet<QString> beforeBios = childPartitionsSet(devPath);
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStartStr, biosEndStr}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStartStr, biosEndStr}) != 0) {
                 emit errorOccurred("Failed to create bios_grub partition.");
                 return;
             }
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
 
             const QString biosPart = detectNewPartitionNode(devPath, beforeBios);
@@ -834,7 +802,7 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
                 emit errorOccurred("Could not determine bios_grub partition number.");
                 return;
             }
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "set", biosNum, "bios_grub", "on"}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "set", biosNum, "bios_grub", "on"}) != 0) {
                 emit errorOccurred("Failed to set bios_grub flag.");
                 return;
             }
@@ -844,7 +812,7 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
         }
 
         const QSet<QString> before = childPartitionsSet(devPath);
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStartMiBStr, rootEndMiBStr}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStartMiBStr, rootEndMiBStr}) != 0) {
         const QString existingBios = findExistingBiosGrub(partedBin, devPath);
         if (!existingBios.isEmpty()) {
             emit logMessage(QString("Found existing bios_grub partition: %1").arg(existingBios));
@@ -853,19 +821,19 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
 
             const QString rootStart = QString::number(startMiB) + "MiB";
             const QString rootEnd   = QString::number(endMiB - 1) + "MiB";
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
                 emit errorOccurred("Failed to create root (existing partition).");
                 return;
             }
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
 
             const QString rootDev = detectNewPartitionNode(devPath, before);
             if (rootDev.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
 
-            if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) { emit errorOccurred("Failed to format root."); return; }
-            QProcess::execute("sudo", {"e2fsck", "-f", rootDev});
+            if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) { emit errorOccurred("Failed to format root."); return; }
+            tracedExecute("sudo", {"e2fsck", "-f", rootDev});
 
 
 
@@ -873,22 +841,22 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
 
             const QString rootStart = QString::number(startMiB) + "MiB";
             const QString rootEnd   = QString::number(endMiB - 1) + "MiB";
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
                 emit errorOccurred("Failed to create root (existing partition).");
                 return;
             }
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
 
             const QString rootDev = detectNewPartitionNode(devPath, before);
             if (rootDev.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
 
-            if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) { emit errorOccurred("Failed to format root."); return; }
-            QProcess::execute("sudo", {"e2fsck", "-f", rootDev});
+            if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) { emit errorOccurred("Failed to format root."); return; }
+            tracedExecute("sudo", {"e2fsck", "-f", rootDev});
 
             emit logMessage("Mounting root partition...");
-            if (QProcess::execute("sudo", {"mount", rootDev, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
+            if (tracedExecute("sudo", {"mount", rootDev, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
 
             recordTargetMountState(rootDev, QString());
 
@@ -906,12 +874,12 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
         const QString biosStart = QString::number(startMiB) + "MiB";
         const QString biosEnd   = QString::number(biosEndMiB) + "MiB";
         const QSet<QString> beforeBios = childPartitionsSet(devPath);
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStart, biosEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStart, biosEnd}) != 0) {
             emit errorOccurred("Failed to create bios_grub partition.");
             return;
         }
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         const QString biosPart = detectNewPartitionNode(devPath, beforeBios);
@@ -924,7 +892,7 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
             emit errorOccurred("Could not determine bios_grub partition number.");
             return;
         }
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "set", biosNum, "bios_grub", "on"}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "set", biosNum, "bios_grub", "on"}) != 0) {
             emit errorOccurred("Failed to flag bios_grub partition.");
             return;
         }
@@ -932,7 +900,7 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
 
 
             emit logMessage("Mounting root partition...");
-            if (QProcess::execute("sudo", {"mount", rootDev, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
+            if (tracedExecute("sudo", {"mount", rootDev, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
 
             emit installComplete();
             return;
@@ -943,22 +911,22 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
 
             const QString rootStart = QString::number(startMiB) + "MiB";
             const QString rootEnd   = QString::number(endMiB - 1) + "MiB";
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
                 emit errorOccurred("Failed to create root (existing partition).");
                 return;
             }
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
 
             const QString rootDev = detectNewPartitionNode(devPath, before);
             if (rootDev.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
 
-            if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) { emit errorOccurred("Failed to format root."); return; }
-            QProcess::execute("sudo", {"e2fsck", "-f", rootDev});
+            if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) { emit errorOccurred("Failed to format root."); return; }
+            tracedExecute("sudo", {"e2fsck", "-f", rootDev});
 
             emit logMessage("Mounting root partition...");
-            if (QProcess::execute("sudo", {"mount", rootDev, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
+            if (tracedExecute("sudo", {"mount", rootDev, "/mnt"}) != 0) { emit errorOccurred("Failed to mount root at /mnt."); return; }
 
             emit installComplete();
             return;
@@ -980,12 +948,12 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
         const QString biosStart = QString::number(startMiB) + "MiB";
         const QString biosEnd   = QString::number(biosEndMiB) + "MiB";
         const QSet<QString> beforeBios = childPartitionsSet(devPath);
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStart, biosEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", biosStart, biosEnd}) != 0) {
             emit errorOccurred("Failed to create bios_grub partition.");
             return;
         }
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         const QString biosPart = detectNewPartitionNode(devPath, beforeBios);
@@ -998,7 +966,7 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
             emit errorOccurred("Could not determine bios_grub partition number.");
             return;
         }
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "set", biosNum, "bios_grub", "on"}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "set", biosNum, "bios_grub", "on"}) != 0) {
             emit errorOccurred("Failed to flag bios_grub partition.");
             return;
         }
@@ -1013,12 +981,12 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
         const QString rootStart = QString::number(rootStartMiB) + "MiB";
         const QString rootEnd   = QString::number(endMiB - 1) + "MiB";
         const QSet<QString> beforeRoot = childPartitionsSet(devPath);
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", rootStart, rootEnd}) != 0) {
             emit errorOccurred("Failed to create root (existing partition).");
             return;
         }
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         const QString rootDev = detectNewPartitionNode(devPath, beforeRoot);
@@ -1027,14 +995,14 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
             return;
         }
 
-        if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) {
+        if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootDev}) != 0) {
             emit errorOccurred("Failed to format root.");
             return;
         }
-        QProcess::execute("sudo", {"e2fsck", "-f", rootDev});
+        tracedExecute("sudo", {"e2fsck", "-f", rootDev});
 
         emit logMessage("Mounting root partition...");
-        if (QProcess::execute("sudo", {"mount", rootDev, "/mnt"}) != 0) {
+        if (tracedExecute("sudo", {"mount", rootDev, "/mnt"}) != 0) {
             emit errorOccurred("Failed to mount root at /mnt.");
             return;
         }
@@ -1046,7 +1014,7 @@ void InstallerWorker::recreateFromSelectedPartition(QProcess &process, const QSt
     }
 }
 
-void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &partedBin, const QString &devPath)
+void InstallerWorker::createFromFreeSpace(const QString &partedBin, const QString &devPath)
 {
     // Helper to format exact "123MiB" tokens (no scientific notation)
     auto miB = [](double v) -> QString {
@@ -1065,9 +1033,7 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
     }
 
     emit logMessage("Searching for free space…");
-    process.start("sudo", {partedBin, devPath, "-m", "unit", "MiB", "print", "free"});
-    process.waitForFinished();
-    const QString out = process.readAllStandardOutput();
+    const QString out = captureOutput("sudo", {partedBin, devPath, "-m", "unit", "MiB", "print", "free"});
     const QStringList lines = out.split('\n', Qt::SkipEmptyParts);
 
     QString bestStartStr, bestEndStr;
@@ -1149,14 +1115,14 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
             const QSet<QString> before = childPartitionsSet(devPath);
             const QString rootStart = miB(startMiB);
             const QString rootEnd   = miB(endMiB - 1.0);
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script",
+            if (tracedExecute("sudo", {partedBin, devPath, "--script",
                                            "mkpart", "primary", "ext4",
                                            rootStart, rootEnd}) != 0) {
                 emit errorOccurred("Failed to create root partition (free space).");
                 return;
             }
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
             rootPart = detectNewPartitionNode(devPath, before);
             if (rootPart.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
@@ -1166,14 +1132,14 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
             const QString espStart = miB(startMiB);
             const QString espEnd   = miB(startMiB + 512.0);
 
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script",
+            if (tracedExecute("sudo", {partedBin, devPath, "--script",
                                            "mkpart", "primary", "fat32",
                                            espStart, espEnd}) != 0) {
                 emit errorOccurred("Failed to create ESP (free space).");
                 return;
             }
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
             espPart = detectNewPartitionNode(devPath, beforeEsp);
             if (espPart.isEmpty()) { emit errorOccurred("Could not uniquely detect new ESP."); return; }
@@ -1183,8 +1149,8 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
             if (espNum.isEmpty()) { emit errorOccurred("Could not determine ESP partition number."); return; }
 
             // Name + flag
-            QProcess::execute("sudo", {partedBin, devPath, "--script", "name", espNum, "ESP"});
-            QProcess::execute("sudo", {partedBin, devPath, "--script", "set",  espNum, "esp", "on"});
+            tracedExecute("sudo", {partedBin, devPath, "--script", "name", espNum, "ESP"});
+            tracedExecute("sudo", {partedBin, devPath, "--script", "set",  espNum, "esp", "on"});
 
             createdNewEsp = true;
 
@@ -1192,14 +1158,14 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
             const QSet<QString> beforeRoot = childPartitionsSet(devPath);
             const QString rootStart = espEnd;
             const QString rootEnd   = miB(endMiB - 1.0);
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script",
+            if (tracedExecute("sudo", {partedBin, devPath, "--script",
                                            "mkpart", "primary", "ext4",
                                            rootStart, rootEnd}) != 0) {
                 emit errorOccurred("Failed to create root partition (free space).");
                 return;
             }
-            QProcess::execute("sudo", {"partprobe", devPath});
-            QProcess::execute("sudo", {"udevadm", "settle"});
+            tracedExecute("sudo", {"partprobe", devPath});
+            tracedExecute("sudo", {"udevadm", "settle"});
             QThread::sleep(1);
             rootPart = detectNewPartitionNode(devPath, beforeRoot);
             if (rootPart.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
@@ -1208,7 +1174,7 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
         // Format/mount:
         if (createdNewEsp) {
             emit logMessage("Formatting new ESP as FAT32…");
-            if (QProcess::execute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) {
+            if (tracedExecute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) {
                 emit errorOccurred("Failed to format new ESP.");
                 return;
             }
@@ -1217,16 +1183,16 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
         }
 
         emit logMessage("Formatting root as ext4…");
-        if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) {
+        if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) {
             emit errorOccurred("Failed to format root.");
             return;
         }
-        QProcess::execute("sudo", {"e2fsck", "-f", rootPart});
+        tracedExecute("sudo", {"e2fsck", "-f", rootPart});
 
         emit logMessage("Mounting partitions…");
-        QProcess::execute("sudo", {"mount", rootPart, "/mnt"});
-        QProcess::execute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
-        QProcess::execute("sudo", {"mount", espPart, "/mnt/boot/efi"});
+        tracedExecute("sudo", {"mount", rootPart, "/mnt"});
+        tracedExecute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
+        tracedExecute("sudo", {"mount", espPart, "/mnt/boot/efi"});
 
         emit installComplete();
         return;
@@ -1237,28 +1203,28 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
         const QSet<QString> before = childPartitionsSet(devPath);
         const QString rootStart = miB(startMiB);
         const QString rootEnd   = miB(endMiB - 1.0);
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script",
+        if (tracedExecute("sudo", {partedBin, devPath, "--script",
                                        "mkpart", "primary", "ext4",
                                        rootStart, rootEnd}) != 0) {
             emit errorOccurred("Failed to create root partition (free space).");
             return;
         }
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         QString rootPartNew = detectNewPartitionNode(devPath, before);
         if (rootPartNew.isEmpty()) { emit errorOccurred("Could not uniquely detect new root partition."); return; }
 
         emit logMessage("Formatting root as ext4…");
-        if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootPartNew}) != 0) {
+        if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootPartNew}) != 0) {
             emit errorOccurred("Failed to format root.");
             return;
         }
-        QProcess::execute("sudo", {"e2fsck", "-f", rootPartNew});
+        tracedExecute("sudo", {"e2fsck", "-f", rootPartNew});
 
         emit logMessage("Mounting root partition…");
-        if (QProcess::execute("sudo", {"mount", rootPartNew, "/mnt"}) != 0) {
+        if (tracedExecute("sudo", {"mount", rootPartNew, "/mnt"}) != 0) {
             emit errorOccurred("Failed to mount root at /mnt.");
             return;
         }
@@ -1270,7 +1236,6 @@ void InstallerWorker::createFromFreeSpace(QProcess &process, const QString &part
 
 void InstallerWorker::run() {
     qputenv("PATH", QByteArray("/usr/sbin:/usr/bin:/sbin:/bin:") + qgetenv("PATH"));
-    QProcess process;
     QString partedBin = locatePartedBinary();
     if (partedBin.isEmpty()) {
         emit errorOccurred("parted not found");
@@ -1291,48 +1256,46 @@ void InstallerWorker::run() {
         emit logMessage(efiInstall ? "Preparing drive for EFI (GPT + ESP + root)" : "Preparing drive for BIOS/GRUB (GPT + bios_grub + root)");
 
         // Create GPT label
-        if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mklabel", "gpt"}) != 0) {
+        if (tracedExecute("sudo", {partedBin, devPath, "--script", "mklabel", "gpt"}) != 0) {
             emit errorOccurred("Failed to create GPT partition table.");
             return;
         }
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         if (efiInstall) {
             // ESP (fat32, 1MiB-513MiB)
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "fat32", "1MiB", "513MiB"}) != 0 ||
-                QProcess::execute("sudo", {partedBin, devPath, "--script", "name", "1", "ESP"}) != 0 ||
-                QProcess::execute("sudo", {partedBin, devPath, "--script", "set", "1", "esp", "on"}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "fat32", "1MiB", "513MiB"}) != 0 ||
+                tracedExecute("sudo", {partedBin, devPath, "--script", "name", "1", "ESP"}) != 0 ||
+                tracedExecute("sudo", {partedBin, devPath, "--script", "set", "1", "esp", "on"}) != 0) {
                 emit errorOccurred("Failed to create/set ESP partition.");
                 return;
             }
             // Root partition
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", "513MiB", "100%"}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", "513MiB", "100%"}) != 0) {
                 emit errorOccurred("Failed to create root partition.");
                 return;
             }
         } else {
             // bios_grub (EF02, 1MiB-3MiB)
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "1MiB", "3MiB"}) != 0 ||
-                QProcess::execute("sudo", {partedBin, devPath, "--script", "set", "1", "bios_grub", "on"}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "1MiB", "3MiB"}) != 0 ||
+                tracedExecute("sudo", {partedBin, devPath, "--script", "set", "1", "bios_grub", "on"}) != 0) {
                 emit errorOccurred("Failed to create/set bios_grub partition.");
                 return;
             }
             // Root partition
-            if (QProcess::execute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", "3MiB", "100%"}) != 0) {
+            if (tracedExecute("sudo", {partedBin, devPath, "--script", "mkpart", "primary", "ext4", "3MiB", "100%"}) != 0) {
                 emit errorOccurred("Failed to create root partition.");
                 return;
             }
         }
-        QProcess::execute("sudo", {"partprobe", devPath});
-        QProcess::execute("sudo", {"udevadm", "settle"});
+        tracedExecute("sudo", {"partprobe", devPath});
+        tracedExecute("sudo", {"udevadm", "settle"});
         QThread::sleep(1);
 
         // Find partitions: lsblk -ln -o NAME
-        process.start("lsblk", QStringList() << "-ln" << "-o" << "NAME" << devPath);
-        process.waitForFinished();
-        QStringList parts = QString(process.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+        QStringList parts = QString(captureOutput("lsblk", QStringList() << "-ln" << "-o" << "NAME" << devPath)).split('\n', Qt::SkipEmptyParts);
 
         QString espPart, rootPart;
         if (efiInstall && parts.size() >= 2) {
@@ -1347,24 +1310,24 @@ void InstallerWorker::run() {
 
         if (efiInstall) {
             emit logMessage("Formatting ESP as FAT32...");
-            if (QProcess::execute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) {
+            if (tracedExecute("sudo", {"mkfs.fat", "-F32", espPart}) != 0) {
                 emit errorOccurred("Failed to format ESP.");
                 return;
             }
         }
         emit logMessage("Formatting root as ext4...");
-        if (QProcess::execute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) {
+        if (tracedExecute("sudo", {"mkfs.ext4", "-F", rootPart}) != 0) {
             emit errorOccurred("Failed to format root partition.");
             return;
         }
-        QProcess::execute("sudo", {"e2fsck", "-f", rootPart});
+        tracedExecute("sudo", {"e2fsck", "-f", rootPart});
 
         // Mount root and ESP/bios_grub
         emit logMessage("Mounting new partitions...");
-        QProcess::execute("sudo", {"mount", rootPart, "/mnt"});
+        tracedExecute("sudo", {"mount", rootPart, "/mnt"});
         if (efiInstall) {
-            QProcess::execute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
-            QProcess::execute("sudo", {"mount", espPart, "/mnt/boot/efi"});
+            tracedExecute("sudo", {"mkdir", "-p", "/mnt/boot/efi"});
+            tracedExecute("sudo", {"mount", espPart, "/mnt/boot/efi"});
         }
 
         recordTargetMountState(rootPart, efiInstall ? espPart : QString());
@@ -1375,13 +1338,13 @@ void InstallerWorker::run() {
 
     // ----- Use Free Space -----
     if (mode == InstallMode::UseFreeSpace) {
-        createFromFreeSpace(process, partedBin, devPath);
+        createFromFreeSpace(partedBin, devPath);
         return;
     }
 
     // ----- Use Existing Partition -----
     if (mode == InstallMode::UsePartition) {
-        recreateFromSelectedPartition(process, partedBin, devPath);
+        recreateFromSelectedPartition(partedBin, devPath);
         return;
     }
 }
@@ -38,9 +38,9 @@ private:
     void setEfiMode(bool enabled);
     bool efiInstall = false;
     bool getPartitionGeometry(const QString &targetPartition, const QString &selectedDrive, QString &startMiB, QString &endMiB);
-    void createFromFreeSpace(QProcess &process, const QString &partedBin, const QString &devPath);
-    void recreateFromSelectedPartition(QProcess &process, const QString &partedBin, const QString &devPath);
-    void wipeDriveAndPartition(QProcess &process, const QString &partedBin, const QString &devPath);
+    void createFromFreeSpace(const QString &partedBin, const QString &devPath);
+    void recreateFromSelectedPartition(const QString &partedBin, const QString &devPath);
+    void wipeDriveAndPartition(const QString &partedBin, const QString &devPath);
 };
 
 #endif // INSTALLERWORKER_H
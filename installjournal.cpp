@@ -0,0 +1,134 @@
+#include "installjournal.h"
+#include "mounttable.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QMutex>
+#include <QSaveFile>
+
+static const int kJournalVersion = 1;
+
+// Serializes the read-modify-write cycles across threads
+static QMutex journalLock;
+
+// This process's idea of the target devices
+static InstallJournal::Target processTarget;
+
+InstallJournal::InstallJournal(const QString &targetRoot) : m_root(targetRoot) {}
+
+QString InstallJournal::filePath() const
+{
+    return m_root + QStringLiteral("/var/lib/archaid/install-journal.json");
+}
+
+QJsonObject InstallJournal::read() const
+{
+    QFile f(filePath());
+    if (!f.open(QIODevice::ReadOnly))
+        return QJsonObject();
+
+    QJsonParseError err{};
+    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &err);
+    if (err.error != QJsonParseError::NoError || !doc.isObject())
+        return QJsonObject();
+
+    const QJsonObject obj = doc.object();
+    if (obj.value(QStringLiteral("version")).toInt() != kJournalVersion)
+        return QJsonObject();
+    return obj;
+}
+
+bool InstallJournal::write(const QJsonObject &doc) const
+{
+    // Never drop a journal into the host's empty /mnt directory
+    MountTable mounts;
+    if (!mounts.isMountPoint(m_root))
+        return false;
+
+    QJsonObject out = doc;
+    out.insert(QStringLiteral("version"), kJournalVersion);
+
+    QDir().mkpath(QFileInfo(filePath()).absolutePath());
+    QSaveFile f(filePath());
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    f.write(QJsonDocument(out).toJson(QJsonDocument::Indented));
+    return f.commit();
+}
+
+void InstallJournal::reset(const Target &target)
+{
+    QMutexLocker locker(&journalLock);
+    processTarget = target;
+
+    QJsonObject t;
+    t.insert(QStringLiteral("root"), target.root);
+    if (!target.esp.isEmpty())
+        t.insert(QStringLiteral("esp"), target.esp);
+
+    QJsonObject doc;
+    doc.insert(QStringLiteral("target"), t);
+    doc.insert(QStringLiteral("steps"), QJsonObject());
+    write(doc);
+}
+
+InstallJournal::Target InstallJournal::target() const
+{
+    QMutexLocker locker(&journalLock);
+    if (!processTarget.isEmpty())
+        return processTarget;
+
+    const QJsonObject t = read().value(QStringLiteral("target")).toObject();
+    Target target;
+    target.root = t.value(QStringLiteral("root")).toString();
+    target.esp = t.value(QStringLiteral("esp")).toString();
+    return target;
+}
+
+void InstallJournal::setTarget(const Target &target)
+{
+    QMutexLocker locker(&journalLock);
+    processTarget = target;
+
+    QJsonObject doc = read();
+    QJsonObject t;
+    t.insert(QStringLiteral("root"), target.root);
+    if (!target.esp.isEmpty())
+        t.insert(QStringLiteral("esp"), target.esp);
+    doc.insert(QStringLiteral("target"), t);
+    write(doc);
+}
+
+bool InstallJournal::isComplete(const QString &step, const QByteArray &fingerprint) const
+{
+    QMutexLocker locker(&journalLock);
+    const QJsonObject entry = read().value(QStringLiteral("steps")).toObject().value(step).toObject();
+    return !entry.isEmpty()
+           && entry.value(QStringLiteral("inputs")).toString() == QString::fromLatin1(fingerprint);
+}
+
+void InstallJournal::markComplete(const QString &step, const QByteArray &fingerprint, const QStringList &outputs)
+{
+    QMutexLocker locker(&journalLock);
+    QJsonObject doc = read();
+    QJsonObject steps = doc.value(QStringLiteral("steps")).toObject();
+
+    QJsonObject entry;
+    entry.insert(QStringLiteral("inputs"), QString::fromLatin1(fingerprint));
+    entry.insert(QStringLiteral("outputs"), QJsonArray::fromStringList(outputs));
+    entry.insert(QStringLiteral("completed"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    steps.insert(step, entry);
+
+    doc.insert(QStringLiteral("steps"), steps);
+    write(doc);
+}
+
+QStringList InstallJournal::completedSteps() const
+{
+    QMutexLocker locker(&journalLock);
+    return read().value(QStringLiteral("steps")).toObject().keys();
+}
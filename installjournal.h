@@ -0,0 +1,51 @@
+#ifndef INSTALLJOURNAL_H
+#define INSTALLJOURNAL_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+// Checkpoint record kept on the install target itself
+// (<root>/var/lib/archaid/install-journal.json).
+//
+// It holds the target's root/ESP devices, as chosen by the partitioning
+// step, and one entry per completed install step: a fingerprint of the
+// step's inputs plus the artifacts it produced. A restarted install skips
+// every step whose entry matches, so it resumes at the first one that did
+// not finish.
+//
+// Each change is a read-modify-write of the file (atomic rename), so several
+// instances can be used side by side. The target devices are also kept in
+// memory for this process; that's what the installer uses while /mnt is not
+// mounted yet.
+class InstallJournal {
+public:
+    struct Target {
+        QString root;
+        QString esp;
+        bool isEmpty() const { return root.isEmpty(); }
+    };
+
+    explicit InstallJournal(const QString &targetRoot = QStringLiteral("/mnt"));
+
+    QString filePath() const;
+
+    // A freshly partitioned target: forget every step recorded before
+    void reset(const Target &target);
+
+    Target target() const;
+    void setTarget(const Target &target);
+
+    bool isComplete(const QString &step, const QByteArray &fingerprint) const;
+    void markComplete(const QString &step, const QByteArray &fingerprint, const QStringList &outputs);
+    QStringList completedSteps() const;
+
+private:
+    QJsonObject read() const;
+    bool write(const QJsonObject &doc) const;
+
+    QString m_root;
+};
+
+#endif // INSTALLJOURNAL_H
@@ -0,0 +1,226 @@
+#include "installscheduler.h"
+#include "installjournal.h"
+#include "installtrace.h"
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QQueue>
+#include <QSet>
+#include <QThread>
+#include <QWaitCondition>
+#include <memory>
+#include <utility>
+#include <vector>
+
+bool InstallScheduler::buildGraph(QList<QList<int>> *dependents, QList<int> *pendingInputs)
+{
+    QHash<QString, int> producer;
+    for (int i = 0; i < m_steps.size(); ++i) {
+        for (const QString &out : m_steps.at(i).outputs) {
+            if (producer.contains(out)) {
+                m_error = QStringLiteral("'%1' is produced by both '%2' and '%3'.")
+                              .arg(out, m_steps.at(producer.value(out)).name, m_steps.at(i).name);
+                return false;
+            }
+            producer.insert(out, i);
+        }
+    }
+
+    dependents->clear();
+    pendingInputs->clear();
+    m_producers.clear();
+    m_fingerprints.clear();
+    for (int i = 0; i < m_steps.size(); ++i) {
+        dependents->append(QList<int>());
+        pendingInputs->append(0);
+        m_producers.append(QList<int>());
+        m_fingerprints.append(QByteArray());
+    }
+
+    for (int i = 0; i < m_steps.size(); ++i) {
+        QSet<int> deps;
+        for (const QString &in : m_steps.at(i).inputs) {
+            if (!producer.contains(in)) {
+                m_error = QStringLiteral("Step '%1' needs '%2', which no step produces.")
+                              .arg(m_steps.at(i).name, in);
+                return false;
+            }
+            const int p = producer.value(in);
+            if (!deps.contains(p))
+                m_producers[i].append(p);
+            deps.insert(p);
+        }
+        for (int d : std::as_const(deps)) {
+            (*dependents)[d].append(i);
+            ++(*pendingInputs)[i];
+        }
+    }
+    return true;
+}
+
+// Only valid once every producer of the step's inputs has a fingerprint
+QByteArray InstallScheduler::fingerprint(int idx) const
+{
+    const Step &step = m_steps.at(idx);
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(step.name.toUtf8());
+    hash.addData("\n");
+    hash.addData(QJsonDocument(step.params).toJson(QJsonDocument::Compact));
+    for (int p : m_producers.at(idx)) {
+        hash.addData("\n");
+        hash.addData(m_fingerprints.at(p));
+    }
+    return hash.result().toHex();
+}
+
+bool InstallScheduler::run(int workers)
+{
+    m_error.clear();
+    m_failed.clear();
+
+    QList<QList<int>> dependents;
+    QList<int> pendingInputs;
+    if (!buildGraph(&dependents, &pendingInputs))
+        return false;
+
+    enum State { Waiting, Running, Done };
+    QList<State> state;
+    for (int i = 0; i < m_steps.size(); ++i)
+        state.append(Waiting);
+
+    QMutex lock;
+    QWaitCondition workReady;
+    QWaitCondition stepDone;
+    QQueue<int> queue;                     // dispatched, not yet picked up
+    QQueue<QPair<int, bool>> completions;  // finished, not yet accounted for
+    bool quit = false;
+
+    int workerSerial = 0;
+    auto workerLoop = [&]() {
+        QMutexLocker locker(&lock);
+        InstallTrace::setThreadName(QStringLiteral("install worker %1").arg(++workerSerial));
+        for (;;) {
+            while (queue.isEmpty() && !quit)
+                workReady.wait(&lock);
+            if (queue.isEmpty())
+                return;
+            const int idx = queue.dequeue();
+            locker.unlock();
+            bool ok = true;
+            {
+                InstallTrace::Span span(QStringLiteral("step"), m_steps.at(idx).name);
+                if (m_steps.at(idx).action)
+                    ok = m_steps.at(idx).action();
+                span.setArg(QStringLiteral("ok"), ok);
+            }
+            locker.relock();
+            completions.enqueue(qMakePair(idx, ok));
+            stepDone.wakeOne();
+        }
+    };
+
+    const int threadCount = qMax(1, qMin(workers, m_steps.size()));
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back(QThread::create(workerLoop));
+        threads.back()->start();
+    }
+
+    QSet<QString> heldResources;
+    int running = 0;
+    int finished = 0;
+    bool failed = false;
+
+    QMutexLocker locker(&lock);
+    for (;;) {
+        // Start everything whose inputs exist and whose resources are free.
+        // Steps the journal already has are completed on the spot, which can
+        // make further steps ready, hence the outer loop.
+        bool progressed = !failed;
+        while (progressed) {
+            progressed = false;
+            for (int i = 0; i < m_steps.size(); ++i) {
+                if (state.at(i) != Waiting || pendingInputs.at(i) > 0)
+                    continue;
+                const Step &step = m_steps.at(i);
+                const bool firstLook = m_fingerprints.at(i).isEmpty();
+                if (firstLook)
+                    m_fingerprints[i] = fingerprint(i);
+
+                if (firstLook && m_journal && step.checkpoint
+                    && m_journal->isComplete(step.name, m_fingerprints.at(i))
+                    && (!step.verify || step.verify())) {
+                    state[i] = Done;
+                    ++finished;
+                    for (int dep : dependents.at(i))
+                        --pendingInputs[dep];
+                    if (m_log)
+                        m_log(QStringLiteral("Skipping '%1': already completed (install journal).").arg(step.name));
+                    progressed = true;
+                    continue;
+                }
+
+                bool busy = false;
+                for (const QString &r : step.resources)
+                    busy = busy || heldResources.contains(r);
+                if (busy)
+                    continue;
+                for (const QString &r : step.resources)
+                    heldResources.insert(r);
+                state[i] = Running;
+                ++running;
+                queue.enqueue(i);
+                workReady.wakeOne();
+            }
+        }
+
+        if (running == 0)
+            break;
+
+        while (completions.isEmpty())
+            stepDone.wait(&lock);
+
+        while (!completions.isEmpty()) {
+            const QPair<int, bool> c = completions.dequeue();
+            const int idx = c.first;
+            state[idx] = Done;
+            --running;
+            ++finished;
+            for (const QString &r : m_steps.at(idx).resources)
+                heldResources.remove(r);
+            if (!c.second) {
+                failed = true;
+                m_failed << m_steps.at(idx).name;
+                continue;
+            }
+            for (int dep : dependents.at(idx))
+                --pendingInputs[dep];
+            if (m_journal && m_steps.at(idx).checkpoint)
+                m_journal->markComplete(m_steps.at(idx).name, m_fingerprints.at(idx), m_steps.at(idx).outputs);
+        }
+    }
+
+    quit = true;
+    workReady.wakeAll();
+    locker.unlock();
+    for (auto &t : threads)
+        t->wait();
+
+    if (failed) {
+        m_error = QStringLiteral("Install step failed: %1").arg(m_failed.join(", "));
+        return false;
+    }
+    if (finished != m_steps.size()) {
+        QStringList stuck;
+        for (int i = 0; i < m_steps.size(); ++i) {
+            if (state.at(i) == Waiting)
+                stuck << m_steps.at(i).name;
+        }
+        m_error = QStringLiteral("Install steps could not be scheduled (dependency cycle?): %1")
+                      .arg(stuck.join(", "));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef INSTALLSCHEDULER_H
+#define INSTALLSCHEDULER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+class InstallJournal;
+
+// Runs install steps as a dependency graph.
+//
+// Each step names the artifacts it needs (inputs) and the ones it produces
+// (outputs); edges are derived from those, so steps only wait for what they
+// actually consume. Resources are exclusive locks held for the duration of
+// a step (e.g. "pacman" for anything that takes the package database lock).
+// Ready steps are started in insertion order on up to N worker threads.
+//
+// With a journal attached, every step gets a fingerprint over its name, its
+// params and the fingerprints of the steps producing its inputs. A step whose
+// fingerprint is already recorded as complete, and whose verify() check
+// still passes, is skipped; finished steps are recorded as they complete.
+class InstallScheduler {
+public:
+    struct Step {
+        QString name;
+        QStringList inputs;
+        QStringList outputs;
+        QStringList resources;
+        std::function<bool()> action;   // false: the install cannot continue
+        QJsonObject params;             // settings the step's result depends on
+        std::function<bool()> verify;   // cheap check that its outputs still exist
+        bool checkpoint = true;         // false: always rerun (not worth trusting a record)
+    };
+
+    void addStep(const Step &step) { m_steps.append(step); }
+    void setJournal(InstallJournal *journal) { m_journal = journal; }
+    void setLogHandler(const std::function<void(const QString &)> &log) { m_log = log; }
+
+    // Blocks until every step ran or one failed. After a failure nothing new
+    // is started; steps already running are allowed to finish.
+    bool run(int workers);
+
+    QString errorString() const { return m_error; }
+    QStringList failedSteps() const { return m_failed; }
+
+private:
+    bool buildGraph(QList<QList<int>> *dependents, QList<int> *pendingInputs);
+    QByteArray fingerprint(int idx) const;
+
+    QList<Step> m_steps;
+    QList<QList<int>> m_producers;      // per step: the steps its inputs come from
+    QList<QByteArray> m_fingerprints;
+    InstallJournal *m_journal = nullptr;
+    std::function<void(const QString &)> m_log;
+    QString m_error;
+    QStringList m_failed;
+};
+
+#endif // INSTALLSCHEDULER_H
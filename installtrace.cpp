@@ -0,0 +1,157 @@
+#include "installtrace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QPair>
+#include <QSaveFile>
+#include <QVector>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+struct TraceEvent {
+    QString category;
+    QString name;
+    qint64 start;
+    qint64 duration;
+    qint64 tid;
+    QJsonObject args;
+};
+
+struct TraceState {
+    QMutex lock;
+    QElapsedTimer clock;
+    QVector<TraceEvent> events;
+    QVector<QPair<qint64, QString>> threadNames;
+
+    TraceState() { clock.start(); }
+};
+
+TraceState &state()
+{
+    static TraceState s;
+    return s;
+}
+
+qint64 currentTid()
+{
+    return static_cast<qint64>(syscall(SYS_gettid));
+}
+
+} // namespace
+
+InstallTrace::Span::Span(const QString &category, const QString &name)
+    : m_category(category), m_name(name), m_start(InstallTrace::now())
+{
+}
+
+InstallTrace::Span::~Span()
+{
+    InstallTrace::record(m_category, m_name, m_start, InstallTrace::now(), m_args);
+}
+
+void InstallTrace::Span::setArgs(const QJsonObject &args)
+{
+    for (auto it = args.begin(); it != args.end(); ++it)
+        m_args.insert(it.key(), it.value());
+}
+
+qint64 InstallTrace::now()
+{
+    return state().clock.nsecsElapsed() / 1000;
+}
+
+void InstallTrace::record(const QString &category, const QString &name,
+                          qint64 startUs, qint64 endUs, const QJsonObject &args)
+{
+    TraceState &s = state();
+    const TraceEvent ev{category, name, startUs, qMax<qint64>(0, endUs - startUs), currentTid(), args};
+    QMutexLocker locker(&s.lock);
+    s.events.append(ev);
+}
+
+QJsonObject InstallTrace::processArgs(const ProcessExecutor::Result &result)
+{
+    QJsonObject args;
+    if (!result.started) {
+        args.insert(QStringLiteral("error"), result.error);
+        return args;
+    }
+    args.insert(QStringLiteral("exit"), result.exitCode);
+    args.insert(QStringLiteral("user_cpu_ms"), result.userTimeUs / 1000.0);
+    args.insert(QStringLiteral("sys_cpu_ms"), result.systemTimeUs / 1000.0);
+    args.insert(QStringLiteral("output_bytes"), result.outputBytes);
+    args.insert(QStringLiteral("input_bytes"), result.inputBytes);
+    args.insert(QStringLiteral("block_read_bytes"), result.blockReadBytes);
+    args.insert(QStringLiteral("block_write_bytes"), result.blockWriteBytes);
+    return args;
+}
+
+void InstallTrace::setThreadName(const QString &name)
+{
+    TraceState &s = state();
+    const qint64 tid = currentTid();
+    QMutexLocker locker(&s.lock);
+    for (auto &entry : s.threadNames) {
+        if (entry.first == tid) {
+            entry.second = name;
+            return;
+        }
+    }
+    s.threadNames.append(qMakePair(tid, name));
+}
+
+QString InstallTrace::defaultPath()
+{
+    const QString env = qEnvironmentVariable("ARCHAID_TRACE");
+    return env.isEmpty() ? QStringLiteral("/tmp/archaid-trace.json") : env;
+}
+
+bool InstallTrace::write(const QString &path)
+{
+    TraceState &s = state();
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray events;
+    {
+        QMutexLocker locker(&s.lock);
+        if (s.events.isEmpty())
+            return false;
+        for (const auto &entry : std::as_const(s.threadNames)) {
+            QJsonObject meta;
+            meta.insert(QStringLiteral("name"), QStringLiteral("thread_name"));
+            meta.insert(QStringLiteral("ph"), QStringLiteral("M"));
+            meta.insert(QStringLiteral("pid"), pid);
+            meta.insert(QStringLiteral("tid"), entry.first);
+            meta.insert(QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), entry.second}});
+            events.append(meta);
+        }
+        for (const TraceEvent &ev : std::as_const(s.events)) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("name"), ev.name);
+            obj.insert(QStringLiteral("cat"), ev.category);
+            obj.insert(QStringLiteral("ph"), QStringLiteral("X"));
+            obj.insert(QStringLiteral("ts"), ev.start);
+            obj.insert(QStringLiteral("dur"), ev.duration);
+            obj.insert(QStringLiteral("pid"), pid);
+            obj.insert(QStringLiteral("tid"), ev.tid);
+            if (!ev.args.isEmpty())
+                obj.insert(QStringLiteral("args"), ev.args);
+            events.append(obj);
+        }
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("traceEvents"), events);
+    root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    f.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return f.commit();
+}
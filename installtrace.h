@@ -0,0 +1,54 @@
+#ifndef INSTALLTRACE_H
+#define INSTALLTRACE_H
+
+#include "processexecutor.h"
+#include <QJsonObject>
+#include <QString>
+
+// Process-wide timing spans, exported in the Chrome trace event format
+// (loadable in chrome://tracing or ui.perfetto.dev).
+//
+// Spans are cheap to record from any thread; nothing is written until
+// write() is called. The output path defaults to /tmp/archaid-trace.json and
+// can be changed with the ARCHAID_TRACE environment variable.
+class InstallTrace {
+public:
+    // RAII span: measures from construction to destruction
+    class Span {
+    public:
+        Span(const QString &category, const QString &name);
+        ~Span();
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+        void setArg(const QString &key, const QJsonValue &value) { m_args.insert(key, value); }
+        void setArgs(const QJsonObject &args);
+
+    private:
+        QString m_category;
+        QString m_name;
+        qint64 m_start;
+        QJsonObject m_args;
+    };
+
+    // Microseconds since the trace clock started
+    static qint64 now();
+
+    // For spans that don't follow a scope (e.g. network replies)
+    static void record(const QString &category, const QString &name,
+                       qint64 startUs, qint64 endUs, const QJsonObject &args = QJsonObject());
+
+    // exit code, child CPU time and byte counts of a finished process
+    static QJsonObject processArgs(const ProcessExecutor::Result &result);
+
+    // Shows up as the track name of the calling thread
+    static void setThreadName(const QString &name);
+
+    static QString defaultPath();
+    // Rewrites the whole file with everything recorded so far; false when
+    // there is nothing to write or the file can't be saved
+    static bool write(const QString &path = defaultPath());
+};
+
+#endif // INSTALLTRACE_H
@@ -0,0 +1,179 @@
+#include "isoimage.h"
+#include <QtEndian>
+
+static const qint64 kSectorSize = 2048;
+static const qint64 kFirstDescriptor = 16;   // system area comes before
+static const int kMaxDescriptors = 64;
+
+// Offsets inside a directory record (ECMA-119 9.1); multi-byte numbers are
+// stored both-endian, the little-endian half comes first
+enum {
+    DrLength = 0,
+    DrExtent = 2,
+    DrDataLength = 10,
+    DrFlags = 25,
+    DrNameLength = 32,
+    DrName = 33,
+    DrMinLength = 34,
+};
+
+static const int kFlagDirectory = 0x02;
+static const int kFlagMultiExtent = 0x80;
+
+static quint32 le32(const QByteArray &buf, int at)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(buf.constData()) + at);
+}
+
+IsoImage::IsoImage(const QString &path) : m_file(path), m_name(path) {}
+
+IsoImage::IsoImage(const Reader &reader, const QString &name) : m_reader(reader), m_name(name) {}
+
+bool IsoImage::read(qint64 offset, qint64 size, QByteArray *out)
+{
+    if (m_reader)
+        return m_reader(offset, size, out);
+    if (!m_file.seek(offset))
+        return false;
+    *out = m_file.read(size);
+    return out->size() == size;
+}
+
+bool IsoImage::open(QString *error)
+{
+    auto fail = [error](const QString &why) {
+        if (error)
+            *error = why;
+        return false;
+    };
+    if (!m_reader && !m_file.isOpen() && !m_file.open(QIODevice::ReadOnly))
+        return fail(m_file.errorString());
+
+    for (int i = 0; i < kMaxDescriptors; ++i) {
+        QByteArray vd;
+        if (!read((kFirstDescriptor + i) * kSectorSize, kSectorSize, &vd))
+            break;
+        if (vd.mid(1, 5) != "CD001")
+            return fail(QStringLiteral("%1 is not an ISO9660 image").arg(m_name));
+        const uchar type = uchar(vd.at(0));
+        if (type == 255)
+            break;   // set terminator
+        if (type != 1)
+            continue;
+
+        // Primary volume descriptor: block size at 128, root record at 156
+        m_blockSize = qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(vd.constData()) + 128);
+        if (m_blockSize <= 0)
+            return fail(QStringLiteral("invalid logical block size"));
+        const QByteArray root = vd.mid(156, DrMinLength);
+        m_root.block = le32(root, DrExtent);
+        m_root.size = le32(root, DrDataLength);
+        m_root.isDir = true;
+        m_open = true;
+        return true;
+    }
+    return fail(QStringLiteral("%1 has no primary volume descriptor").arg(m_name));
+}
+
+// Rock Ridge alternate name from a record's System Use area (SUSP entries:
+// two signature bytes, length, version, payload). NM payload: flags, name;
+// flag 0x01 means the name continues in the next NM entry.
+QString IsoImage::rockRidgeName(const QByteArray &systemUse)
+{
+    QByteArray name;
+    int at = 0;
+    while (at + 4 <= systemUse.size()) {
+        const int len = uchar(systemUse.at(at + 2));
+        if (len < 4 || at + len > systemUse.size())
+            break;
+        if (systemUse.at(at) == 'N' && systemUse.at(at + 1) == 'M' && len >= 5) {
+            const uchar flags = uchar(systemUse.at(at + 4));
+            name += systemUse.mid(at + 5, len - 5);
+            if (!(flags & 0x01))
+                break;
+        }
+        at += len;
+    }
+    return QString::fromUtf8(name);
+}
+
+QList<IsoImage::Record> IsoImage::readDirectory(const Record &dir)
+{
+    QList<Record> records;
+    QByteArray data;
+    if (!read(dir.block * m_blockSize, dir.size, &data))
+        return records;
+
+    qint64 at = 0;
+    while (at < data.size()) {
+        const int len = uchar(data.at(at + DrLength));
+        if (len == 0) {
+            // Records never cross a sector; the rest of this one is padding
+            at = (at / kSectorSize + 1) * kSectorSize;
+            continue;
+        }
+        if (len < DrMinLength || at + len > data.size())
+            break;
+        const QByteArray rec = data.mid(at, len);
+        at += len;
+
+        const int nameLen = uchar(rec.at(DrNameLength));
+        if (DrName + nameLen > rec.size())
+            continue;
+        const QByteArray isoName = rec.mid(DrName, nameLen);
+        if (nameLen == 1 && (isoName.at(0) == 0 || isoName.at(0) == 1))
+            continue;   // "." and ".."
+
+        Record r;
+        r.block = le32(rec, DrExtent);
+        r.size = le32(rec, DrDataLength);
+        r.isDir = rec.at(DrFlags) & kFlagDirectory;
+        r.multiExtent = rec.at(DrFlags) & kFlagMultiExtent;
+
+        // System Use starts after the name, padded to an even offset
+        const int suStart = DrName + nameLen + ((nameLen % 2 == 0) ? 1 : 0);
+        r.name = rockRidgeName(rec.mid(suStart));
+        if (r.name.isEmpty()) {
+            r.name = QString::fromLatin1(isoName).section(';', 0, 0);
+            if (r.name.endsWith('.'))
+                r.name.chop(1);
+        }
+        records << r;
+    }
+    return records;
+}
+
+IsoImage::Extent IsoImage::find(const QString &path, QString *error)
+{
+    auto fail = [&](const QString &why) {
+        if (error)
+            *error = why;
+        return Extent();
+    };
+    if (!m_open && !open(error))
+        return Extent();
+
+    Record current = m_root;
+    const QStringList parts = path.split('/', Qt::SkipEmptyParts);
+    for (int i = 0; i < parts.size(); ++i) {
+        if (!current.isDir)
+            return fail(QStringLiteral("%1 is not a directory").arg(parts.mid(0, i).join('/')));
+        bool found = false;
+        for (const Record &r : readDirectory(current)) {
+            if (r.name.compare(parts.at(i), Qt::CaseInsensitive) == 0) {
+                current = r;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return fail(QStringLiteral("%1 not found in %2").arg(path, m_name));
+    }
+    if (current.isDir || current.multiExtent)
+        return fail(QStringLiteral("%1 is not a single-extent file").arg(path));
+
+    Extent e;
+    e.offset = current.block * m_blockSize;
+    e.size = current.size;
+    return e;
+}
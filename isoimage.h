@@ -0,0 +1,59 @@
+#ifndef ISOIMAGE_H
+#define ISOIMAGE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+// Read-only access to the files of an ISO9660 image without mounting it.
+//
+// Walks the directory tree of the primary volume descriptor and reports
+// where a file's data lies in the image, so a consumer can read that byte
+// range straight from the .iso. Names are matched on their Rock Ridge name
+// (NM) when there is one, else on the ISO9660 identifier without its ";1"
+// version; both case-insensitively. Files split over several extents
+// (> 4 GiB) are reported as not found. The image is a local file, or any
+// source of byte ranges (an HTTP server, see RemoteIso).
+class IsoImage {
+public:
+    // Fills out with exactly size bytes from offset
+    using Reader = std::function<bool(qint64 offset, qint64 size, QByteArray *out)>;
+
+    struct Extent {
+        qint64 offset = -1;   // bytes from the start of the image
+        qint64 size = 0;
+        bool isValid() const { return offset >= 0; }
+    };
+
+    explicit IsoImage(const QString &path);
+    explicit IsoImage(const Reader &reader, const QString &name);
+
+    bool open(QString *error = nullptr);
+    // path is relative to the image root ("arch/x86_64/airootfs.sfs")
+    Extent find(const QString &path, QString *error = nullptr);
+
+private:
+    struct Record {
+        QString name;
+        qint64 block = 0;
+        qint64 size = 0;
+        bool isDir = false;
+        bool multiExtent = false;
+    };
+
+    bool read(qint64 offset, qint64 size, QByteArray *out);
+    QList<Record> readDirectory(const Record &dir);
+    static QString rockRidgeName(const QByteArray &systemUse);
+
+    QFile m_file;
+    Reader m_reader;
+    QString m_name;
+    bool m_open = false;
+    qint64 m_blockSize = 2048;
+    Record m_root;
+};
+
+#endif // ISOIMAGE_H
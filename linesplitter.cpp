@@ -0,0 +1,94 @@
+#include "linesplitter.h"
+#include <cstring>
+
+LineSplitter::LineSplitter(qsizetype maxLine) : m_maxLine(qMax<qsizetype>(1, maxLine))
+{
+    // Reserved capacity survives resize(0), so the carry buffer is
+    // allocated once per splitter
+    m_carry.reserve(256);
+}
+
+void LineSplitter::emitLine(const char *data, qsizetype size, const LineHandler &onLine)
+{
+    if (size > 0 && data[size - 1] == '\r')
+        --size;
+    onLine(data, size);
+}
+
+void LineSplitter::feed(const char *data, qsizetype size, const LineHandler &onLine)
+{
+    const char *p = data;
+    const char *const end = data + size;
+    while (p < end) {
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        if (!nl) {
+            m_carry.append(p, int(end - p));
+            while (m_carry.size() >= m_maxLine) {
+                emitLine(m_carry.constData(), m_maxLine, onLine);
+                m_carry.remove(0, int(m_maxLine));   // only for pathological lines
+            }
+            return;
+        }
+
+        if (m_carry.isEmpty()) {
+            emitLine(p, nl - p, onLine);
+        } else {
+            m_carry.append(p, int(nl - p));
+            emitLine(m_carry.constData(), m_carry.size(), onLine);
+            m_carry.resize(0);
+        }
+        p = nl + 1;
+    }
+}
+
+void LineSplitter::finish(const LineHandler &onLine)
+{
+    if (m_carry.isEmpty())
+        return;
+    emitLine(m_carry.constData(), m_carry.size(), onLine);
+    m_carry.resize(0);
+}
+
+bool LineSplitter::isBlank(const char *data, qsizetype size)
+{
+    for (qsizetype i = 0; i < size; ++i) {
+        const char c = data[i];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n' && c != '\v' && c != '\f')
+            return false;
+    }
+    return true;
+}
+
+LineBatcher::LineBatcher(const BlockHandler &onBlock, int maxLines)
+    : m_onBlock(onBlock), m_maxLines(qMax(1, maxLines))
+{
+    m_block.reserve(4096);
+}
+
+void LineBatcher::add(const char *data, qsizetype size)
+{
+    if (LineSplitter::isBlank(data, size))
+        return;
+    if (m_lines > 0)
+        m_block.append('\n');
+    m_block.append(data, int(size));
+    if (++m_lines >= m_maxLines)
+        flush();
+}
+
+void LineBatcher::add(const QString &line)
+{
+    const QByteArray utf8 = line.toUtf8();
+    add(utf8.constData(), utf8.size());
+}
+
+void LineBatcher::flush()
+{
+    if (m_lines == 0)
+        return;
+    const QString block = QString::fromUtf8(m_block);
+    m_block.resize(0);
+    m_lines = 0;
+    if (m_onBlock)
+        m_onBlock(block);
+}
@@ -0,0 +1,60 @@
+#ifndef LINESPLITTER_H
+#define LINESPLITTER_H
+
+#include <QByteArray>
+#include <QString>
+#include <functional>
+
+// Splits a child's output stream into lines.
+//
+// Lines that are complete within a chunk are handed out as views straight
+// into the caller's buffer; only a trailing partial line is carried over to
+// the next feed(), into a buffer that is reused and never shifted. A trailing
+// '\r' (pty line endings) is dropped. Carried lines longer than maxLine are
+// handed out in maxLine pieces.
+class LineSplitter {
+public:
+    // data is only valid during the call and is not NUL-terminated
+    using LineHandler = std::function<void(const char *data, qsizetype size)>;
+
+    explicit LineSplitter(qsizetype maxLine = 64 * 1024);
+
+    void feed(const char *data, qsizetype size, const LineHandler &onLine);
+    // Hands out a carried partial line, if any
+    void finish(const LineHandler &onLine);
+    void clear() { m_carry.resize(0); }
+
+    static bool isBlank(const char *data, qsizetype size);
+
+private:
+    void emitLine(const char *data, qsizetype size, const LineHandler &onLine);
+
+    QByteArray m_carry;
+    qsizetype m_maxLine;
+};
+
+// Coalesces log lines into newline-joined blocks, so a chatty command costs
+// one log signal per burst instead of one per line. Blank lines are dropped.
+class LineBatcher {
+public:
+    using BlockHandler = std::function<void(const QString &block)>;
+
+    explicit LineBatcher(const BlockHandler &onBlock, int maxLines = 256);
+    ~LineBatcher() { flush(); }
+
+    LineBatcher(const LineBatcher &) = delete;
+    LineBatcher &operator=(const LineBatcher &) = delete;
+
+    void add(const char *data, qsizetype size);   // UTF-8
+    void add(const QString &line);
+    // Hands the pending block on; call whenever the output pauses
+    void flush();
+
+private:
+    BlockHandler m_onBlock;
+    QByteArray m_block;
+    int m_lines = 0;
+    int m_maxLines;
+};
+
+#endif // LINESPLITTER_H
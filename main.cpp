@@ -1,5 +1,6 @@
 #include "Installwizard.h"
 #include "splashwindow.h"
+#include "installtrace.h"
 
 #include <QApplication>
 #include <QCoreApplication>
@@ -98,8 +99,10 @@ int main(int argc, char *argv[])
         /*optionalIconSearchPaths=*/{}   // e.g. {"/usr/share/icons"}
         );
 
-    // Ensure the installer has the necessary privileges to run
-    if (geteuid() != 0) {
+    // Ensure the installer has the necessary privileges to run. A replayed
+    // install (ARCHAID_REPLAY, see commandrunner.h) touches nothing, so it
+    // runs as the invoking user.
+    if (geteuid() != 0 && qEnvironmentVariableIsEmpty("ARCHAID_REPLAY")) {
         // Relaunch through pkexec (password dialog). Use execvp so polkit can talk to agent.
         QString path = QFileInfo(argv[0]).absoluteFilePath();
 
@@ -113,6 +116,16 @@ int main(int argc, char *argv[])
         QByteArray qpa = qgetenv("QT_QPA_PLATFORMTHEME");
         if (!qpa.isEmpty())
             argBytes << QByteArray("QT_QPA_PLATFORMTHEME=") + qpa;
+        // Installer tunables survive the privilege switch
+        for (const char *name : {"ARCHAID_JOBS", "ARCHAID_TRACE", "ARCHAID_RECORD", "ARCHAID_HOST_CACHE",
+                                 "ARCHAID_MIRROR_CANDIDATES", "ARCHAID_OFFLINE_REPO", "ARCHAID_OFFLINE_SOURCES",
+                                 "ARCHAID_NO_FSYNC", "ARCHAID_FIRMWARE",
+                                 "ARCHAID_SYNC_WINDOW", "ARCHAID_PARTIAL_ISO", "ARCHAID_ISO_URL",
+                                 "ARCHAID_ISO_SEGMENTS", "ARCHAID_GOLDEN_CACHE"}) {
+            const QByteArray value = qgetenv(name);
+            if (!value.isEmpty())
+                argBytes << QByteArray(name) + '=' + value;
+        }
         argBytes << path.toLocal8Bit();
 
         std::vector<char*> execArgs;
@@ -150,5 +163,7 @@ int main(int argc, char *argv[])
     splash->setCenterGif(":/img/arch_spin.gif", QSize(100, 100));
     splash->start(5000, wizard);   // SplashWindow::start(delayMs, QWidget* toShowAfter)
 
-    return a.exec();
+    const int rc = a.exec();
+    InstallTrace::write();
+    return rc;
 }
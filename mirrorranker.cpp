@@ -0,0 +1,186 @@
+#include "mirrorranker.h"
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTimer>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+// Roughly the median package size in [extra]
+static const double kTypicalPackageBytes = 2.0 * 1024 * 1024;
+
+double MirrorRanker::Probe::bytesPerSecond() const
+{
+    return bytes * 1e6 / qMax<qint64>(transferUs, 1000);
+}
+
+double MirrorRanker::Probe::estimatedSeconds() const
+{
+    return latencyUs / 1e6 + kTypicalPackageBytes / qMax(bytesPerSecond(), 1.0);
+}
+
+QString MirrorRanker::probeUrl(const QString &server)
+{
+    QString url = server;
+    url.replace("$repo", "extra").replace("$arch", "x86_64");
+    if (!url.endsWith('/'))
+        url += '/';
+    return url + "extra.db";
+}
+
+QList<MirrorRanker::Probe> MirrorRanker::rank() const
+{
+    QList<Probe> probes;
+    for (const QString &server : m_candidates) {
+        Probe p;
+        p.server = server;
+        probes << p;
+    }
+    if (probes.isEmpty())
+        return probes;
+
+    QNetworkAccessManager nam;
+    QEventLoop loop;
+    QElapsedTimer clock;
+    clock.start();
+    auto nowUs = [&clock]() { return clock.nsecsElapsed() / 1000; };
+
+    int next = 0;
+    int running = 0;
+    std::function<void()> launch = [&]() {
+        while (running < m_concurrency && next < probes.size()) {
+            const int i = next++;
+            QNetworkRequest req{QUrl(probeUrl(probes.at(i).server))};
+            req.setRawHeader("Range", "bytes=0-" + QByteArray::number(m_sampleBytes - 1));
+            req.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                             QNetworkRequest::NoLessSafeRedirectPolicy);
+            const qint64 started = nowUs();
+            auto headersAt = std::make_shared<qint64>(-1);
+            auto done = std::make_shared<bool>(false);
+            QNetworkReply *reply = nam.get(req);
+            ++running;
+
+            QObject::connect(reply, &QNetworkReply::metaDataChanged, reply, [&, i, started, headersAt]() {
+                if (*headersAt < 0) {
+                    *headersAt = nowUs();
+                    probes[i].latencyUs = *headersAt - started;
+                }
+            });
+            // Servers that ignore Range are cut off once the sample is in
+            QObject::connect(reply, &QNetworkReply::readyRead, reply, [&, i, reply]() {
+                probes[i].bytes += reply->readAll().size();
+                if (probes[i].bytes >= m_sampleBytes)
+                    reply->abort();
+            });
+            QTimer::singleShot(m_timeoutMs, reply, [reply]() { reply->abort(); });
+            QObject::connect(reply, &QNetworkReply::finished, reply, [&, i, reply, headersAt, done]() {
+                if (*done)
+                    return;
+                *done = true;
+                Probe &p = probes[i];
+                p.bytes += reply->readAll().size();
+                const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                const bool sampled = p.bytes >= m_sampleBytes;
+                if (reply->error() != QNetworkReply::NoError && !sampled) {
+                    p.error = reply->error() == QNetworkReply::OperationCanceledError
+                                  ? QStringLiteral("timed out") : reply->errorString();
+                } else if (status != 200 && status != 206) {
+                    p.error = QString("HTTP %1").arg(status);
+                } else if (p.bytes == 0 || *headersAt < 0) {
+                    p.error = QStringLiteral("empty response");
+                } else {
+                    p.ok = true;
+                    p.transferUs = nowUs() - *headersAt;
+                }
+                reply->deleteLater();
+                --running;
+                launch();
+                if (running == 0)
+                    loop.quit();
+            });
+        }
+    };
+    launch();
+    if (running > 0)
+        loop.exec();
+
+    std::stable_sort(probes.begin(), probes.end(), [](const Probe &a, const Probe &b) {
+        if (a.ok != b.ok)
+            return a.ok;
+        return a.ok && a.estimatedSeconds() < b.estimatedSeconds();
+    });
+    return probes;
+}
+
+QStringList MirrorRanker::parseMirrorlist(const QString &text)
+{
+    static const QRegularExpression serverLine(
+        QStringLiteral("^\\s*#?\\s*Server\\s*=\\s*(\\S+)"), QRegularExpression::MultilineOption);
+    QStringList servers;
+    QSet<QString> seen;
+    auto it = serverLine.globalMatch(text);
+    while (it.hasNext()) {
+        const QString server = it.next().captured(1);
+        if (!seen.contains(server)) {
+            seen.insert(server);
+            servers << server;
+        }
+    }
+    return servers;
+}
+
+QStringList MirrorRanker::statusCandidates(int max, int timeoutMs)
+{
+    QNetworkAccessManager nam;
+    QEventLoop loop;
+    QNetworkReply *reply = nam.get(QNetworkRequest(QUrl("https://archlinux.org/mirrors/status/json/")));
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(timeoutMs, reply, [reply]() { reply->abort(); });
+    loop.exec();
+    const QByteArray body = reply->readAll();
+    const bool ok = reply->error() == QNetworkReply::NoError;
+    reply->deleteLater();
+    if (!ok)
+        return {};
+
+    // Lower score is better; out-of-sync mirrors carry no score
+    QList<QPair<double, QString>> scored;
+    const QJsonArray urls = QJsonDocument::fromJson(body).object().value("urls").toArray();
+    for (const QJsonValue &v : urls) {
+        const QJsonObject m = v.toObject();
+        if (m.value("protocol").toString() != "https" || !m.value("active").toBool(true)
+            || m.value("completion_pct").toDouble() < 1.0 || !m.value("score").isDouble())
+            continue;
+        scored << qMakePair(m.value("score").toDouble(), m.value("url").toString() + "$repo/os/$arch");
+    }
+    std::sort(scored.begin(), scored.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    QStringList servers;
+    for (int i = 0; i < scored.size() && i < max; ++i)
+        servers << scored.at(i).second;
+    return servers;
+}
+
+QString MirrorRanker::formatMirrorlist(const QList<Probe> &ranking, int topN)
+{
+    QString out = QStringLiteral("# Ranked by ArchAid: response time plus a ranged download from each mirror\n");
+    int written = 0;
+    for (const Probe &p : ranking) {
+        if (!p.ok || written >= topN)
+            break;
+        out += QString("# %1 ms, %2 MiB/s\nServer = %3\n")
+                   .arg(p.latencyUs / 1000)
+                   .arg(p.bytesPerSecond() / (1024 * 1024), 0, 'f', 1)
+                   .arg(p.server);
+        ++written;
+    }
+    return written > 0 ? out : QString();
+}
@@ -0,0 +1,57 @@
+#ifndef MIRRORRANKER_H
+#define MIRRORRANKER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// Ranks pacman mirrors by probing them all at once.
+//
+// Each candidate gets one ranged GET for the start of its extra.db: the time
+// to the response headers is its latency, the rest of the sample its
+// throughput. Mirrors are ordered by the estimated time to fetch a typical
+// package (latency + size / throughput); failed or timed-out probes go last.
+//
+// Candidates are pacman Server values ("https://host/archlinux/$repo/os/$arch"),
+// so plain-http stand-ins on localhost work as well as real mirrors.
+// rank() blocks in a local event loop and can run on any thread.
+class MirrorRanker {
+public:
+    struct Probe {
+        QString server;
+        bool ok = false;
+        QString error;
+        qint64 latencyUs = 0;    // request to response headers
+        qint64 bytes = 0;        // sample received
+        qint64 transferUs = 0;   // headers to end of sample
+
+        double bytesPerSecond() const;
+        // Seconds to fetch a typical package from this mirror
+        double estimatedSeconds() const;
+    };
+
+    void setCandidates(const QStringList &servers) { m_candidates = servers; }
+    void setTimeout(int ms) { m_timeoutMs = ms; }
+    void setSampleBytes(qint64 bytes) { m_sampleBytes = bytes; }
+    void setConcurrency(int probes) { m_concurrency = qMax(1, probes); }
+
+    // Best first
+    QList<Probe> rank() const;
+
+    // Server values from mirrorlist text, commented-out entries included
+    static QStringList parseMirrorlist(const QString &text);
+    // Best-scored up-to-date https mirrors from archlinux.org's mirror status
+    static QStringList statusCandidates(int max, int timeoutMs);
+    // mirrorlist with the first topN working mirrors of a ranking
+    static QString formatMirrorlist(const QList<Probe> &ranking, int topN);
+
+    static QString probeUrl(const QString &server);
+
+private:
+    QStringList m_candidates;
+    int m_timeoutMs = 4000;
+    qint64 m_sampleBytes = 256 * 1024;
+    int m_concurrency = 16;
+};
+
+#endif // MIRRORRANKER_H
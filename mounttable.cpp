@@ -0,0 +1,141 @@
+#include "mounttable.h"
+#include <QByteArray>
+#include <QDir>
+#include <QList>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// mountinfo escapes blanks and backslashes as \ooo
+static QString unescapeMountField(const QByteArray &raw)
+{
+    QByteArray out;
+    out.reserve(raw.size());
+    for (int i = 0; i < raw.size(); ++i) {
+        if (raw.at(i) == '\\' && i + 3 < raw.size()) {
+            const QByteArray oct = raw.mid(i + 1, 3);
+            bool ok = false;
+            const int v = oct.toInt(&ok, 8);
+            if (ok && oct.size() == 3) {
+                out.append(static_cast<char>(v));
+                i += 3;
+                continue;
+            }
+        }
+        out.append(raw.at(i));
+    }
+    return QString::fromUtf8(out);
+}
+
+static QString normalizedPath(const QString &path)
+{
+    QString p = QDir::cleanPath(path);
+    return p.isEmpty() ? QStringLiteral("/") : p;
+}
+
+MountTable::MountTable()
+{
+    m_fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+}
+
+MountTable::~MountTable()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+bool MountTable::refreshIfChanged()
+{
+    if (m_fd < 0) {
+        // No descriptor to poll: always re-read to stay correct
+        reload();
+        return true;
+    }
+
+    if (!m_loaded) {
+        reload();
+        return true;
+    }
+
+    pollfd pfd{m_fd, POLLPRI, 0};
+    int rc;
+    do {
+        rc = poll(&pfd, 1, 0);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc > 0 && (pfd.revents & (POLLPRI | POLLERR))) {
+        reload();
+        return true;
+    }
+    return false;
+}
+
+void MountTable::reload()
+{
+    QByteArray content;
+    if (m_fd >= 0) {
+        lseek(m_fd, 0, SEEK_SET);
+        char buf[8192];
+        for (;;) {
+            const ssize_t n = ::read(m_fd, buf, sizeof(buf));
+            if (n > 0) {
+                content.append(buf, static_cast<int>(n));
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                break;
+            }
+        }
+    } else {
+        const int fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            char buf[8192];
+            ssize_t n;
+            while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+                content.append(buf, static_cast<int>(n));
+            ::close(fd);
+        }
+    }
+
+    m_byMountPoint = parse(content);
+    m_loaded = true;
+    ++m_generation;
+}
+
+QHash<QString, MountTable::Entry> MountTable::parse(const QByteArray &mountinfo)
+{
+    // Line format (proc(5)):
+    // 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+    // The optional fields end at the lone "-" separator.
+    QHash<QString, Entry> byMountPoint;
+    const QList<QByteArray> lines = mountinfo.split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.isEmpty())
+            continue;
+        const QList<QByteArray> f = line.split(' ');
+        const int sep = f.indexOf(QByteArray("-"));
+        if (f.size() < 6 || sep < 6 || sep + 2 >= f.size())
+            continue;
+
+        Entry e;
+        e.mountPoint = normalizedPath(unescapeMountField(f.at(4)));
+        e.options = QString::fromUtf8(f.at(5));
+        e.fsType = QString::fromUtf8(f.at(sep + 1));
+        e.source = unescapeMountField(f.at(sep + 2));
+        byMountPoint.insert(e.mountPoint, e);   // later lines are mounted on top
+    }
+    return byMountPoint;
+}
+
+bool MountTable::isMountPoint(const QString &path)
+{
+    refreshIfChanged();
+    return m_byMountPoint.contains(normalizedPath(path));
+}
+
+QString MountTable::sourceOf(const QString &path)
+{
+    refreshIfChanged();
+    return m_byMountPoint.value(normalizedPath(path)).source;
+}
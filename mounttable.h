@@ -0,0 +1,50 @@
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+// In-memory snapshot of /proc/self/mountinfo.
+//
+// The file is parsed natively (no findmnt) and only re-read when the kernel
+// flags a change on it: poll() on an open mountinfo descriptor reports
+// POLLPRI once the namespace's mount table has been modified since the last
+// check. Queries between changes are answered from memory.
+class MountTable {
+public:
+    struct Entry {
+        QString mountPoint;
+        QString source;
+        QString fsType;
+        QString options;
+    };
+
+    MountTable();
+    ~MountTable();
+
+    MountTable(const MountTable &) = delete;
+    MountTable &operator=(const MountTable &) = delete;
+
+    // Re-parse if the kernel signalled a change; returns true when it did.
+    bool refreshIfChanged();
+
+    bool isMountPoint(const QString &path);
+    QString sourceOf(const QString &path);     // empty when not a mount point
+
+    // Bumped every time the snapshot is rebuilt
+    quint64 generation() const { return m_generation; }
+
+    // Entries of mountinfo text (proc(5)) by mount point
+    static QHash<QString, Entry> parse(const QByteArray &mountinfo);
+
+private:
+    void reload();
+
+    int m_fd = -1;
+    bool m_loaded = false;
+    quint64 m_generation = 0;
+    QHash<QString, Entry> m_byMountPoint;  // topmost mount wins
+};
+
+#endif // MOUNTTABLE_H
@@ -0,0 +1,210 @@
+#include "offlinerepository.h"
+#include "commandrunner.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+// Package file name -> base64 signature, from the %FILENAME% and %PGPSIG%
+// entries of each sync database's desc files
+static QHash<QString, QByteArray> databaseSignatures(const QString &syncDir)
+{
+    QHash<QString, QByteArray> signatures;
+    ProcessExecutor::Options opts;
+    opts.usePty = false;
+    opts.mergeStderr = false;
+    for (const QFileInfo &db : QDir(syncDir).entryInfoList({"*.db"}, QDir::Files)) {
+        QByteArray desc;
+        const ProcessExecutor::Result r = CommandRunner::instance().run(
+            {"tar", "-xOf", db.absoluteFilePath(), "--wildcards", "*/desc"},
+            [&desc](const char *data, qsizetype size) { desc.append(data, size); }, opts);
+        if (!r.started || r.exitCode != 0)
+            continue;
+        const QList<QByteArray> lines = desc.split('\n');
+        QString fileName;   // each desc starts with %FILENAME%
+        for (int i = 0; i + 1 < lines.size(); ++i) {
+            if (lines.at(i) == "%FILENAME%")
+                fileName = QString::fromUtf8(lines.at(++i));
+            else if (lines.at(i) == "%PGPSIG%" && !fileName.isEmpty())
+                signatures.insert(fileName, lines.at(++i));
+        }
+    }
+    return signatures;
+}
+
+OfflineRepository::OfflineRepository(const QString &dir) : m_dir(QDir::cleanPath(dir)) {}
+
+QString OfflineRepository::databasePath() const
+{
+    return m_dir + "/" + name() + ".db.tar.gz";
+}
+
+bool OfflineRepository::exists() const
+{
+    return QFileInfo::exists(databasePath());
+}
+
+bool OfflineRepository::build(const QStringList &sourceDirs, const QString &syncDir, QString *error,
+                              int *added, int *skipped)
+{
+    if (added)
+        *added = 0;
+    if (skipped)
+        *skipped = 0;
+    if (!QDir().mkpath(m_dir)) {
+        *error = "cannot create " + m_dir;
+        return false;
+    }
+
+    // Package files (and signatures) the repository doesn't have yet
+    const QDir repo(m_dir);
+    QStringList fresh;
+    QStringList freshPackages;
+    for (const QString &source : sourceDirs) {
+        if (QDir::cleanPath(source) == m_dir)
+            continue;
+        const QFileInfoList files = QDir(source).entryInfoList({"*.pkg.tar.*"}, QDir::Files, QDir::Name);
+        for (const QFileInfo &f : files) {
+            if (f.fileName().endsWith(".part") || repo.exists(f.fileName()))
+                continue;
+            fresh << f.absoluteFilePath();
+            if (!f.fileName().endsWith(".sig"))
+                freshPackages << repo.filePath(f.fileName());
+        }
+    }
+
+    if (!fresh.isEmpty()
+        && CommandRunner::instance().execute("cp", QStringList{"-n", "--reflink=auto", "--"} + fresh + QStringList{m_dir + "/"}) != 0) {
+        *error = "copying packages into " + m_dir + " failed";
+        return false;
+    }
+
+    // A missing database is built from everything in the directory, so
+    // packages dropped in by hand are picked up too
+    QStringList toAdd = freshPackages;
+    if (!exists()) {
+        toAdd.clear();
+        for (const QString &f : repo.entryList({"*.pkg.tar.*"}, QDir::Files, QDir::Name)) {
+            if (!f.endsWith(".sig") && !f.endsWith(".part"))
+                toAdd << repo.filePath(f);
+        }
+    }
+    if (toAdd.isEmpty()) {
+        if (exists())
+            return true;
+        *error = "no packages found for " + m_dir;
+        return false;
+    }
+
+    for (const QString &tool : {QStringLiteral("repo-add"), QStringLiteral("pacman-key")}) {
+        if (QStandardPaths::findExecutable(tool).isEmpty()) {
+            *error = tool + " is not available on this host";
+            return false;
+        }
+    }
+
+    // Every package needs a signature the host's keyring trusts. A copy that
+    // has none is removed again, so a later build can bring it with one.
+    QHash<QString, QByteArray> signatures;
+    bool signaturesLoaded = false;
+    QStringList verified;
+    for (const QString &package : std::as_const(toAdd)) {
+        const QString sig = package + ".sig";
+        if (!QFileInfo::exists(sig)) {
+            if (!signaturesLoaded) {
+                signatures = databaseSignatures(syncDir);
+                signaturesLoaded = true;
+            }
+            const QByteArray encoded = signatures.value(QFileInfo(package).fileName());
+            QFile f(sig);
+            if (!encoded.isEmpty() && f.open(QIODevice::WriteOnly))
+                f.write(QByteArray::fromBase64(encoded));
+        }
+        if (QFileInfo::exists(sig)
+            && CommandRunner::instance().execute("pacman-key", {"--verify", sig, package}) == 0) {
+            verified << package;
+            continue;
+        }
+        if (skipped)
+            ++*skipped;
+        if (freshPackages.contains(package)) {
+            QFile::remove(package);
+            QFile::remove(sig);
+        }
+    }
+    if (verified.isEmpty()) {
+        if (exists())
+            return true;
+        *error = "no package with a valid signature found for " + m_dir;
+        return false;
+    }
+
+    // -n: skip what's already in the database, -p: never downgrade an entry
+    if (CommandRunner::instance().execute("repo-add", QStringList{"-q", "-n", "-p", databasePath()} + verified) != 0) {
+        *error = "repo-add failed for " + databasePath();
+        return false;
+    }
+    if (added)
+        *added = verified.size();
+    return true;
+}
+
+bool OfflineRepository::covers(const QStringList &packages, const QString &localDb, QString *error) const
+{
+    if (QStandardPaths::findExecutable("pacman").isEmpty()) {
+        *error = "pacman is not available on this host";
+        return false;
+    }
+    QTemporaryDir tmp;
+    const QString dbPath = tmp.path() + "/db";
+    QFile config(tmp.path() + "/pacman.conf");
+    if (!tmp.isValid() || !QDir().mkpath(dbPath + "/sync") || !QFile::link(localDb, dbPath + "/local")
+        || !config.open(QIODevice::WriteOnly)) {
+        *error = "cannot set up a pacman database for the check";
+        return false;
+    }
+    // Signatures were checked when the packages went in
+    config.write("[options]\n"
+                 "Architecture = auto\n"
+                 "SigLevel = Never\n\n"
+                 "[" + name().toUtf8() + "]\n"
+                 "Server = file://" + m_dir.toUtf8() + "\n");
+    config.close();
+
+    const QStringList options{"--config", config.fileName(), "--dbpath", dbPath,
+                              "--logfile", tmp.path() + "/pacman.log", "--noconfirm"};
+    if (CommandRunner::instance().execute("pacman", QStringList{"-Sy"} + options) != 0) {
+        *error = "pacman could not read " + databasePath();
+        return false;
+    }
+    ProcessExecutor::Options opts;
+    opts.usePty = false;
+    QByteArray output;
+    const ProcessExecutor::Result r = CommandRunner::instance().run(
+        QStringList{"pacman", "-Sup", "--needed", "--print-format", "%n"} + options + packages,
+        [&output](const char *data, qsizetype size) { output.append(data, size); }, opts);
+    if (!r.started || r.exitCode != 0) {
+        QStringList problems;
+        for (const QByteArray &line : output.split('\n')) {
+            if (line.startsWith("error:") || line.startsWith(":: unable"))
+                problems << QString::fromUtf8(line).trimmed();
+        }
+        *error = problems.isEmpty() ? QStringLiteral("pacman's dry run failed") : problems.join("; ");
+        return false;
+    }
+    return true;
+}
+
+QByteArray OfflineRepository::pacmanConfig(const QString &mountPoint)
+{
+    // Every package was verified on the way in (see build()); the target's
+    // keyring checks it again. The database itself is unsigned.
+    return "[options]\n"
+           "Architecture = auto\n"
+           "SigLevel = Required DatabaseOptional TrustedOnly\n"
+           "LocalFileSigLevel = Optional\n\n"
+           "[" + name().toUtf8() + "]\n"
+           "Server = file://" + mountPoint.toUtf8() + "\n";
+}
@@ -0,0 +1,51 @@
+#ifndef OFFLINEREPOSITORY_H
+#define OFFLINEREPOSITORY_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// A pacman repository on local disk that installs can use instead of the
+// network.
+//
+// build() copies package files (with their .sig files) from pacman caches or
+// plain package directories into the repository and adds them to its
+// database with repo-add. Only packages with a signature the host keyring
+// verifies go in; the target's pacman requires it again. Packages already in
+// the database are left alone and a newer version is never replaced by an
+// older one, so one repository keeps growing across builds and serves any
+// number of installs.
+class OfflineRepository {
+public:
+    explicit OfflineRepository(const QString &dir);
+
+    static QString name() { return QStringLiteral("archaid"); }
+
+    QString dir() const { return m_dir; }
+    QString databasePath() const;
+    bool exists() const;
+
+    // Adds what the sources have that the repository doesn't. Packages
+    // cached without a .sig get theirs from the sync databases in syncDir,
+    // which carry the signatures pacman downloaded them with. Needs repo-add
+    // and pacman-key on the host; added (optional) receives the number of
+    // new package files, skipped the number left out for want of a valid
+    // signature.
+    bool build(const QStringList &sourceDirs, const QString &syncDir, QString *error,
+               int *added = nullptr, int *skipped = nullptr);
+
+    // Dry run of the install's pacman -Su --needed against the repository
+    // alone, resolved against the target's local database (localDb): whether
+    // the repository has everything the packages need that the target
+    // doesn't. Needs pacman on the host.
+    bool covers(const QStringList &packages, const QString &localDb, QString *error) const;
+
+    // pacman.conf that installs from the repository only, as seen from inside
+    // the target with the repository mounted at mountPoint
+    static QByteArray pacmanConfig(const QString &mountPoint);
+
+private:
+    QString m_dir;
+};
+
+#endif // OFFLINEREPOSITORY_H
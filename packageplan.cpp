@@ -0,0 +1,74 @@
+#include "packageplan.h"
+#include <QMap>
+#include <QSet>
+
+static const QStringList kBasePackages = {"base", "linux"};
+
+// GRUB, os-prober (plus ntfs-3g so it can see Windows) and networking
+static const QStringList kSystemPackages = {"grub", "os-prober", "ntfs-3g", "networkmanager", "dialog"};
+
+PackagePlan::PackagePlan(const QString &desktop, const QStringList &firmware) : m_desktop(desktop.trimmed())
+{
+    QStringList all = kBasePackages + firmware + kSystemPackages;
+    if (!isNoDesktop(m_desktop)) {
+        const QStringList de = desktopPackages(m_desktop);
+        m_valid = !de.isEmpty();
+        all += de;
+    }
+
+    QSet<QString> seen;
+    for (const QString &pkg : std::as_const(all)) {
+        if (!seen.contains(pkg)) {
+            seen.insert(pkg);
+            m_packages << pkg;
+        }
+    }
+}
+
+bool PackagePlan::isNoDesktop(const QString &desktop)
+{
+    const QString choice = desktop.trimmed();
+    return choice.isEmpty()
+           || choice.compare("None", Qt::CaseInsensitive) == 0
+           || choice.compare("No Desktop", Qt::CaseInsensitive) == 0;
+}
+
+QStringList PackagePlan::desktopPackages(const QString &desktop)
+{
+    // Essentials per-DE: Xorg, DM, terminal, Firefox, helpers
+    static const QMap<QString, QStringList> desktopPkgs = {
+        {"GNOME",      {"xorg", "gnome", "gdm", "gnome-terminal", "firefox",
+                        "gvfs", "xdg-utils", "xdg-user-dirs"}},
+        {"KDE Plasma", {"xorg", "plasma", "sddm", "konsole", "firefox",
+                        "gvfs", "xdg-utils", "xdg-user-dirs"}},
+        {"XFCE",       {"xorg", "xfce4", "xfce4-goodies", "lightdm", "lightdm-gtk-greeter",
+                        "xfce4-terminal", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}},
+        // LXQt includes icon theme + file manager + terminal + helpers
+        {"LXQt",       {"xorg", "lxqt", "lxqt-qtplugin", "pcmanfm-qt", "qterminal",
+                        "papirus-icon-theme", "hicolor-icon-theme",
+                        "sddm", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}},
+        {"Cinnamon",   {"xorg", "cinnamon", "lightdm", "lightdm-gtk-greeter",
+                        "gnome-terminal", "nemo", "firefox",
+                        "gvfs", "xdg-utils", "xdg-user-dirs"}},
+        {"MATE",       {"xorg", "mate", "mate-extra", "lightdm", "lightdm-gtk-greeter",
+                        "mate-terminal", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}}
+        //{"i3",         {"xorg", "i3", "lightdm", "lightdm-gtk-greeter",
+          //      "alacritty", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}}
+    };
+    return desktopPkgs.value(desktop.trimmed());
+}
+
+QString PackagePlan::displayManagerService(const QString &desktop)
+{
+    const QString choice = desktop.trimmed();
+    if (choice == "GNOME")
+        return "gdm.service";
+    if (choice == "KDE Plasma" || choice == "LXQt")
+        return "sddm.service";
+    return "lightdm.service";
+}
+
+QStringList PackagePlan::transaction() const
+{
+    return QStringList{"pacman", "-Su", "--noconfirm", "--needed"} + m_packages;
+}
@@ -0,0 +1,41 @@
+#ifndef PACKAGEPLAN_H
+#define PACKAGEPLAN_H
+
+#include <QString>
+#include <QStringList>
+
+// Everything the install puts on the target, decided before pacman runs.
+//
+// The base system, kernel, bootloader tooling and the chosen desktop go in
+// as one upgrade-first transaction (-Su --needed with the full set, against
+// the databases synced once earlier), so dependency resolution, downloads,
+// hooks and triggers happen once.
+class PackagePlan {
+public:
+    // firmware: firmware and microcode packages (see HardwareProbe)
+    explicit PackagePlan(const QString &desktop,
+                         const QStringList &firmware = QStringList{QStringLiteral("linux-firmware")});
+
+    // "", "None" and "No Desktop" mean a console-only install
+    static bool isNoDesktop(const QString &desktop);
+    // Package set for a desktop choice; empty when unknown
+    static QStringList desktopPackages(const QString &desktop);
+    static QString displayManagerService(const QString &desktop);
+
+    bool isValid() const { return m_valid; }
+    QString desktop() const { return m_desktop; }
+
+    // Complete package set, deduplicated, in a stable order
+    QStringList packages() const { return m_packages; }
+
+    // pacman argv for the transaction. --needed keeps what the rootfs
+    // already has (groups included) for -u to bring up to date.
+    QStringList transaction() const;
+
+private:
+    QString m_desktop;
+    QStringList m_packages;
+    bool m_valid = true;
+};
+
+#endif // PACKAGEPLAN_H
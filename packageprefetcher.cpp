@@ -0,0 +1,195 @@
+#include "packageprefetcher.h"
+#include "commandrunner.h"
+#include "installtrace.h"
+#include "processreactor.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <signal.h>
+
+static const QString kStateDir = QStringLiteral("/var/cache/archaid");
+// On the live ISO this is the RAM-backed overlay, which the install itself
+// (sync snapshots, golden images, the system's own /tmp) needs room on too
+static const qint64 kSpaceMargin = qint64(256) << 20;
+
+static QString configPath() { return kStateDir + "/pacman.conf"; }
+static QString dbPath() { return kStateDir + "/db"; }
+
+static int countPackages(const QString &dir)
+{
+    return QDir(dir).entryList({"*.pkg.tar.*"}, QDir::Files).size();
+}
+
+PackagePrefetcher::PackagePrefetcher(QObject *parent) : QObject(parent) {}
+
+QString PackagePrefetcher::cacheDir()
+{
+    return kStateDir + "/pkg";
+}
+
+bool PackagePrefetcher::isAvailable()
+{
+    return !QStandardPaths::findExecutable("pacman").isEmpty();
+}
+
+void PackagePrefetcher::stop()
+{
+    m_stop.storeRelease(1);
+}
+
+// pacman.conf for the staging database: the same repos the target uses, with
+// the wizard's mirror when one was entered
+bool PackagePrefetcher::writeConfig(const QString &mirrorUrl)
+{
+    QString server;
+    if (!mirrorUrl.isEmpty()) {
+        QString base = mirrorUrl;
+        if (!base.endsWith('/'))
+            base += '/';
+        server = "Server = " + base + "$repo/os/$arch\n";
+    } else if (QFile::exists("/etc/pacman.d/mirrorlist")) {
+        server = "Include = /etc/pacman.d/mirrorlist\n";
+    } else {
+        server = "Server = https://geo.mirror.pkgbuild.com/$repo/os/$arch\n";
+    }
+
+    QFile f(configPath());
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    f.write("[options]\n"
+            "Architecture = auto\n"
+            "ParallelDownloads = 5\n"
+            // Files are only staged here; the target's pacman verifies every
+            // package against its own keyring when it installs it
+            "SigLevel = Never\n\n");
+    f.write(("[core]\n" + server + "\n[extra]\n" + server).toUtf8());
+    return f.error() == QFile::NoError;
+}
+
+// Blocks until pacman exits; a stop() request kills it
+bool PackagePrefetcher::runPacman(const QStringList &argv, QByteArray *errors, QByteArray *output)
+{
+    ProcessExecutor::Options opts;
+    opts.usePty = false;       // no progress bars
+    opts.mergeStderr = false;
+
+    ProcessReactor reactor;
+    ProcessExecutor::Result result;
+    bool done = false;
+    ProcessExecutor::OutputHandler onOutput;
+    if (output)
+        onOutput = [output](const char *data, qsizetype size) { output->append(data, size); };
+    const int handle = reactor.start(argv, opts, onOutput, [&](const ProcessExecutor::Result &r) {
+        result = r;
+        done = true;
+    });
+
+    bool killed = false;
+    while (!done) {
+        if (!killed && m_stop.loadAcquire()) {
+            reactor.kill(handle, SIGTERM);
+            killed = true;
+        }
+        reactor.runOnce(250);
+    }
+    if (errors)
+        *errors = result.started ? result.stderrData : result.error.toUtf8();
+    return result.started && result.exitCode == 0;
+}
+
+void PackagePrefetcher::prefetch(const QStringList &packages, const QString &mirrorUrl)
+{
+    if (m_stop.loadAcquire())
+        return;
+    // A replayed install downloads nothing
+    if (!CommandRunner::instance().isLive())
+        return;
+    if (!isAvailable()) {
+        emit logMessage("Package prefetch skipped: pacman is not available on this host.");
+        stop();
+        return;
+    }
+
+    QStringList wanted;
+    for (const QString &pkg : packages) {
+        if (!m_fetched.contains(pkg))
+            wanted << pkg;
+    }
+    if (wanted.isEmpty())
+        return;
+
+    InstallTrace::setThreadName(QStringLiteral("prefetch"));
+    InstallTrace::Span span(QStringLiteral("prefetch"), QStringLiteral("pacman -Sw"));
+    span.setArg(QStringLiteral("packages"), wanted.size());
+
+    if (!m_synced || mirrorUrl != m_mirror) {
+        if (!QDir().mkpath(dbPath()) || !QDir().mkpath(cacheDir()) || !writeConfig(mirrorUrl)) {
+            emit logMessage("Package prefetch skipped: cannot create " + kStateDir);
+            stop();
+            return;
+        }
+        m_mirror = mirrorUrl;
+        m_synced = false;
+    }
+
+    const QStringList options{"--noconfirm", "--config", configPath(), "--dbpath", dbPath(),
+                              "--cachedir", cacheDir(), "--logfile", "/dev/null"};
+    QByteArray errors;
+    if (!m_synced) {
+        if (!runPacman(QStringList{"pacman", "-Sy"} + options, &errors)) {
+            if (!m_stop.loadAcquire())
+                emit logMessage("Package prefetch failed: the package databases could not be synced.");
+            return;
+        }
+        m_synced = true;
+    }
+
+    // Download sizes of what isn't cached yet, so a cache that won't hold
+    // them is left alone
+    QByteArray sizes;
+    if (!runPacman(QStringList{"pacman", "-Sp", "--print-format", "%s %f"} + options + wanted, &errors, &sizes)) {
+        if (!m_stop.loadAcquire())
+            emit logMessage("Package prefetch skipped: pacman could not resolve the package set.");
+        return;
+    }
+    const QDir cache(cacheDir());
+    qint64 needed = 0;
+    for (const QByteArray &line : sizes.split('\n')) {
+        const QList<QByteArray> fields = line.trimmed().split(' ');
+        if (fields.size() == 2 && !cache.exists(QString::fromUtf8(fields.at(1))))
+            needed += fields.at(0).toLongLong();
+    }
+    const qint64 available = QStorageInfo(cacheDir()).bytesAvailable();
+    if (available >= 0 && needed + kSpaceMargin > available) {
+        emit logMessage(QString("Package prefetch skipped: %1 has %2 MiB free, the packages need %3 MiB.")
+                            .arg(cacheDir()).arg(available >> 20).arg(needed >> 20));
+        stop();
+        return;
+    }
+
+    QStringList argv = QStringList{"pacman", "-Sw"} + options + wanted;
+
+    const int before = countPackages(cacheDir());
+    QElapsedTimer timer;
+    timer.start();
+    emit logMessage(QString("Prefetching %1 packages in the background…").arg(wanted.size()));
+
+    const bool ok = runPacman(argv, &errors);
+    span.setArg(QStringLiteral("ok"), ok);
+    if (m_stop.loadAcquire())
+        return;   // the install has started; it says what it downloads itself
+    if (!ok) {
+        const QString detail = QString::fromUtf8(errors).trimmed().section('\n', -3);
+        emit logMessage("Package prefetch failed; the install will download them instead."
+                        + (detail.isEmpty() ? QString() : "\n" + detail));
+        return;
+    }
+
+    for (const QString &pkg : std::as_const(wanted))
+        m_fetched.insert(pkg);
+    emit logMessage(QString("Prefetched %1 package files in %2 s.")
+                        .arg(countPackages(cacheDir()) - before)
+                        .arg(timer.elapsed() / 1000.0, 0, 'f', 1));
+}
@@ -0,0 +1,49 @@
+#ifndef PACKAGEPREFETCHER_H
+#define PACKAGEPREFETCHER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+// Downloads the predicted package set into a staging cache while the user is
+// still partitioning and filling in account details, so the install's own
+// transaction finds most packages already on disk.
+//
+// Runs the host's pacman against a database and cache of its own
+// (pacman -Syw --dbpath --cachedir), leaving the host's package state alone.
+// Requests are handled one at a time on the thread the prefetcher lives on;
+// packages an earlier request already fetched are not asked for again.
+// Hosts without pacman (Debian, Fedora) simply get no prefetch, and neither
+// does a host whose cache filesystem (on the live ISO, the RAM overlay)
+// can't hold the download with room to spare.
+class PackagePrefetcher : public QObject {
+    Q_OBJECT
+public:
+    explicit PackagePrefetcher(QObject *parent = nullptr);
+
+    // Staging cache SystemWorker hands to the target's pacman
+    static QString cacheDir();
+    static bool isAvailable();
+
+    // Kills a running download and ignores further requests; any thread
+    void stop();
+
+public slots:
+    void prefetch(const QStringList &packages, const QString &mirrorUrl);
+
+signals:
+    void logMessage(const QString &msg);
+
+private:
+    bool writeConfig(const QString &mirrorUrl);
+    bool runPacman(const QStringList &argv, QByteArray *errors, QByteArray *output = nullptr);
+
+    QAtomicInt m_stop;
+    QString m_mirror;
+    bool m_synced = false;
+    QSet<QString> m_fetched;
+};
+
+#endif // PACKAGEPREFETCHER_H
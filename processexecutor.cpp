@@ -0,0 +1,41 @@
+#include "processexecutor.h"
+#include "processreactor.h"
+#include <QRegularExpression>
+
+ProcessExecutor::Result ProcessExecutor::run(const QStringList &argv, const OutputHandler &onOutput)
+{
+    return run(argv, onOutput, Options());
+}
+
+ProcessExecutor::Result ProcessExecutor::run(const QStringList &argv,
+                                             const OutputHandler &onOutput,
+                                             const Options &options)
+{
+    Options opts = options;
+    opts.pipeStdin = false;   // nobody would ever write to it
+
+    Result result;
+    ProcessReactor reactor;
+    reactor.start(argv, opts, onOutput, [&result](const Result &r) { result = r; });
+    reactor.runUntilIdle();
+    return result;
+}
+
+QString ProcessExecutor::shellQuote(const QString &arg)
+{
+    static const QRegularExpression safe(QStringLiteral("^[A-Za-z0-9_@%+=:,./-]+$"));
+    if (safe.match(arg).hasMatch())
+        return arg;
+    QString quoted = arg;
+    quoted.replace('\'', QStringLiteral("'\\''"));
+    return QStringLiteral("'%1'").arg(quoted);
+}
+
+QString ProcessExecutor::shellJoin(const QStringList &argv)
+{
+    QStringList words;
+    words.reserve(argv.size());
+    for (const QString &a : argv)
+        words << shellQuote(a);
+    return words.join(' ');
+}
@@ -0,0 +1,47 @@
+#ifndef PROCESSEXECUTOR_H
+#define PROCESSEXECUTOR_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+// Runs a program straight from an argv vector: one fork + exec, no
+// intermediate /bin/sh, no stdbuf. Output is collected from a pseudo-terminal
+// by default, which makes stdio in the child line-buffered on its own.
+// run() is the blocking convenience form of ProcessReactor: the calling
+// thread sleeps in epoll_wait() until the child has output or has exited.
+class ProcessExecutor {
+public:
+    using OutputHandler = std::function<void(const char *data, qsizetype size)>;
+
+    struct Options {
+        bool usePty = true;        // false: plain pipes (block-buffered child stdio)
+        bool mergeStderr = true;   // false: stderr is collected into Result::stderrData
+        bool pipeStdin = false;    // ProcessReactor only; otherwise stdin is /dev/null
+    };
+
+    struct Result {
+        bool started = false;
+        int exitCode = -1;         // 128+N when killed by signal N
+        QString error;             // set when the program could not be started
+        QByteArray stderrData;     // only with mergeStderr == false
+
+        // Accounting, from wait4()'s rusage and our own byte counts
+        qint64 outputBytes = 0;    // read from the child's stdout/stderr
+        qint64 inputBytes = 0;     // written to its stdin
+        qint64 userTimeUs = 0;     // CPU time of the child and its waited-for descendants
+        qint64 systemTimeUs = 0;
+        qint64 blockReadBytes = 0; // filesystem I/O charged to it
+        qint64 blockWriteBytes = 0;
+    };
+
+    static Result run(const QStringList &argv, const OutputHandler &onOutput);
+    static Result run(const QStringList &argv, const OutputHandler &onOutput, const Options &options);
+
+    // Quote one word / a whole argv for a POSIX shell
+    static QString shellQuote(const QString &arg);
+    static QString shellJoin(const QStringList &argv);
+};
+
+#endif // PROCESSEXECUTOR_H
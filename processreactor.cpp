@@ -0,0 +1,477 @@
+#include "processreactor.h"
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Low two bits of the epoll cookie say which descriptor of a process fired
+enum Channel : quint64 { ChanOut = 0, ChanErr = 1, ChanExit = 2, ChanIn = 3 };
+
+struct ProcessReactor::Proc {
+    pid_t pid = -1;
+    int pidfd = -1;
+    int outFd = -1;
+    int errFd = -1;
+    int inFd = -1;
+    QByteArray inPending;    // accepted by write(), not yet taken by the child
+    bool inWatched = false;  // registered for EPOLLOUT while inPending has data
+    bool inCloseRequested = false;
+    bool reaped = false;
+    int status = 0;
+    rusage usage{};
+    OutputHandler onOutput;
+    FinishedHandler onFinished;
+    ProcessExecutor::Result result;
+};
+
+static QString errnoString(const char *what)
+{
+    return QStringLiteral("%1 failed: %2").arg(QLatin1String(what), QString::fromLocal8Bit(strerror(errno)));
+}
+
+static void closeFd(int &fd)
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+static void setFdFlags(int fd)
+{
+    const int fdFlags = fcntl(fd, F_GETFD);
+    if (fdFlags >= 0)
+        fcntl(fd, F_SETFD, fdFlags | FD_CLOEXEC);
+    const int flFlags = fcntl(fd, F_GETFL);
+    if (flFlags >= 0)
+        fcntl(fd, F_SETFL, flFlags | O_NONBLOCK);
+}
+
+static int openPidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+ProcessReactor::ProcessReactor()
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+}
+
+ProcessReactor::~ProcessReactor()
+{
+    for (auto &entry : m_procs) {
+        Proc &p = *entry.second;
+        if (!p.reaped) {
+            ::kill(p.pid, SIGKILL);
+            while (waitpid(p.pid, nullptr, 0) < 0 && errno == EINTR) {}
+        }
+        closeFd(p.outFd);
+        closeFd(p.errFd);
+        closeFd(p.inFd);
+        closeFd(p.pidfd);
+    }
+    m_procs.clear();
+    closeFd(m_epoll);
+}
+
+int ProcessReactor::start(const QStringList &argv,
+                          const ProcessExecutor::Options &options,
+                          const OutputHandler &onOutput,
+                          const FinishedHandler &onFinished)
+{
+    ProcessExecutor::Result failed;
+    auto fail = [&](const QString &message) {
+        failed.error = message;
+        if (onFinished)
+            onFinished(failed);
+        return 0;
+    };
+
+    if (argv.isEmpty())
+        return fail(QStringLiteral("Empty command line"));
+    if (m_epoll < 0)
+        return fail(errnoString("epoll_create1"));
+
+    // Everything the child needs is prepared before fork(): only
+    // async-signal-safe calls are allowed between fork() and exec().
+    std::vector<QByteArray> argBytes;
+    argBytes.reserve(argv.size());
+    for (const QString &a : argv)
+        argBytes.push_back(a.toLocal8Bit());
+    std::vector<char *> cargv;
+    for (QByteArray &b : argBytes)
+        cargv.push_back(b.data());
+    cargv.push_back(nullptr);
+
+    int outRead = -1, outWrite = -1;   // child stdout (and stderr when merged)
+    int errRead = -1, errWrite = -1;   // child stderr when kept apart
+    int inParent = -1, inChild = -1;   // child stdin when piped
+    int execPipe[2] = {-1, -1};        // reports exec() failure back to us
+
+    auto closeAll = [&]() {
+        closeFd(outRead);
+        closeFd(outWrite);
+        closeFd(errRead);
+        closeFd(errWrite);
+        closeFd(inParent);
+        closeFd(inChild);
+        closeFd(execPipe[0]);
+        closeFd(execPipe[1]);
+    };
+
+    if (options.usePty) {
+        if (openpty(&outRead, &outWrite, nullptr, nullptr, nullptr) != 0)
+            return fail(errnoString("openpty"));
+        // Raw mode: no echo, no \n -> \r\n translation in the log
+        termios tio{};
+        if (tcgetattr(outWrite, &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(outWrite, TCSANOW, &tio);
+        }
+        const int flags = fcntl(outWrite, F_GETFD);
+        if (flags >= 0)
+            fcntl(outWrite, F_SETFD, flags | FD_CLOEXEC);
+    } else {
+        int p[2];
+        if (pipe2(p, O_CLOEXEC) != 0)
+            return fail(errnoString("pipe"));
+        outRead = p[0];
+        outWrite = p[1];
+    }
+    setFdFlags(outRead);
+
+    if (!options.mergeStderr) {
+        int p[2];
+        if (pipe2(p, O_CLOEXEC) != 0) {
+            closeAll();
+            return fail(errnoString("pipe"));
+        }
+        errRead = p[0];
+        errWrite = p[1];
+        setFdFlags(errRead);
+    }
+
+    if (options.pipeStdin) {
+        // A socket rather than a pipe so writes can use MSG_NOSIGNAL: a dead
+        // child must not take the whole installer down with SIGPIPE.
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+            closeAll();
+            return fail(errnoString("socketpair"));
+        }
+        inParent = sv[0];
+        inChild = sv[1];
+        setFdFlags(inParent);
+    }
+
+    if (pipe2(execPipe, O_CLOEXEC) != 0) {
+        closeAll();
+        return fail(errnoString("pipe"));
+    }
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        closeAll();
+        return fail(errnoString("fork"));
+    }
+
+    if (pid == 0) {
+        // Child
+        if (inChild >= 0) {
+            dup2(inChild, STDIN_FILENO);
+        } else {
+            const int devNull = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (devNull >= 0)
+                dup2(devNull, STDIN_FILENO);
+        }
+        dup2(outWrite, STDOUT_FILENO);
+        dup2(options.mergeStderr ? outWrite : errWrite, STDERR_FILENO);
+        signal(SIGPIPE, SIG_DFL);
+
+        execvp(cargv[0], cargv.data());
+
+        const int err = errno;
+        ssize_t ignored = ::write(execPipe[1], &err, sizeof(err));
+        (void)ignored;
+        _exit(127);
+    }
+
+    // Parent
+    closeFd(outWrite);
+    closeFd(errWrite);
+    closeFd(inChild);
+    closeFd(execPipe[1]);
+
+    // Bounded wait: the pipe closes on exec() or carries errno on failure
+    int execErr = 0;
+    ssize_t n;
+    do {
+        n = ::read(execPipe[0], &execErr, sizeof(execErr));
+    } while (n < 0 && errno == EINTR);
+    closeFd(execPipe[0]);
+
+    if (n == sizeof(execErr)) {
+        while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {}
+        closeAll();
+        return fail(QStringLiteral("Failed to start %1: %2")
+                        .arg(argv.first(), QString::fromLocal8Bit(strerror(execErr))));
+    }
+
+    const int handle = m_nextHandle++;
+    auto proc = std::make_unique<Proc>();
+    proc->pid = pid;
+    proc->pidfd = openPidfd(pid);
+    proc->outFd = outRead;
+    proc->errFd = errRead;
+    proc->inFd = inParent;
+    proc->onOutput = onOutput;
+    proc->onFinished = onFinished;
+    proc->result.started = true;
+
+    auto watch = [&](int fd, Channel channel) {
+        if (fd < 0)
+            return;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = (static_cast<quint64>(handle) << 2) | channel;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+    };
+    watch(proc->outFd, ChanOut);
+    watch(proc->errFd, ChanErr);
+    watch(proc->pidfd, ChanExit);
+
+    m_procs.emplace(handle, std::move(proc));
+    return handle;
+}
+
+// Never blocks: whatever the socket doesn't take now is queued and sent from
+// runOnce() as the child reads, so a child that is busy writing output can't
+// stall the loop that would drain that output.
+bool ProcessReactor::write(int handle, const QByteArray &data)
+{
+    auto it = m_procs.find(handle);
+    if (it == m_procs.end() || it->second->inFd < 0 || it->second->inCloseRequested)
+        return false;
+
+    Proc &p = *it->second;
+    p.inPending += data;
+    return flushInput(handle, p);
+}
+
+qsizetype ProcessReactor::pendingInput(int handle) const
+{
+    auto it = m_procs.find(handle);
+    return it == m_procs.end() ? 0 : it->second->inPending.size();
+}
+
+// Queued input is still delivered; the child sees EOF after it
+void ProcessReactor::closeStdin(int handle)
+{
+    auto it = m_procs.find(handle);
+    if (it == m_procs.end())
+        return;
+    Proc &p = *it->second;
+    p.inCloseRequested = true;
+    if (p.inPending.isEmpty())
+        closeInput(p);
+}
+
+// Sends queued input until the socket is full and waits for EPOLLOUT while
+// some is left. Returns false, and drops the queue, when the child can't
+// take input any more.
+bool ProcessReactor::flushInput(int handle, Proc &p)
+{
+    qsizetype off = 0;
+    while (off < p.inPending.size()) {
+        const ssize_t w = ::send(p.inFd, p.inPending.constData() + off,
+                                 static_cast<size_t>(p.inPending.size() - off), MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            p.inPending.clear();
+            closeInput(p);
+            return false;
+        }
+        off += w;
+        p.result.inputBytes += w;
+    }
+    p.inPending.remove(0, off);
+
+    if (p.inPending.isEmpty()) {
+        if (p.inCloseRequested)
+            closeInput(p);
+        else if (p.inWatched)
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, p.inFd, nullptr);
+        p.inWatched = false;
+    } else if (!p.inWatched) {
+        epoll_event ev{};
+        ev.events = EPOLLOUT;
+        ev.data.u64 = (static_cast<quint64>(handle) << 2) | ChanIn;
+        p.inWatched = epoll_ctl(m_epoll, EPOLL_CTL_ADD, p.inFd, &ev) == 0;
+    }
+    return true;
+}
+
+void ProcessReactor::closeInput(Proc &p)
+{
+    if (p.inFd < 0)
+        return;
+    if (p.inWatched)
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, p.inFd, nullptr);
+    p.inWatched = false;
+    shutdown(p.inFd, SHUT_WR);
+    closeFd(p.inFd);
+}
+
+void ProcessReactor::kill(int handle, int sig)
+{
+    auto it = m_procs.find(handle);
+    if (it != m_procs.end() && !it->second->reaped)
+        ::kill(it->second->pid, sig);
+}
+
+bool ProcessReactor::isRunning(int handle) const
+{
+    auto it = m_procs.find(handle);
+    return it != m_procs.end() && !it->second->reaped;
+}
+
+// Drain one output channel without blocking; closes it on EOF (or EIO, which
+// is how a pty master reports that the last slave descriptor went away).
+void ProcessReactor::readChannel(Proc &p, int &fd, bool toStderr)
+{
+    char buf[16384];
+    while (fd >= 0) {
+        const ssize_t got = ::read(fd, buf, sizeof(buf));
+        if (got > 0) {
+            p.result.outputBytes += got;
+            if (toStderr)
+                p.result.stderrData.append(buf, static_cast<int>(got));
+            else if (p.onOutput)
+                p.onOutput(buf, got);
+            continue;
+        }
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0 && errno == EAGAIN)
+            return;
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+        closeFd(fd);
+    }
+}
+
+void ProcessReactor::reap(int handle)
+{
+    auto it = m_procs.find(handle);
+    if (it == m_procs.end())
+        return;
+    Proc &p = *it->second;
+
+    pid_t r;
+    do {
+        r = wait4(p.pid, &p.status, p.pidfd >= 0 ? WNOHANG : 0, &p.usage);
+    } while (r < 0 && errno == EINTR);
+    if (r == 0)
+        return;
+    p.reaped = true;
+
+    // Whatever the child wrote before exiting is already buffered
+    readChannel(p, p.outFd, false);
+    readChannel(p, p.errFd, true);
+    finish(handle);
+}
+
+void ProcessReactor::finish(int handle)
+{
+    auto it = m_procs.find(handle);
+    if (it == m_procs.end())
+        return;
+    std::unique_ptr<Proc> proc = std::move(it->second);
+    m_procs.erase(it);
+
+    // Descendants may still hold the output side open; we stop listening
+    for (int *fd : {&proc->outFd, &proc->errFd, &proc->pidfd, &proc->inFd}) {
+        if (*fd >= 0)
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, *fd, nullptr);
+        closeFd(*fd);
+    }
+
+    if (WIFEXITED(proc->status))
+        proc->result.exitCode = WEXITSTATUS(proc->status);
+    else if (WIFSIGNALED(proc->status))
+        proc->result.exitCode = 128 + WTERMSIG(proc->status);
+
+    const rusage &ru = proc->usage;
+    proc->result.userTimeUs = qint64(ru.ru_utime.tv_sec) * 1000000 + ru.ru_utime.tv_usec;
+    proc->result.systemTimeUs = qint64(ru.ru_stime.tv_sec) * 1000000 + ru.ru_stime.tv_usec;
+    proc->result.blockReadBytes = qint64(ru.ru_inblock) * 512;
+    proc->result.blockWriteBytes = qint64(ru.ru_oublock) * 512;
+
+    // Last: the callback may start new processes on this reactor
+    if (proc->onFinished)
+        proc->onFinished(proc->result);
+}
+
+bool ProcessReactor::runOnce(int timeoutMs)
+{
+    if (m_procs.empty())
+        return false;
+
+    epoll_event events[16];
+    const int n = epoll_wait(m_epoll, events, 16, timeoutMs);
+    if (n < 0)
+        return errno == EINTR;
+
+    for (int i = 0; i < n; ++i) {
+        const int handle = static_cast<int>(events[i].data.u64 >> 2);
+        const auto channel = static_cast<Channel>(events[i].data.u64 & 3);
+
+        // An earlier event in this batch may already have completed it
+        auto it = m_procs.find(handle);
+        if (it == m_procs.end())
+            continue;
+        Proc &p = *it->second;
+
+        switch (channel) {
+        case ChanOut:
+            readChannel(p, p.outFd, false);
+            break;
+        case ChanErr:
+            readChannel(p, p.errFd, true);
+            break;
+        case ChanExit:
+            reap(handle);
+            continue;
+        case ChanIn:
+            flushInput(handle, p);
+            continue;
+        }
+
+        // Without a pidfd (pre-5.3 kernels) end of output is the exit signal
+        if (p.pidfd < 0 && p.outFd < 0 && p.errFd < 0)
+            reap(handle);
+    }
+    return !m_procs.empty();
+}
+
+void ProcessReactor::runUntilIdle()
+{
+    while (runOnce(-1)) {}
+}
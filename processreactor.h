@@ -0,0 +1,71 @@
+#ifndef PROCESSREACTOR_H
+#define PROCESSREACTOR_H
+
+#include "processexecutor.h"
+#include <QByteArray>
+#include <QStringList>
+#include <functional>
+#include <map>
+#include <memory>
+
+// epoll-driven child process loop.
+//
+// start() forks and returns immediately; output chunks and the final Result
+// are delivered through callbacks from runOnce()/runUntilIdle(), always on
+// the thread that owns the reactor. Nothing is polled on a timer: the thread
+// sleeps in epoll_wait() until a descriptor is ready. Exit is observed
+// through a pidfd, so a command completes as soon as it exits even when a
+// daemon it spawned keeps the output pipe open.
+class ProcessReactor {
+public:
+    using OutputHandler = ProcessExecutor::OutputHandler;
+    using FinishedHandler = std::function<void(const ProcessExecutor::Result &result)>;
+
+    ProcessReactor();
+    ~ProcessReactor();
+
+    ProcessReactor(const ProcessReactor &) = delete;
+    ProcessReactor &operator=(const ProcessReactor &) = delete;
+
+    // Returns a handle > 0. When the program cannot be started, onFinished
+    // is called with Result::started == false before start() returns 0.
+    int start(const QStringList &argv,
+              const ProcessExecutor::Options &options,
+              const OutputHandler &onOutput,
+              const FinishedHandler &onFinished);
+
+    // stdin access, for processes started with Options::pipeStdin. write()
+    // queues what the child doesn't take at once; runOnce() sends the rest.
+    // It fails once the child has closed its end.
+    bool write(int handle, const QByteArray &data);
+    qsizetype pendingInput(int handle) const;
+    void closeStdin(int handle);
+
+    void kill(int handle, int sig);
+    bool isRunning(int handle) const;
+    bool hasPending() const { return !m_procs.empty(); }
+
+    // Dispatch whatever becomes ready within timeoutMs (-1: wait forever).
+    // Returns false when no process is left to wait for.
+    bool runOnce(int timeoutMs = -1);
+    void runUntilIdle();
+
+    // Readable whenever runOnce(0) has something to dispatch, for driving
+    // the reactor from another event loop (a QSocketNotifier)
+    int pollFd() const { return m_epoll; }
+
+private:
+    struct Proc;
+
+    void readChannel(Proc &p, int &fd, bool toStderr);
+    bool flushInput(int handle, Proc &p);
+    void closeInput(Proc &p);
+    void reap(int handle);
+    void finish(int handle);
+
+    int m_epoll = -1;
+    int m_nextHandle = 1;
+    std::map<int, std::unique_ptr<Proc>> m_procs;
+};
+
+#endif // PROCESSREACTOR_H
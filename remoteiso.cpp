@@ -0,0 +1,236 @@
+#include "remoteiso.h"
+#include "isoimage.h"
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <memory>
+
+static const qint64 kChunkSize = 64 * 1024;
+static const qint64 kMinSegment = 8 * 1024 * 1024;
+static const qint64 kProgressStep = 1024 * 1024;
+static const int kTransferTimeoutMs = 30000;
+static const int kStopPollMs = 250;
+
+static QByteArray rangeHeader(qint64 first, qint64 last)
+{
+    return "bytes=" + QByteArray::number(first) + "-" + QByteArray::number(last);
+}
+
+// At least kMinSegment per request; small files aren't worth splitting
+static qint64 segmentSize(qint64 size, int segments)
+{
+    return qMax(kMinSegment, (size + segments - 1) / segments);
+}
+
+RemoteIso::RemoteIso(QObject *parent) : QObject(parent) {}
+
+void RemoteIso::stop()
+{
+    m_stop.storeRelaxed(1);
+}
+
+bool RemoteIso::fetchChunk(qint64 index, QByteArray *out)
+{
+    const auto cached = m_chunks.constFind(index);
+    if (cached != m_chunks.constEnd()) {
+        *out = cached.value();
+        return true;
+    }
+
+    QNetworkRequest req(m_url);
+    req.setRawHeader("Range", rangeHeader(index * kChunkSize, (index + 1) * kChunkSize - 1));
+    req.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    req.setTransferTimeout(kTransferTimeoutMs);
+    QNetworkReply *reply = m_nam->get(req);
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    // A stalled server must not hold up stop() for the whole transfer timeout
+    QTimer stopPoll;
+    QObject::connect(&stopPoll, &QTimer::timeout, &loop, [this, reply]() {
+        if (m_stop.loadRelaxed())
+            reply->abort();
+    });
+    stopPoll.start(kStopPollMs);
+    loop.exec();
+    stopPoll.stop();
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QByteArray body = reply->readAll();
+    const bool ok = reply->error() == QNetworkReply::NoError && status == 206;
+    if (!ok && m_stop.loadRelaxed())
+        m_error = "cancelled";
+    else if (reply->error() != QNetworkReply::NoError)
+        m_error = reply->errorString();
+    else if (status == 200)
+        m_error = "the server does not support range requests";
+    else if (status != 206)
+        m_error = QString("HTTP %1").arg(status);
+    else
+        m_url = reply->url();   // later requests skip the redirects
+    reply->deleteLater();
+    if (!ok)
+        return false;
+    m_chunks.insert(index, body);
+    *out = body;
+    return true;
+}
+
+bool RemoteIso::readRange(qint64 offset, qint64 size, QByteArray *out)
+{
+    out->resize(0);
+    out->reserve(size);
+    qint64 pos = offset;
+    while (pos < offset + size) {
+        QByteArray chunk;
+        if (m_stop.loadRelaxed() || !fetchChunk(pos / kChunkSize, &chunk))
+            return false;
+        const qint64 within = pos % kChunkSize;
+        const QByteArray part = chunk.mid(within, offset + size - pos);
+        if (part.isEmpty())
+            return false;   // past the end of the image
+        out->append(part);
+        pos += part.size();
+    }
+    return true;
+}
+
+bool RemoteIso::download(qint64 offset, qint64 size, const QString &destination, QString *error)
+{
+    if (size <= 0) {
+        *error = "the file is empty";
+        return false;
+    }
+    const QString partPath = destination + ".part";
+    QFile file(partPath);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !file.resize(size)) {
+        *error = "cannot write " + partPath;
+        return false;
+    }
+
+    const qint64 segment = segmentSize(size, m_segments);
+    QEventLoop loop;
+    QList<QNetworkReply *> running;
+    qint64 received = 0;
+    qint64 reported = 0;
+    bool failed = false;
+
+    // abort() finishes a reply on the spot, which edits running
+    auto abortAll = [&]() {
+        const QList<QNetworkReply *> replies = running;
+        for (QNetworkReply *r : replies)
+            r->abort();
+    };
+
+    for (qint64 start = 0; start < size; start += segment) {
+        const qint64 end = qMin(size, start + segment);   // exclusive
+        QNetworkRequest req(m_url);
+        req.setRawHeader("Range", rangeHeader(offset + start, offset + end - 1));
+        req.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+        req.setTransferTimeout(kTransferTimeoutMs);
+        QNetworkReply *reply = m_nam->get(req);
+        running << reply;
+
+        // Each segment writes at its own position in the file
+        auto pos = std::make_shared<qint64>(start);
+        QObject::connect(reply, &QNetworkReply::readyRead, reply, [&, reply, pos, end]() {
+            if (failed)
+                return;
+            if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 206) {
+                *error = "the server does not support range requests";
+                failed = true;
+                abortAll();
+                return;
+            }
+            const QByteArray data = reply->readAll();
+            if (*pos + data.size() > end || !file.seek(*pos) || file.write(data) != data.size()) {
+                *error = "writing " + partPath + " failed";
+                failed = true;
+                abortAll();
+                return;
+            }
+            *pos += data.size();
+            received += data.size();
+            if (received - reported >= kProgressStep || received == size) {
+                reported = received;
+                emit progress(received, size);
+            }
+        });
+        QObject::connect(reply, &QNetworkReply::finished, reply, [&, reply, pos, end]() {
+            const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            running.removeOne(reply);
+            if (!failed && (reply->error() != QNetworkReply::NoError || status != 206 || *pos != end)) {
+                *error = reply->error() != QNetworkReply::NoError
+                             ? reply->errorString()
+                             : QString("segment ended at %1 of %2 (HTTP %3)").arg(*pos).arg(end).arg(status);
+                failed = true;
+                abortAll();
+            }
+            reply->deleteLater();
+            if (running.isEmpty())
+                loop.quit();
+        });
+    }
+
+    QTimer stopPoll;
+    QObject::connect(&stopPoll, &QTimer::timeout, &loop, [&]() {
+        if (m_stop.loadRelaxed() && !failed) {
+            *error = "cancelled";
+            failed = true;
+            abortAll();
+        }
+    });
+    stopPoll.start(kStopPollMs);
+    loop.exec();
+
+    // The extent must hold a squashfs, or the ISO layout wasn't what we took
+    // it for
+    file.seek(0);
+    if (!failed && file.read(4) != "hsqs") {
+        *error = "the fetched extent is not a squashfs image";
+        failed = true;
+    }
+    file.close();
+    if (failed) {
+        QFile::remove(partPath);
+        return false;
+    }
+    QFile::remove(destination);
+    if (!QFile::rename(partPath, destination)) {
+        *error = "cannot move " + partPath + " into place";
+        return false;
+    }
+    return true;
+}
+
+void RemoteIso::fetch(const QUrl &iso, const QString &path, const QString &destination)
+{
+    m_stop.storeRelaxed(0);
+    m_chunks.clear();
+    m_url = iso;
+    m_error.clear();
+
+    QNetworkAccessManager nam;
+    m_nam = &nam;
+    QString error;
+    IsoImage image([this](qint64 offset, qint64 size, QByteArray *out) { return readRange(offset, size, out); },
+                   iso.toString());
+    const IsoImage::Extent extent = image.find(path, &error);
+    bool ok = extent.isValid();
+    if (!ok) {
+        // A network failure explains more than the parse error it caused
+        if (!m_error.isEmpty())
+            error = m_error;
+    } else {
+        emit logMessage(QString("%1 is %2 MiB at offset %3 of the ISO; fetching only that, in %4 segment(s).")
+                            .arg(path).arg(extent.size >> 20).arg(extent.offset)
+                            .arg((extent.size + segmentSize(extent.size, m_segments) - 1)
+                                 / segmentSize(extent.size, m_segments)));
+        ok = download(extent.offset, extent.size, destination, &error);
+    }
+    m_nam = nullptr;
+    m_chunks.clear();
+    emit finished(ok, error);
+}
@@ -0,0 +1,54 @@
+#ifndef REMOTEISO_H
+#define REMOTEISO_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+
+class QNetworkAccessManager;
+
+// Fetches one file out of an ISO on an HTTP server without downloading the
+// rest of the image.
+//
+// The volume descriptor and the directories on the way to the file are read
+// with range requests (in 64 KiB chunks, so a directory walk costs a handful
+// of round trips), then only the file's extent is downloaded, split into
+// segments that are fetched in parallel and written in place into a
+// .part file. Needs a server that answers ranges with 206; redirects are
+// resolved once and the final URL used for every request. Blocking; runs
+// on the thread the object lives on.
+class RemoteIso : public QObject {
+    Q_OBJECT
+public:
+    explicit RemoteIso(QObject *parent = nullptr);
+
+    void setSegments(int segments) { m_segments = qMax(1, segments); }
+    // Aborts a running fetch; any thread
+    void stop();
+
+public slots:
+    // path is relative to the image root; destination receives the file
+    void fetch(const QUrl &iso, const QString &path, const QString &destination);
+
+signals:
+    void logMessage(const QString &msg);
+    void progress(qint64 received, qint64 total);
+    void finished(bool ok, const QString &error);
+
+private:
+    bool readRange(qint64 offset, qint64 size, QByteArray *out);
+    bool fetchChunk(qint64 index, QByteArray *out);
+    bool download(qint64 offset, qint64 size, const QString &destination, QString *error);
+
+    QNetworkAccessManager *m_nam = nullptr;
+    QUrl m_url;
+    QString m_error;
+    QMap<qint64, QByteArray> m_chunks;
+    int m_segments = 4;
+    QAtomicInt m_stop;
+};
+
+#endif // REMOTEISO_H
@@ -0,0 +1,146 @@
+#include "squashfsextractor.h"
+#include "commandrunner.h"
+#include "linesplitter.h"
+#include "processexecutor.h"
+#include <QFile>
+#include <QtEndian>
+
+static const quint32 kSquashfsMagic = 0x73717368;   // "hsqs"
+static const int kSuperblockSize = 96;
+// unsquashfs's own data and fragment queue default, in MiB
+static const qint64 kDefaultQueueMiB = 256;
+static const qint64 kMaxQueueMiB = 1024;
+
+// An eighth of the available memory per queue, never below the default;
+// the airootfs decompresses to a few GiB, mostly in large files
+static qint64 queueMiB()
+{
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly))
+        return kDefaultQueueMiB;
+    while (!meminfo.atEnd()) {
+        const QByteArray line = meminfo.readLine();
+        if (!line.startsWith("MemAvailable:"))
+            continue;
+        const qint64 availableKiB = line.mid(13).trimmed().split(' ').value(0).toLongLong();
+        return qBound(kDefaultQueueMiB, availableKiB / 1024 / 8, kMaxQueueMiB);
+    }
+    return kDefaultQueueMiB;
+}
+
+SquashfsExtractor::SquashfsExtractor(const QString &image, qint64 offset)
+    : m_image(image), m_offset(offset) {}
+
+QString SquashfsExtractor::compressionName(quint16 id)
+{
+    switch (id) {
+    case 1: return QStringLiteral("gzip");
+    case 2: return QStringLiteral("lzma");
+    case 3: return QStringLiteral("lzo");
+    case 4: return QStringLiteral("xz");
+    case 5: return QStringLiteral("lz4");
+    case 6: return QStringLiteral("zstd");
+    }
+    return QStringLiteral("unknown (%1)").arg(id);
+}
+
+bool SquashfsExtractor::readSuperblock(QString *error)
+{
+    QFile f(m_image);
+    if (!f.open(QIODevice::ReadOnly) || !f.seek(m_offset)) {
+        *error = "cannot read " + m_image;
+        return false;
+    }
+    const QByteArray sb = f.read(kSuperblockSize);
+    const auto *p = reinterpret_cast<const uchar *>(sb.constData());
+    if (sb.size() != kSuperblockSize || qFromLittleEndian<quint32>(p) != kSquashfsMagic) {
+        *error = QString("no squashfs at offset %1 of %2").arg(m_offset).arg(m_image);
+        return false;
+    }
+    const quint16 major = qFromLittleEndian<quint16>(p + 28);
+    if (major != 4) {
+        *error = QString("squashfs version %1 is not supported").arg(major);
+        return false;
+    }
+    m_super.inodes = qFromLittleEndian<quint32>(p + 4);
+    m_super.blockSize = qFromLittleEndian<quint32>(p + 12);
+    m_super.compression = qFromLittleEndian<quint16>(p + 20);
+    m_super.bytesUsed = qFromLittleEndian<quint64>(p + 40);
+    return true;
+}
+
+QStringList SquashfsExtractor::arguments(const QString &destination, bool tuned) const
+{
+    QStringList argv{"unsquashfs", "-f", "-d", destination};
+    if (m_offset > 0)
+        argv << "-o" << QString::number(m_offset);
+    if (tuned) {
+        const QString queue = QString::number(queueMiB());
+        argv << "-da" << queue << "-fr" << queue
+             << "-percentage";
+    }
+    argv << m_image;
+    return argv;
+}
+
+bool SquashfsExtractor::extract(const QString &destination, const ProgressHandler &onProgress,
+                                const LogHandler &onLog, QString *error)
+{
+    Progress progress;
+    progress.bytesTotal = qint64(m_super.bytesUsed);
+    progress.filesTotal = m_super.inodes;
+    bool sawProgress = false;
+
+    // -percentage prints one number per line; everything else is logged
+    LineBatcher log(onLog);
+    const LineSplitter::LineHandler onLine = [&](const char *data, qsizetype size) {
+        const QByteArray line = QByteArray::fromRawData(data, size).trimmed();
+        bool isNumber = false;
+        const int percent = line.toInt(&isNumber);
+        if (!isNumber) {
+            log.add(data, size);
+            return;
+        }
+        sawProgress = true;
+        if (percent == progress.percent)
+            return;
+        progress.percent = qBound(0, percent, 100);
+        progress.estimatedBytesDone = progress.bytesTotal * progress.percent / 100;
+        progress.estimatedFilesDone = quint32(quint64(progress.filesTotal) * progress.percent / 100);
+        if (onProgress)
+            onProgress(progress);
+    };
+
+    for (bool tuned : {true, false}) {
+        const QStringList argv = arguments(destination, tuned);
+        onLog(QString("→ %1").arg(ProcessExecutor::shellJoin(argv)));
+        LineSplitter lines;
+        const ProcessExecutor::Result r = CommandRunner::instance().run(argv, [&](const char *data, qsizetype size) {
+            lines.feed(data, size, onLine);
+            log.flush();
+        }, ProcessExecutor::Options());
+        lines.finish(onLine);
+        log.flush();
+
+        if (!r.started) {
+            *error = r.error;
+            return false;
+        }
+        if (r.exitCode == 0) {
+            if (progress.percent != 100 && onProgress) {
+                progress.percent = 100;
+                progress.estimatedBytesDone = progress.bytesTotal;
+                progress.estimatedFilesDone = progress.filesTotal;
+                onProgress(progress);
+            }
+            return true;
+        }
+        // An unsquashfs that rejected the tuning options never got to
+        // report progress; anything else is a real failure
+        if (!tuned || sawProgress)
+            break;
+        onLog("unsquashfs rejected the tuning options; retrying without them.");
+    }
+    *error = "unsquashfs failed on " + m_image;
+    return false;
+}
@@ -0,0 +1,57 @@
+#ifndef SQUASHFSEXTRACTOR_H
+#define SQUASHFSEXTRACTOR_H
+
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+// Unpacks a squashfs image (possibly embedded in a larger file, such as the
+// airootfs inside the ISO) and reports how far along it is.
+//
+// The superblock is read in-process for the totals and to reject images
+// unsquashfs couldn't handle before anything is written. Decompression and
+// writing are unsquashfs's, with its data and fragment queues scaled to the
+// free memory so writes go out in large batches (it already runs one
+// decompressor per CPU). Its -percentage output drives the progress events;
+// unsquashfs builds without it are retried the plain way.
+class SquashfsExtractor {
+public:
+    struct Superblock {
+        quint32 inodes = 0;
+        quint32 blockSize = 0;
+        quint16 compression = 0;
+        quint64 bytesUsed = 0;   // size of the image
+    };
+
+    // unsquashfs only reports a percentage; the "estimated" counts are that
+    // share of the totals, not bytes or files actually written
+    struct Progress {
+        int percent = 0;
+        qint64 estimatedBytesDone = 0;   // of the compressed image
+        qint64 bytesTotal = 0;
+        quint32 estimatedFilesDone = 0;
+        quint32 filesTotal = 0;
+    };
+
+    using ProgressHandler = std::function<void(const Progress &)>;
+    using LogHandler = std::function<void(const QString &)>;
+
+    explicit SquashfsExtractor(const QString &image, qint64 offset = 0);
+
+    bool readSuperblock(QString *error);
+    const Superblock &superblock() const { return m_super; }
+
+    bool extract(const QString &destination, const ProgressHandler &onProgress,
+                 const LogHandler &onLog, QString *error);
+
+    static QString compressionName(quint16 id);
+
+private:
+    QStringList arguments(const QString &destination, bool tuned) const;
+
+    QString m_image;
+    qint64 m_offset;
+    Superblock m_super;
+};
+
+#endif // SQUASHFSEXTRACTOR_H
@@ -1,10 +1,26 @@
 #include "systemworker.h"
+#include "commandrunner.h"
+#include "goldenimagecache.h"
+#include "hardwareprobe.h"
+#include "processexecutor.h"
+#include "installjournal.h"
+#include "installscheduler.h"
+#include "installtrace.h"
+#include "isoimage.h"
+#include "linesplitter.h"
+#include "mirrorranker.h"
+#include "offlinerepository.h"
+#include "packageplan.h"
+#include "squashfsextractor.h"
+#include "targetconfig.h"
+#include "tarstream.h"
 #include <QProcess>
 #include <QFile>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDir>
 #include <QMap>
 #include <QStringList>
-#include <QCoreApplication>
 #include <QRegularExpression>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -12,68 +28,107 @@
 #include <QJsonParseError>
 #include <QJsonValue>
 #include <QSet>
+#include <QStorageInfo>
+#include <QThread>
 #include <QFileInfo>
-#include <QFileInfo
+#include <QDebug>
 #include <functional>
 #include <utility>
-
-SystemWorker::SystemWorker(QObject *parent) : QObject(parent) {}
-
-static QString targetStateFilePath()
+#include <fcntl.h>
+#include <unistd.h>
+
+// Inside the archiso image
+static const QString kAirootfs = QStringLiteral("arch/x86_64/airootfs.sfs");
+// Where versions before in-place extraction copied the ISO
+static const QString kLegacyIso = QStringLiteral("/mnt/archlinux.iso");
+static const QString kHostPackageCache = QStringLiteral("/var/cache/pacman/pkg");
+static const QString kHostSyncDir = QStringLiteral("/var/lib/pacman/sync");
+// Sync-database snapshots, one directory per mirror
+static const QString kSyncSnapshots = QStringLiteral("/var/cache/archaid/sync");
+
+// What 90-mkinitcpio-install.hook does besides building the initramfs:
+// copies each installed kernel's image to /boot. With the hook masked,
+// kernels installed or upgraded meanwhile would otherwise boot stale.
+static const QString kInstallKernels =
+    "for k in /usr/lib/modules/*/pkgbase; do\n"
+    "  [ -e \"$k\" ] || continue\n"
+    "  install -Dm644 \"${k%/pkgbase}/vmlinuz\" \"/boot/vmlinuz-$(cat \"$k\")\" || exit 1\n"
+    "done\n";
+
+// Mirror ranking: how many candidates get probed, how many are kept, and how
+// many downloads the target's pacman runs at once
+static const int kMirrorCandidates = 40;
+static const int kMirrorsKept = 8;
+static const int kParallelDownloads = 5;
+
+// Where an offline repository is mounted inside the target, and the
+// pacman.conf that points at it
+static const QString kOfflineMount = QStringLiteral("/var/cache/archaid/offline");
+static const QString kOfflineConfig = QStringLiteral("/etc/pacman.archaid-offline.conf");
+
+// libeatmydata as the libeatmydata package installs it, and where a copy of
+// the host's goes
+static const QString kFsyncShim = QStringLiteral("/usr/lib/libeatmydata.so");
+static const QString kCopiedFsyncShim = QStringLiteral("/usr/lib/archaid-eatmydata.so");
+
+// pacman hooks that rebuild boot files, masked while packages go in
+static const QString kMkinitcpioHook = QStringLiteral("90-mkinitcpio-install.hook");
+
+static bool isDeferredHook(const QString &name)
 {
-    return QStringLiteral("/tmp/archaid-target.json");
+    return name == kMkinitcpioHook || (name.contains("grub") && name.endsWith(".hook"));
 }
 
-struct TargetMountState {
-    QString root;
-    QString esp;
-};
-
-static TargetMountState readTargetMountState()
+static QString grubConfigScript()
 {
-    TargetMountState state;
-    QFile f(targetStateFilePath());
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
-        return state;
-
-    const QByteArray raw = f.readAll();
-    f.close();
+    return "if command -v update-grub >/dev/null 2>&1; then "
+           "update-grub; "
+           "else "
+           "grub-mkconfig -o /boot/grub/grub.cfg; "
+           "fi";
+}
 
-    QJsonParseError err{};
-    const QJsonDocument doc = QJsonDocument::fromJson(raw, &err);
-    if (err.error != QJsonParseError::NoError || !doc.isObject())
-        return state;
+// Trace args for a command that ran in the chroot session
+static QJsonObject sessionArgs(int code, const ChrootSession::CommandStats &stats)
+{
+    QJsonObject args;
+    args.insert(QStringLiteral("exit"), code);
+    args.insert(QStringLiteral("user_cpu_ms"), stats.userTimeUs / 1000.0);
+    args.insert(QStringLiteral("sys_cpu_ms"), stats.systemTimeUs / 1000.0);
+    args.insert(QStringLiteral("output_bytes"), stats.outputBytes);
+    return args;
+}
 
-    const QJsonObject obj = doc.object();
-    state.root = obj.value(QStringLiteral("root")).toString();
-    state.esp  = obj.value(QStringLiteral("esp")).toString();
-    return state;
+SystemWorker::SystemWorker(QObject *parent)
+    : QObject(parent),
+      m_jobs(qBound(1, QThread::idealThreadCount(), 4))
+{
 }
 
-static void writeTargetMountState(const QString &rootDev, const QString &espDev)
+SystemWorker::~SystemWorker()
 {
-    QJsonObject obj;
-    obj.insert(QStringLiteral("root"), rootDev);
-    if (!espDev.isEmpty())
-        obj.insert(QStringLiteral("esp"), espDev);
+    closeChrootSessions();
+}
 
-    QFile f(targetStateFilePath());
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
-        return;
+void SystemWorker::setOfflineRepository(const QString &dir, const QStringList &sourceDirs)
+{
+    m_offlineRepo = dir;
+    m_offlineSources = sourceDirs;
+}
 
-    const QJsonDocument doc(obj);
-    f.write(doc.toJson(QJsonDocument::Compact));
-    f.write("\n");
-    f.close();
+QStringList SystemWorker::pacmanCommand(const QStringList &argv) const
+{
+    if (m_pacmanConfig.isEmpty() || argv.isEmpty())
+        return argv;
+    QStringList out = argv;
+    out.insert(1, "--config");
+    out.insert(2, m_pacmanConfig);
+    return out;
 }
 
-static QString currentMountSource(const QString &path)
+void SystemWorker::setParallelJobs(int jobs)
 {
-    QProcess proc;
-    proc.start("findmnt", {"-rn", "-o", "SOURCE", path});
-    if (!proc.waitForFinished(-1) || proc.exitCode() != 0)
-        return QString();
-    return QString::fromUtf8(proc.readAllStandardOutput()).trimmed();
+    m_jobs = qMax(1, jobs);
 }
 
 static QString canonicalDevice(const QString &dev)
@@ -116,86 +171,54 @@ QString SystemWorker::normalizePartitionPath(const QString &in) const
 
 bool SystemWorker::isMountPoint(const QString &path)
 {
-    QProcess proc;
-    proc.start("findmnt", {"-rn", path});
-    if (!proc.waitForFinished(-1))
-        return false;
-    return proc.exitCode() == 0;
+    return m_mounts.isMountPoint(path);
 }
 
 bool SystemWorker::ensureTargetMounts()
 {
+    // Fast path: nothing in the mount namespace changed since the target was
+    // last verified, so the answer is still yes. One poll() syscall, no children.
+    // Compared by generation: other queries may have absorbed the change.
+    m_mounts.refreshIfChanged();
+    if (m_verifiedGeneration != 0 && m_verifiedGeneration == m_mounts.generation())
+        return true;
+    // A replayed install has no disks to look at
+    if (!CommandRunner::instance().isLive())
+        return true;
+    m_verifiedGeneration = 0;
+    InstallTrace::Span span(QStringLiteral("mount"), QStringLiteral("verify target mounts"));
+
     const QString disk = drive.startsWith("/dev/") ? drive : QStringLiteral("/dev/%1").arg(drive);
     if (disk.size() <= 5) {
         emit errorOccurred("Invalid target drive specified for installation.");
         return false;
     }
 
-    TargetMountState recorded = readTargetMountState();
+    InstallJournal journal;
+    InstallJournal::Target recorded = journal.target();
 
     auto ensureDir = [](const QString &path) {
         QDir().mkpath(path);
     };
 
+    auto mountDevice = [](const QString &dev, const QString &mountPoint) {
+        return CommandRunner::instance().execute("mount", {dev, mountPoint}) == 0;
+    };
+
     auto remountIfMismatch = [&](const QString &mountPoint, const QString &expectedDev) {
         if (expectedDev.isEmpty())
             return;
-        if (!isMountPoint(mountPoint))
-            return;
-        const QString current = currentMountSource(mountPoint);
+        const QString current = m_mounts.sourceOf(mountPoint);
         if (current.isEmpty())
             return;
         if (canonicalDevice(current) != canonicalDevice(expectedDev)) {
             emit logMessage(QStringLiteral("%1 is mounted from %2 but prepared target is %3. Remounting…")
                                 .arg(mountPoint, current, expectedDev));
-            QProcess::execute("sudo", {"umount", "-Rl", mountPoint});
+            retireChrootSessions();
+            CommandRunner::instance().execute("umount", {"-Rl", mountPoint});
         }
     };
 
-    ensureDir("/mnt");
-    remountIfMismatch("/mnt", recorded.root);
-
-    if (!isMountPoint("/mnt") && !recorded.root.isEmpty()) {
-        emit logMessage(QStringLiteral("Mounting prepared root partition %1 at /mnt…").arg(recorded.root));
-        if (QProcess::execute("sudo", {"mount", recorded.root, "/mnt"}) != 0)
-            emit logMessage(QStringLiteral("Failed to mount recorded root partition %1. Falling back to autodetection.")
-                                .arg(recorded.root));
-    QDir().mkpath("/mnt");
-    if (isMountPoint("/mnt")) {
-        if (useEfi) {
-            QDir().mkpath("/mnt/boot/efi");
-            if (!isMountPoint("/mnt/boot/efi")) {
-                emit logMessage("/mnt already mounted; ensuring ESP is mounted as well…");
-            } else {
-                return true;
-            }
-        } else {
-            return true;
-        }
-    } else {
-        emit logMessage("Target root is not mounted. Attempting to locate and mount it automatically…");
-    }
-
-    QString out;
-    if (!runCommandCapture(
-            QStringLiteral("lsblk -J -b -o NAME,TYPE,FSTYPE,SIZE,PARTFLAGS,MOUNTPOINT %1").arg(disk),
-            &out))
-        return false;
-
-    QJsonParseError parseError{};
-    const QJsonDocument doc = QJsonDocument::fromJson(out.toUtf8(), &parseError);
-    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-        emit errorOccurred(QStringLiteral("Failed to parse lsblk output for %1: %2")
-                               .arg(disk, parseError.errorString()));
-        return false;
-    }
-
-    const QJsonArray devices = doc.object().value(QStringLiteral("blockdevices")).toArray();
-    if (devices.isEmpty()) {
-        emit errorOccurred(QStringLiteral("No block devices found in lsblk output for %1.").arg(disk));
-        return false;
-    }
-
     struct PartitionInfo {
         QString name;
         QString fstype;
@@ -207,13 +230,14 @@ bool SystemWorker::ensureTargetMounts()
     QList<PartitionInfo> partitions;
     bool partitionsLoaded = false;
 
+    // lsblk is only consulted when something actually has to be located
     auto loadPartitions = [&]() -> bool {
         if (partitionsLoaded)
             return true;
 
         QString out;
         if (!runCommandCapture(
-                QStringLiteral("lsblk -J -b -o NAME,TYPE,FSTYPE,SIZE,PARTFLAGS,MOUNTPOINT %1").arg(disk),
+                {"lsblk", "-J", "-b", "-o", "NAME,TYPE,FSTYPE,SIZE,PARTFLAGS,MOUNTPOINT", disk},
                 &out))
             return false;
 
@@ -271,45 +295,14 @@ bool SystemWorker::ensureTargetMounts()
         return true;
     };
 
-    std::function<void(const QJsonObject &)> walk = [&](const QJsonObject &obj) {
-        const QString type = obj.value(QStringLiteral("type")).toString();
-        const QString name = obj.value(QStringLiteral("name")).toString();
-        const QString fstype = obj.value(QStringLiteral("fstype")).toString();
-        const QString flags = obj.value(QStringLiteral("partflags")).toString();
-        const QString mountpoint = obj.value(QStringLiteral("mountpoint")).toString();
-        const qulonglong size = obj.value(QStringLiteral("size")).toVariant().toULongLong();
-
-        if (type == QLatin1String("part") && !name.isEmpty()) {
-            PartitionInfo p;
-            p.name = name;
-            p.fstype = fstype;
-            p.flags = flags;
-            p.mountpoint = mountpoint;
-            p.size = size;
-            partitions.append(p);
-        }
-
-        const QJsonArray children = obj.value(QStringLiteral("children")).toArray();
-        for (const QJsonValue &childVal : children) {
-            if (childVal.isObject())
-                walk(childVal.toObject());
-        }
-    };
-
-    for (const QJsonValue &val : devices) {
-        if (val.isObject())
-            walk(val.toObject());
-    }
-
-    if (partitions.isEmpty()) {
-        emit errorOccurred(QStringLiteral("No partitions detected on %1.").arg(disk));
-        return false;
-    }
-
     auto hasFlag = [](const QString &flags, const QString &needle) {
         return flags.contains(needle, Qt::CaseInsensitive);
     };
 
+    auto devPath = [](const QString &name) {
+        return name.startsWith("/dev/") ? name : QStringLiteral("/dev/%1").arg(name);
+    };
+
     auto mountRootFromPartitions = [&]() -> bool {
         if (isMountPoint("/mnt"))
             return true;
@@ -333,71 +326,15 @@ bool SystemWorker::ensureTargetMounts()
             return false;
         }
 
-        const QString rootDev = rootCandidate.name.startsWith("/dev/")
-                                    ? rootCandidate.name
-                                    : QStringLiteral("/dev/%1").arg(rootCandidate.name);
-
-
-    const QSet<QString> rootFsTypes = {"ext4", "btrfs", "xfs", "f2fs", "jfs", "reiserfs"};
-    PartitionInfo rootCandidate;
-    for (const PartitionInfo &p : std::as_const(partitions)) {
-        const QString fs = p.fstype.toLower();
-        if (!rootFsTypes.contains(fs))
-            continue;
-        if (hasFlag(p.flags, QStringLiteral("esp")) || hasFlag(p.flags, QStringLiteral("bios_grub")))
-            continue;
-        if (rootCandidate.name.isEmpty() || p.size > rootCandidate.size)
-            rootCandidate = p;
-    }
-
-    if (rootCandidate.name.isEmpty()) {
-        emit errorOccurred(QStringLiteral("Unable to determine target root partition on %1.").arg(disk));
-        return false;
-    }
-
-    const QString rootDev = rootCandidate.name.startsWith("/dev/")
-                                ? rootCandidate.name
-                                : QStringLiteral("/dev/%1").arg(rootCandidate.name);
-
-    if (!isMountPoint("/mnt")) {
+        const QString rootDev = devPath(rootCandidate.name);
         emit logMessage(QStringLiteral("Mounting %1 at /mnt…").arg(rootDev));
-        if (QProcess::execute("sudo", {"mount", rootDev, "/mnt"}) != 0) {
+        if (!mountDevice(rootDev, "/mnt")) {
             emit errorOccurred(QStringLiteral("Failed to mount %1 at /mnt.").arg(rootDev));
             return false;
         }
-
-        writeTargetMountState(rootDev, QString());
         return true;
     };
 
-    if (!isMountPoint("/mnt")) {
-        emit logMessage("Target root is not mounted. Attempting to locate and mount it automatically…");
-        if (!mountRootFromPartitions())
-            return false;
-
-    }
-
-    if (!isMountPoint("/mnt")) {
-        emit errorOccurred("/mnt is not a valid mountpoint even after attempting to mount the root partition.");
-        return false;
-    }
-
-    if (!useEfi) {
-        const QString currentRoot = currentMountSource("/mnt");
-        if (!currentRoot.isEmpty())
-            writeTargetMountState(currentRoot, QString());
-        return true;
-    }
-
-    ensureDir("/mnt/boot/efi");
-    remountIfMismatch("/mnt/boot/efi", recorded.esp);
-
-    if (!isMountPoint("/mnt/boot/efi") && !recorded.esp.isEmpty()) {
-        emit logMessage(QStringLiteral("Mounting prepared EFI System Partition %1 at /mnt/boot/efi…").arg(recorded.esp));
-        if (QProcess::execute("sudo", {"mount", recorded.esp, "/mnt/boot/efi"}) != 0)
-            emit logMessage(QStringLiteral("Failed to mount recorded ESP %1. Falling back to autodetection.").arg(recorded.esp));
-    }
-
     auto mountEspFromPartitions = [&]() -> bool {
         if (isMountPoint("/mnt/boot/efi"))
             return true;
@@ -414,7 +351,7 @@ bool SystemWorker::ensureTargetMounts()
             if (espCandidate.name.isEmpty() || hasFlag(flags, QStringLiteral("esp")) || p.size < espCandidate.size) {
                 espCandidate = p;
                 if (hasFlag(flags, QStringLiteral("esp")))
-                    break;
+                    break; // prefer explicitly flagged ESPs
             }
         }
 
@@ -423,72 +360,72 @@ bool SystemWorker::ensureTargetMounts()
             return false;
         }
 
-        const QString espDev = espCandidate.name.startsWith("/dev/")
-                                   ? espCandidate.name
-                                   : QStringLiteral("/dev/%1").arg(espCandidate.name);
-
+        const QString espDev = devPath(espCandidate.name);
         emit logMessage(QStringLiteral("Mounting EFI System Partition %1 at /mnt/boot/efi…").arg(espDev));
-        if (QProcess::execute("sudo", {"mount", espDev, "/mnt/boot/efi"}) != 0) {
+        if (!mountDevice(espDev, "/mnt/boot/efi")) {
             emit errorOccurred(QStringLiteral("Failed to mount EFI System Partition %1 at /mnt/boot/efi.").arg(espDev));
             return false;
         }
-
-        const QString currentRoot = currentMountSource("/mnt");
-        writeTargetMountState(currentRoot, espDev);
         return true;
     };
 
-    if (!mountEspFromPartitions())
-        return false;
+    // --- Root ---
+    ensureDir("/mnt");
+    remountIfMismatch("/mnt", recorded.root);
 
-        return true;
+    if (!isMountPoint("/mnt") && !recorded.root.isEmpty()) {
+        emit logMessage(QStringLiteral("Mounting prepared root partition %1 at /mnt…").arg(recorded.root));
+        if (!mountDevice(recorded.root, "/mnt"))
+            emit logMessage(QStringLiteral("Failed to mount recorded root partition %1. Falling back to autodetection.")
+                                .arg(recorded.root));
     }
 
-    QDir().mkpath("/mnt/boot/efi");
-    if (isMountPoint("/mnt/boot/efi"))
-        return true;
-
-    PartitionInfo espCandidate;
-    for (const PartitionInfo &p : std::as_const(partitions)) {
-        const QString flags = p.flags;
-        const QString fs = p.fstype.toLower();
-        const bool looksEsp = hasFlag(flags, QStringLiteral("esp")) || fs == "vfat" || fs == "fat32" || fs == "fat";
-        if (!looksEsp)
-            continue;
-        if (espCandidate.name.isEmpty() || hasFlag(flags, QStringLiteral("esp")) || p.size < espCandidate.size) {
-            espCandidate = p;
-            if (hasFlag(flags, QStringLiteral("esp")))
-                break; // prefer explicitly flagged ESPs
-        }
+    if (!isMountPoint("/mnt")) {
+        emit logMessage("Target root is not mounted. Attempting to locate and mount it automatically…");
+        if (!mountRootFromPartitions())
+            return false;
     }
 
-    if (espCandidate.name.isEmpty()) {
-        emit errorOccurred(QStringLiteral("EFI installation requested, but no EFI System Partition was found on %1.").arg(disk));
+    if (!isMountPoint("/mnt")) {
+        emit errorOccurred("/mnt is not a valid mountpoint even after attempting to mount the root partition.");
         return false;
     }
 
-    const QString espDev = espCandidate.name.startsWith("/dev/")
-                               ? espCandidate.name
-                               : QStringLiteral("/dev/%1").arg(espCandidate.name);
+    const QString currentRoot = m_mounts.sourceOf("/mnt");
 
-    emit logMessage(QStringLiteral("Mounting EFI System Partition %1 at /mnt/boot/efi…").arg(espDev));
-    if (QProcess::execute("sudo", {"mount", espDev, "/mnt/boot/efi"}) != 0) {
-        emit errorOccurred(QStringLiteral("Failed to mount EFI System Partition %1 at /mnt/boot/efi.").arg(espDev));
-        return false;
-    }
+    // After a restart the devices are only known from the journal on the
+    // root we just mounted; it also knows which partition is the ESP
+    if (recorded.esp.isEmpty())
+        recorded.esp = journal.target().esp;
 
-    if (!isMountPoint("/mnt/boot/efi")) {
-        emit errorOccurred("/mnt/boot/efi is not mounted after attempting to attach the EFI System Partition.");
-        return false;
-    }
+    // --- ESP ---
+    QString currentEsp;
+    if (useEfi) {
+        ensureDir("/mnt/boot/efi");
+        remountIfMismatch("/mnt/boot/efi", recorded.esp);
 
-    const QString currentRoot = currentMountSource("/mnt");
-    const QString currentEsp = currentMountSource("/mnt/boot/efi");
-    writeTargetMountState(currentRoot, currentEsp);
-    return true;
-}
+        if (!isMountPoint("/mnt/boot/efi") && !recorded.esp.isEmpty()) {
+            emit logMessage(QStringLiteral("Mounting prepared EFI System Partition %1 at /mnt/boot/efi…").arg(recorded.esp));
+            if (!mountDevice(recorded.esp, "/mnt/boot/efi"))
+                emit logMessage(QStringLiteral("Failed to mount recorded ESP %1. Falling back to autodetection.").arg(recorded.esp));
+        }
 
+        if (!mountEspFromPartitions())
+            return false;
 
+        if (!isMountPoint("/mnt/boot/efi")) {
+            emit errorOccurred("/mnt/boot/efi is not mounted after attempting to attach the EFI System Partition.");
+            return false;
+        }
+        currentEsp = m_mounts.sourceOf("/mnt/boot/efi");
+    }
+
+    if (currentRoot != recorded.root || currentEsp != recorded.esp)
+        journal.setTarget({currentRoot, currentEsp});
+
+    // Absorb the changes we just made so the next call takes the fast path
+    m_mounts.refreshIfChanged();
+    m_verifiedGeneration = m_mounts.generation();
     return true;
 }
 
@@ -511,81 +448,58 @@ bool SystemWorker::installDesktopAndDM()
     const QString choice = desktopEnv.trimmed();
 
     // Handle "no desktop"
-    if (choice.isEmpty() ||
-        choice.compare("None", Qt::CaseInsensitive) == 0 ||
-        choice.compare("No Desktop", Qt::CaseInsensitive) == 0)
-    {
+    if (PackagePlan::isNoDesktop(choice)) {
         emit logMessage("No desktop selected. Boot target set to multi-user.");
-        return runCommand("sudo arch-chroot /mnt systemctl set-default multi-user.target");
-    }
-
-    // Essentials per-DE: Xorg, DM, terminal, Firefox, helpers
-    QMap<QString, QStringList> desktopPkgs = {
-        {"GNOME",      {"xorg", "gnome", "gdm", "gnome-terminal", "firefox",
-                   "gvfs", "xdg-utils", "xdg-user-dirs"}},
-        {"KDE Plasma", {"xorg", "plasma", "sddm", "konsole", "firefox",
-                        "gvfs", "xdg-utils", "xdg-user-dirs"}},
-        {"XFCE",       {"xorg", "xfce4", "xfce4-goodies", "lightdm", "lightdm-gtk-greeter",
-                  "xfce4-terminal", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}},
-        // LXQt includes icon theme + file manager + terminal + helpers
-        {"LXQt",       {"xorg", "lxqt", "lxqt-qtplugin", "pcmanfm-qt", "qterminal",
-                  "papirus-icon-theme", "hicolor-icon-theme",
-                  "sddm", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}},
-        {"Cinnamon",   {"xorg", "cinnamon", "lightdm", "lightdm-gtk-greeter",
-                      "gnome-terminal", "nemo", "firefox",
-                      "gvfs", "xdg-utils", "xdg-user-dirs"}},
-        {"MATE",       {"xorg", "mate", "mate-extra", "lightdm", "lightdm-gtk-greeter",
-                  "mate-terminal", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}}
-        //{"i3",         {"xorg", "i3", "lightdm", "lightdm-gtk-greeter",
-          //      "alacritty", "firefox", "gvfs", "xdg-utils", "xdg-user-dirs"}}
-    };
+        return runInTarget({"systemctl", "set-default", "multi-user.target"});
+    }
 
-    if (!desktopPkgs.contains(choice)) {
+    // The packages came with the system transaction (see PackagePlan)
+    if (PackagePlan::desktopPackages(choice).isEmpty()) {
         emit errorOccurred(QString("Unknown desktop environment: %1").arg(choice));
         return false;
     }
 
-    // Install packages in chroot
-    const QStringList pkgs = desktopPkgs.value(choice);
-    const QString pkgCmd =
-        QString("sudo arch-chroot /mnt pacman -S --noconfirm --needed %1")
-            .arg(pkgs.join(' '));
-    if (!runCommand(pkgCmd))
-        return false;
-
     // Enable the display manager
-    QString dmService;
-    if (choice == "GNOME") dmService = "gdm.service";
-    else if (choice == "KDE Plasma" || choice == "LXQt") dmService = "sddm.service";
-    else dmService = "lightdm.service";
-
-    if (!runCommand(QString("sudo arch-chroot /mnt systemctl enable %1").arg(dmService)))
+    const QString dmService = PackagePlan::displayManagerService(choice);
+    if (!runInTarget({"systemctl", "enable", dmService}))
         return false;
 
     // Boot to graphical when a DE is installed
-    if (!runCommand("sudo arch-chroot /mnt systemctl set-default graphical.target"))
+    if (!runInTarget({"systemctl", "set-default", "graphical.target"}))
         return false;
 
+    // Greeter, user folders and login banners go to the target in one pass
+    ConfigTransaction desktopConfig;
+
     // Greeter defaults (safe if already present)
     if (dmService == "lightdm.service") {
-        runCommand(
-            "sudo arch-chroot /mnt bash -c \"mkdir -p /etc/lightdm && "
-            "printf '[greeter]\\n"
-            "theme-name=Adwaita\\n"
-            "icon-theme-name=Adwaita\\n"
-            "background=#101010\\n' > /etc/lightdm/lightdm-gtk-greeter.conf\""
-            );
+        desktopConfig.writeFile("lightdm greeter defaults", "/etc/lightdm/lightdm-gtk-greeter.conf",
+                                "[greeter]\n"
+                                "theme-name=Adwaita\n"
+                                "icon-theme-name=Adwaita\n"
+                                "background=#101010\n");
     } else if (dmService == "sddm.service") {
-        runCommand(
-            "sudo arch-chroot /mnt bash -c \"mkdir -p /etc/sddm.conf.d && "
-            "printf '[Theme]\\nCurrent=breeze\\n' > /etc/sddm.conf.d/10-theme.conf\""
-            );
+        desktopConfig.writeFile("sddm theme", "/etc/sddm.conf.d/10-theme.conf",
+                                "[Theme]\nCurrent=breeze\n");
     }
 
+    neutralizeLoginNoise(desktopConfig);
+
     // Create user’s standard folders (harmless if they already exist)
-    runCommand(QString(
-                   "sudo arch-chroot /mnt bash -lc 'su - %1 -c xdg-user-dirs-update || true'"
-                   ).arg(username));
+    desktopConfig.runScript("xdg-user-dirs",
+                            QString("su - %1 -c xdg-user-dirs-update || true")
+                                .arg(ProcessExecutor::shellQuote(username)));
+
+    // Cinnamon safety: ensure a terminal exists even if upstream changes
+    if (choice == "Cinnamon") {
+        desktopConfig.runScript("Cinnamon terminal fallback",
+                                "command -v gnome-terminal >/dev/null || "
+                                    + ProcessExecutor::shellJoin(pacmanCommand({"pacman", "-S", "--noconfirm", "--needed", "xterm"})));
+    }
+
+    if (!commitTransaction(desktopConfig, "Desktop configuration"))
+        return false;
+    emit logMessage("Login banner/MOTD neutralized in target.");
 
     // Auto-apply icon theme for LXQt (robust, no fragile quoting)
     if (choice == "LXQt") {
@@ -594,36 +508,22 @@ bool SystemWorker::installDesktopAndDM()
         emit logMessage("LXQt: icon theme applied for the user.");
     }
 
-    // Cinnamon safety: ensure a terminal exists even if upstream changes
-    if (choice == "Cinnamon") {
-        runCommand(
-            "sudo arch-chroot /mnt bash -lc '"
-            "command -v gnome-terminal >/dev/null || pacman -S --noconfirm --needed xterm'"
-            );
-    }
-
-    if (!neutralizeLoginNoise()) return false;
-
     emit logMessage(QString("Desktop environment '%1' installed and configured.").arg(choice));
     return true;
 }
 
 // Neutralize live-ISO banners so PAM/DM won't show "installation guide" text at login.
-bool SystemWorker::neutralizeLoginNoise()
+void SystemWorker::neutralizeLoginNoise(ConfigTransaction &tx)
 {
-    // Minimal issue (TTY prompt text); harmless if not used by the greeter
-    if (!runCommand("sudo arch-chroot /mnt bash -lc 'printf \"Arch Linux \\\\r (\\\\l)\\\\n\" > /etc/issue'"))
-        return false;
+    // Minimal issue (TTY prompt text); \r and \l are agetty escapes, kept literal
+    tx.writeFile("login banner", "/etc/issue", "Arch Linux \\r (\\l)\n", true);
 
     // Empty MOTD (PAM will find nothing to display)
-    if (!runCommand("sudo arch-chroot /mnt bash -lc \"> /etc/motd\""))
-        return false;
+    tx.writeFile("motd", "/etc/motd", QByteArray(), true);
 
     // If issue.net exists (rare), clear it as well
-    runCommand("sudo arch-chroot /mnt bash -lc '[ -f /etc/issue.net ] && : > /etc/issue.net || true'");
-
-    emit logMessage("Login banner/MOTD neutralized in target.");
-    return true;
+    if (QFile::exists("/mnt/etc/issue.net"))
+        tx.writeFile("issue.net", "/etc/issue.net", QByteArray());
 }
 
 bool SystemWorker::applyLxqtIconTheme(const QString &user)
@@ -632,41 +532,39 @@ bool SystemWorker::applyLxqtIconTheme(const QString &user)
     QString uhome;
     {
         QString out;
-        if (!runCommandCapture(
-                QString("sudo arch-chroot /mnt bash -lc 'id -u %1 >/dev/null 2>&1 && getent passwd %1 | cut -d: -f6'")
-                    .arg(user),
-                &out)) {
+        if (!captureInTarget({"getent", "passwd", user}, &out)) {
             emit errorOccurred(QString("LXQt: user '%1' not found inside the target.").arg(user));
             return false;
         }
-        uhome = out.trimmed();
+        uhome = out.trimmed().section(':', 5, 5);
         if (uhome.isEmpty()) {
             emit errorOccurred(QString("LXQt: could not resolve home directory for '%1'.").arg(user));
             return false;
         }
     }
 
-    // 1) Detect an installed icon theme we can apply
+    // 1) Detect an installed icon theme we can apply (plain directory checks on the target)
     QString picked;
-    if (!runCommandCapture(
-            "sudo arch-chroot /mnt bash -lc '"
-            "for t in Papirus Papirus-Dark Papirus-Light ePapirus ePapirus-Dark Breeze oxygen Adwaita hicolor; do "
-            "  [ -d \"/usr/share/icons/$t\" ] && { echo \"$t\"; exit 0; }; "
-            "done; exit 1'",
-            &picked)) {
+    const QStringList themes = {"Papirus", "Papirus-Dark", "Papirus-Light", "ePapirus", "ePapirus-Dark",
+                                "Breeze", "oxygen", "Adwaita", "hicolor"};
+    for (const QString &t : themes) {
+        if (QFileInfo(QStringLiteral("/mnt/usr/share/icons/%1").arg(t)).isDir()) {
+            picked = t;
+            break;
+        }
+    }
+    if (picked.isEmpty()) {
         emit errorOccurred("LXQt: no suitable icon theme found under /usr/share/icons.");
         return false;
     }
-    picked = picked.trimmed();
     emit logMessage(QString("LXQt: will apply icon theme '%1'.").arg(picked));
 
     // 2) Write files as root, then chown to the user (no group name required)
     const QString script =
         QString(
-            "sudo arch-chroot /mnt bash -lc '"
-            "set -e; "
-            "UHOME=%1; THEME=%2; "
-            "mkdir -p \"$UHOME/.config/lxqt\" \"$UHOME/.config/gtk-3.0\" \"$UHOME/.config/gtk-4.0\"; "
+            "set -e\n"
+            "UHOME=%1; THEME=%2\n"
+            "mkdir -p \"$UHOME/.config/lxqt\" \"$UHOME/.config/gtk-3.0\" \"$UHOME/.config/gtk-4.0\"\n"
             // lxqt.conf (both sections some versions read)
             "cat > \"$UHOME/.config/lxqt/lxqt.conf\" <<EOF\n"
             "[Appearance]\n"
@@ -688,16 +586,17 @@ bool SystemWorker::applyLxqtIconTheme(const QString &user)
             "gtk-theme-name=Adwaita\n"
             "EOF\n"
             // Ownership: use primary group via 'user:' (no explicit group name)
-            "chown -R %3: \"$UHOME/.config/lxqt\" \"$UHOME/.config/gtk-3.0\" \"$UHOME/.config/gtk-4.0\"; "
+            "chown -R %3: \"$UHOME/.config/lxqt\" \"$UHOME/.config/gtk-3.0\" \"$UHOME/.config/gtk-4.0\"\n"
             // Session hint (harmless if already there)
-            "echo \"export XDG_CURRENT_DESKTOP=LXQt\" > /etc/profile.d/10-lxqt.sh; "
-            "chmod 0644 /etc/profile.d/10-lxqt.sh; "
+            "echo \"export XDG_CURRENT_DESKTOP=LXQt\" > /etc/profile.d/10-lxqt.sh\n"
+            "chmod 0644 /etc/profile.d/10-lxqt.sh\n"
             // Best effort icon cache refresh
-            "gtk-update-icon-cache -f /usr/share/icons/hicolor 2>/dev/null || true; "
-            "'"
-            ).arg(uhome, picked, user);
+            "gtk-update-icon-cache -f /usr/share/icons/hicolor 2>/dev/null || true\n"
+            ).arg(ProcessExecutor::shellQuote(uhome),
+                 ProcessExecutor::shellQuote(picked),
+                 ProcessExecutor::shellQuote(user));
 
-    if (!runCommand(script)) {
+    if (!runScriptInTarget(script)) {
         emit errorOccurred("LXQt: failed to write user appearance settings (applyCmd).");
         return false;
     }
@@ -705,96 +604,287 @@ bool SystemWorker::applyLxqtIconTheme(const QString &user)
     return true;
 }
 
-// Runs a shell command, captures its stdout into 'output', returns true on success (exit code 0).
-bool SystemWorker::runCommandCapture(const QString &command, QString *output)
+// Runs a host program, captures its stdout into 'output', returns true on success (exit code 0).
+bool SystemWorker::runCommandCapture(const QStringList &argv, QString *output)
 {
-    QProcess process;
-    process.start("bash", {"-lc", command});
-    if (!process.waitForFinished(-1)) {
-        emit errorOccurred(QString("Timeout while running command: %1").arg(command));
+    QByteArray out;
+    ProcessExecutor::Options opts;
+    opts.usePty = false;
+    opts.mergeStderr = false;
+    InstallTrace::Span span(QStringLiteral("command"), argv.value(0));
+    span.setArg(QStringLiteral("argv"), ProcessExecutor::shellJoin(argv));
+    const ProcessExecutor::Result r = CommandRunner::instance().run(
+        argv, [&out](const char *data, qsizetype size) { out.append(data, static_cast<int>(size)); }, opts);
+    span.setArgs(InstallTrace::processArgs(r));
+    if (!r.started) {
+        emit errorOccurred(r.error);
         return false;
     }
-    const int code = process.exitCode();
-    const QString out = QString::fromUtf8(process.readAllStandardOutput());
-    const QString err = QString::fromUtf8(process.readAllStandardError());
-    if (output) *output = out;
-    if (code != 0) {
+    if (output) *output = QString::fromUtf8(out);
+    if (r.exitCode != 0) {
         emit errorOccurred(QString("Command failed: %1\nExit code: %2\nError: %3")
-                               .arg(command).arg(code).arg(err.trimmed()));
+                               .arg(ProcessExecutor::shellJoin(argv))
+                               .arg(r.exitCode)
+                               .arg(QString::fromUtf8(r.stderrData).trimmed()));
         return false;
     }
     return true;
 }
 
-bool SystemWorker::runCommand(const QString &cmd) {
-    // Ensure the target root (and ESP when applicable) are mounted before any
-    // arch-chroot invocation. Some earlier steps (like ISO extraction) may
-    // leave /mnt in an unmounted state on certain hosts, which confused pacman
-    // into thinking there was no free disk space. Guard each chrooted call so
-    // we always operate on the real target filesystem.
-    if (cmd.contains(QStringLiteral("arch-chroot /mnt"))) {
-        if (!ensureTargetMounts())
-            return false;
+// m_chroot owns the API mounts; every thread that runs install steps gets
+// its own shell on top of them so concurrent steps never share a stdin.
+// Called with m_targetLock held.
+ChrootSession *SystemWorker::openChrootSession()
+{
+    if (!m_chroot.isOpen()) {
+        // A dead primary means its mounts are gone; the others go with it
+        retireChrootSessions();
+
+        QString err;
+        if (!m_chroot.open(&err)) {
+            emit errorOccurred(err);
+            return nullptr;
+        }
+        emit logMessage("Chroot session opened on /mnt.");
     }
 
-    // Stream stdout/stderr in real-time to avoid "big dump at the end".
-    QProcess proc;
+    ChrootSession *&session = m_threadSessions[QThread::currentThread()];
+    if (!session)
+        session = new ChrootSession(QStringLiteral("/mnt"), ChrootSession::SharedMounts);
+    else if (m_staleSessions.remove(QThread::currentThread()))
+        session->close();
+    session->setPreload(m_fsyncShim.isEmpty() ? QStringList() : QStringList{m_fsyncShim});
+    if (!session->isOpen()) {
+        QString err;
+        if (!session->open(&err)) {
+            emit errorOccurred(err);
+            return nullptr;
+        }
+    }
+    return session;
+}
 
-    // Keep stderr interleaved with stdout, so logs are chronological.
-    proc.setProcessChannelMode(QProcess::MergedChannels);
+// Drops the sessions before /mnt is remounted, or once its mounts are gone.
+// Other threads may be in the middle of a command on theirs, so those are
+// only marked; each thread replaces its own shell in openChrootSession()
+// before its next command. Called with m_targetLock held.
+void SystemWorker::retireChrootSessions()
+{
+    for (auto it = m_threadSessions.cbegin(); it != m_threadSessions.cend(); ++it) {
+        if (it.key() == QThread::currentThread())
+            it.value()->close();
+        else
+            m_staleSessions.insert(it.key());
+    }
+    m_chroot.close();
+}
 
-    // Use stdbuf to force line buffering (-oL = stdout, -eL = stderr).
-    // We go through /bin/sh -lc to handle quotes and let PATH resolve stdbuf.
-    const QString wrapped = QString("stdbuf -oL -eL %1").arg(cmd);
-    emit logMessage(QString("→ %1").arg(cmd));
-    proc.start("/bin/sh", {"-lc", wrapped});
+void SystemWorker::closeChrootSessions()
+{
+    QMutexLocker locker(&m_targetLock);
+    for (ChrootSession *s : std::as_const(m_threadSessions)) {
+        s->close();
+        delete s;
+    }
+    m_threadSessions.clear();
+    m_staleSessions.clear();
+    m_chroot.close();
+}
 
-    if (!proc.waitForStarted()) {
-        emit errorOccurred(QString("Failed to start: %1").arg(cmd));
-        return false;
+// Ensure the target root (and ESP when applicable) are mounted before anything
+// runs inside it. Some earlier steps (like ISO extraction) may leave /mnt in an
+// unmounted state on certain hosts, which confused pacman into thinking there
+// was no free disk space. Guard each chrooted call so we always operate on the
+// real target filesystem.
+ChrootSession *SystemWorker::prepareTarget()
+{
+    QMutexLocker locker(&m_targetLock);
+    // Replay answers session commands itself; the sessions are never opened
+    if (!CommandRunner::instance().isLive()) {
+        ChrootSession *&session = m_threadSessions[QThread::currentThread()];
+        if (!session)
+            session = new ChrootSession(QStringLiteral("/mnt"), ChrootSession::SharedMounts);
+        return session;
     }
+    if (!ensureTargetMounts())
+        return nullptr;
+    return openChrootSession();
+}
 
-    QByteArray acc;  // line accumulator
-    auto flushLines = [&]() {
-        int nl;
-        while ((nl = acc.indexOf('\n')) >= 0) {
-            const QByteArray line = acc.left(nl);
-            acc.remove(0, nl + 1);
-            if (!line.trimmed().isEmpty())
-                emit logMessage(QString::fromUtf8(line));
-        }
-    };
+// Session output reaches the log in blocks: whatever arrived by the time
+// the command goes quiet is sent as one logMessage.
+int SystemWorker::runLoggedInSession(ChrootSession *session, const QString &command, const QString &recordAs)
+{
+    LineBatcher log([this](const QString &block) { emit logMessage(block); });
+    session->setIdleHandler([&log]() { log.flush(); });
+    const int code = CommandRunner::instance().runInSession(
+        *session, command, [&log](const QString &line) { log.add(line); }, nullptr, recordAs);
+    session->setIdleHandler(nullptr);
+    return code;
+}
 
-    // Read as data arrives
-    while (proc.state() != QProcess::NotRunning) {
-        if (proc.waitForReadyRead(200)) {
-            acc.append(proc.readAll());
-            flushLines();
+bool SystemWorker::finishTargetCommand(int code, const QString &display)
+{
+    if (code == 0)
+        return true;
+    emit errorOccurred(code < 0
+                           ? QString("Chroot session terminated while running: %1").arg(display)
+                           : QString("Command failed (exit %1): %2").arg(code).arg(display));
+    return false;
+}
+
+// Chrooted commands go to the persistent session instead of paying for a
+// fresh arch-chroot (mount setup + teardown + shell) every time.
+bool SystemWorker::runInTarget(const QStringList &argv, bool quiet)
+{
+    ChrootSession *session = prepareTarget();
+    if (!session)
+        return false;
+    const QString display = ProcessExecutor::shellJoin(argv);
+    emit logMessage(QString("→ [target] %1").arg(display));
+    InstallTrace::Span span(QStringLiteral("target"), argv.value(0));
+    span.setArg(QStringLiteral("argv"), display);
+    const int code = runLoggedInSession(session, display);
+    span.setArgs(sessionArgs(code, session->lastStats()));
+    return quiet ? code == 0 : finishTargetCommand(code, display);
+}
+
+// For the few steps that genuinely need shell syntax (redirections, globs,
+// loops). The script is handed to the session shell verbatim: one level of
+// quoting, no bash -lc wrapping.
+bool SystemWorker::runScriptInTarget(const QString &script)
+{
+    ChrootSession *session = prepareTarget();
+    if (!session)
+        return false;
+    emit logMessage(QString("→ [target] %1").arg(script));
+    InstallTrace::Span span(QStringLiteral("target"), QStringLiteral("script"));
+    span.setArg(QStringLiteral("script"), script);
+    const int code = runLoggedInSession(session, script);
+    span.setArgs(sessionArgs(code, session->lastStats()));
+    return finishTargetCommand(code, script);
+}
+
+// Applies a configuration batch through the session and reports each failed
+// step on its own. Only fatal steps make this return false.
+bool SystemWorker::commitTransaction(ConfigTransaction &tx, const QString &what)
+{
+    if (tx.isEmpty())
+        return true;
+    ChrootSession *session = prepareTarget();
+    if (!session)
+        return false;
+
+    emit logMessage(QString("→ [target] %1 (%2 steps)").arg(what).arg(tx.size()));
+    InstallTrace::Span span(QStringLiteral("target"), what);
+    span.setArg(QStringLiteral("steps"), tx.size());
+    bool ok;
+    {
+        LineBatcher log([this](const QString &block) { emit logMessage(block); });
+        session->setIdleHandler([&log]() { log.flush(); });
+        ok = tx.commit(*session, [&log](const QString &line) { log.add(line); });
+        session->setIdleHandler(nullptr);
+    }
+    span.setArg(QStringLiteral("ok"), ok);
+
+    int failed = 0;
+    for (const ConfigTransaction::StepResult &r : tx.results()) {
+        if (r.ok)
+            continue;
+        QString reason;
+        if (!r.ran)
+            reason = r.message.isEmpty() ? QStringLiteral("skipped") : r.message;
+        else if (!r.message.isEmpty())
+            reason = r.message;
+        else
+            reason = QString("exit %1").arg(r.exitCode);
+
+        if (r.fatal && r.ran) {
+            emit errorOccurred(QString("%1: step '%2' failed (%3)").arg(what, r.label, reason));
         } else {
-            // keep UI responsive
-            QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+            emit logMessage(QString("%1: step '%2' failed (%3)").arg(what, r.label, reason));
         }
+        ++failed;
     }
+    if (ok && failed == 0)
+        emit logMessage(QString("%1 applied.").arg(what));
+    return ok;
+}
 
-    // Flush any trailing partial line
-    acc.append(proc.readAll());
-    if (!acc.isEmpty()) {
-        const QString tail = QString::fromUtf8(acc).trimmed();
-        if (!tail.isEmpty()) emit logMessage(tail);
+bool SystemWorker::captureInTarget(const QStringList &argv, QString *output)
+{
+    ChrootSession *session = prepareTarget();
+    if (!session)
+        return false;
+    QStringList lines;
+    QByteArray err;
+    InstallTrace::Span span(QStringLiteral("target"), argv.value(0));
+    span.setArg(QStringLiteral("argv"), ProcessExecutor::shellJoin(argv));
+    const int code = CommandRunner::instance().runInSession(
+        *session, ProcessExecutor::shellJoin(argv), [&lines](const QString &line) { lines << line; }, &err);
+    span.setArgs(sessionArgs(code, session->lastStats()));
+    if (output) *output = lines.join('\n');
+    if (code != 0) {
+        emit errorOccurred(QString("Command failed: %1\nExit code: %2\nError: %3")
+                               .arg(ProcessExecutor::shellJoin(argv))
+                               .arg(code)
+                               .arg(QString::fromUtf8(err).trimmed()));
+        return false;
     }
+    return true;
+}
 
-    const int code = proc.exitCode();
-    if (code != 0) {
-        const QString err = QString::fromUtf8(proc.readAllStandardError()).trimmed();
-        emit errorOccurred(err.isEmpty()
-                               ? QString("Command failed (exit %1): %2").arg(code).arg(cmd)
-                               : QString("Command failed (exit %1): %2\n%3").arg(code).arg(cmd, err));
+// chpasswd without echoing the secret into the log or through extra shells
+bool SystemWorker::setTargetPassword(const QString &user, const QString &secret)
+{
+    ChrootSession *session = prepareTarget();
+    if (!session)
+        return false;
+    const QString script = QString("printf '%s\\n' %1 | chpasswd")
+                               .arg(ProcessExecutor::shellQuote(user + ':' + secret));
+    emit logMessage(QString("→ [target] chpasswd (%1)").arg(user));
+    const QString display = QString("chpasswd (%1)").arg(user);
+    InstallTrace::Span span(QStringLiteral("target"), display);
+    const int code = runLoggedInSession(session, script, display);
+    span.setArgs(sessionArgs(code, session->lastStats()));
+    return finishTargetCommand(code, display);
+}
+
+// Runs a host program directly (one fork/exec) and streams its output to the log.
+bool SystemWorker::runCommand(const QStringList &argv)
+{
+    const QString display = ProcessExecutor::shellJoin(argv);
+    emit logMessage(QString("→ %1").arg(display));
+
+    // Each chunk read from the child is split in place and its lines go out
+    // as one log block; a partial line waits for the rest of it.
+    LineSplitter lines;
+    LineBatcher log([this](const QString &block) { emit logMessage(block); });
+    const LineSplitter::LineHandler toLog = [&log](const char *line, qsizetype size) { log.add(line, size); };
+
+    InstallTrace::Span span(QStringLiteral("command"), argv.value(0));
+    span.setArg(QStringLiteral("argv"), display);
+    const ProcessExecutor::Result r = CommandRunner::instance().run(argv, [&](const char *data, qsizetype size) {
+        lines.feed(data, size, toLog);
+        log.flush();
+    }, ProcessExecutor::Options());
+    span.setArgs(InstallTrace::processArgs(r));
+    if (!r.started) {
+        emit errorOccurred(QString("Failed to start: %1\n%2").arg(display, r.error));
+        return false;
+    }
+
+    // Trailing partial line
+    lines.finish(toLog);
+    log.flush();
+
+    if (r.exitCode != 0) {
+        emit errorOccurred(QString("Command failed (exit %1): %2").arg(r.exitCode).arg(display));
         return false;
     }
     return true;
 }
 
-// Ensure whatever the UI passes (pretty text or real path) becomes a canonical /dev/... path
 void SystemWorker::setTargetPartition(const QString &sel)
 {
     m_targetPartition = normalizePartitionPath(sel);
@@ -810,6 +900,7 @@ bool SystemWorker::hasTargetPartition()
     return !m_targetPartition.isEmpty();
 }
 
+
 bool SystemWorker::installGrubRobust(const QString &targetDisk, bool efiInstall)
 {
     // targetDisk example: "/dev/sda" or "/dev/nvme0n1"
@@ -820,52 +911,44 @@ bool SystemWorker::installGrubRobust(const QString &targetDisk, bool efiInstall)
         emit logMessage("Installing GRUB for UEFI…");
 
         // Make sure ESP is mounted at /mnt/boot/efi
-        if (!runCommand("sudo arch-chroot /mnt bash -lc 'mkdir -p /boot/efi'"))
+        if (!runInTarget({"mkdir", "-p", "/boot/efi"}))
             return false;
 
         // If /mnt/boot/efi is empty, try to auto-mount an ESP by PARTUUID/label/flag
         // (Safe no-ops if already mounted)
-        runCommand(
-            "bash -lc '"
-            "if ! mountpoint -q /mnt/boot/efi; then "
-            "  ESP=$(lsblk -rpno NAME,PARTTYPE,PARTLABEL,PARTFLAGS " + disk +
-            R"( | awk '/c12a7328-f81f-11d2-ba4b-00a0c93ec93b|esp|boot/ {print $1; exit}'); )"
-            "  if [ -n \"$ESP\" ]; then sudo mount \"$ESP\" /mnt/boot/efi; fi; "
-            "fi'");
+        runCommand({"bash", "-c",
+                    "if ! mountpoint -q /mnt/boot/efi; then "
+                    "  ESP=$(lsblk -rpno NAME,PARTTYPE,PARTLABEL,PARTFLAGS " + ProcessExecutor::shellQuote(disk) +
+                    R"( | awk '/c12a7328-f81f-11d2-ba4b-00a0c93ec93b|esp|boot/ {print $1; exit}'); )"
+                    "  if [ -n \"$ESP\" ]; then mount \"$ESP\" /mnt/boot/efi; fi; "
+                    "fi"});
 
         // Install GRUB to the ESP with a named boot entry
-        if (!runCommand(
-                "sudo arch-chroot /mnt bash -lc "
-                "'grub-install --target=x86_64-efi "
-                "--efi-directory=/boot/efi "
-                "--bootloader-id=Arch "
-                "--recheck'"))
+        if (!runInTarget({"grub-install", "--target=x86_64-efi",
+                          "--efi-directory=/boot/efi",
+                          "--bootloader-id=Arch",
+                          "--recheck"}))
         {
             emit logMessage("grub-install (NVRAM entry) failed — falling back to removable path…");
 
             // Fallback: write the removable bootloader (no NVRAM needed)
-            if (!runCommand(
-                    "sudo arch-chroot /mnt bash -lc "
-                    "'grub-install --target=x86_64-efi "
-                    "--efi-directory=/boot/efi "
-                    "--removable --recheck'"))
+            if (!runInTarget({"grub-install", "--target=x86_64-efi",
+                              "--efi-directory=/boot/efi",
+                              "--removable", "--recheck"}))
                 return false;
         }
 
         // Optional: make sure the EFI/BOOT fallback exists even when the first call succeeded
-        runCommand(
-            "sudo arch-chroot /mnt bash -lc "
-            "'if [ ! -e /boot/efi/EFI/BOOT/BOOTX64.EFI ]; then "
+        runScriptInTarget(
+            "if [ ! -e /boot/efi/EFI/BOOT/BOOTX64.EFI ]; then "
             "   mkdir -p /boot/efi/EFI/BOOT && "
             "   cp -f /boot/efi/EFI/Arch/grubx64.efi /boot/efi/EFI/BOOT/BOOTX64.EFI || true; "
-            "fi'");
+            "fi");
 
-        // Generate GRUB config now; os-prober step can still add more later
-        if (!runCommand("sudo arch-chroot /mnt bash -lc 'grub-mkconfig -o /boot/grub/grub.cfg'"))
-            return false;
+        markBootFileDirty(GrubConfig);
 
         // Try to ensure an NVRAM entry exists; not fatal if efibootmgr can’t write
-        runCommand("sudo arch-chroot /mnt bash -lc 'efibootmgr -v || true'");
+        runScriptInTarget("efibootmgr -v || true");
 
         emit logMessage("UEFI GRUB installation completed.");
         return true;
@@ -873,11 +956,9 @@ bool SystemWorker::installGrubRobust(const QString &targetDisk, bool efiInstall)
         emit logMessage("Installing GRUB for legacy BIOS (MBR)…");
 
         // IMPORTANT: install to the DISK, not a partition
-        if (!runCommand("sudo arch-chroot /mnt bash -lc 'grub-install --target=i386-pc --recheck " + disk + "'"))
-            return false;
-
-        if (!runCommand("sudo arch-chroot /mnt bash -lc 'grub-mkconfig -o /boot/grub/grub.cfg'"))
+        if (!runInTarget({"grub-install", "--target=i386-pc", "--recheck", disk}))
             return false;
+        markBootFileDirty(GrubConfig);
 
         emit logMessage("BIOS GRUB installation completed.");
         return true;
@@ -888,103 +969,415 @@ bool SystemWorker::generateGrubWithOsProber()
 {
     emit logMessage("Enabling os-prober for GRUB…");
 
-    // Make sure os-prober is installed (idempotent)
-    if (!runCommand("sudo arch-chroot /mnt pacman -Sy --noconfirm os-prober dialog networkmanager ntfs-3g --needed"))
-        return false;
-
     // Ensure GRUB uses os-prober: set or replace the line in /etc/default/grub
-    if (!runCommand(
-            "sudo arch-chroot /mnt bash -c "
-            "\"if grep -q '^GRUB_DISABLE_OS_PROBER=' /etc/default/grub; then "
+    if (!runScriptInTarget(
+            "if grep -q '^GRUB_DISABLE_OS_PROBER=' /etc/default/grub; then "
             "sed -i 's/^GRUB_DISABLE_OS_PROBER=.*/GRUB_DISABLE_OS_PROBER=false/' /etc/default/grub; "
             "else "
             "echo 'GRUB_DISABLE_OS_PROBER=false' >> /etc/default/grub; "
-            "fi\""
+            "fi"
             )) return false;
 
     // Make sure the prober script is executable if it exists
-    if (!runCommand("sudo arch-chroot /mnt bash -c 'if [ -f /etc/grub.d/30_os-prober ]; then chmod +x /etc/grub.d/30_os-prober; fi'"))
+    if (!runScriptInTarget("if [ -f /etc/grub.d/30_os-prober ]; then chmod +x /etc/grub.d/30_os-prober; fi"))
         return false;
 
     // Run os-prober (don't fail if it returns 1 when nothing is found)
-    if (!runCommand("sudo arch-chroot /mnt bash -c 'os-prober || true'"))
+    if (!runScriptInTarget("os-prober || true"))
         return false;
 
-    // Generate GRUB config (use update-grub if available, else grub-mkconfig)
-    if (!runCommand(
-            "sudo arch-chroot /mnt bash -c "
-            "'if command -v update-grub >/dev/null 2>&1; then "
-            "update-grub; "
-            "else "
-            "grub-mkconfig -o /boot/grub/grub.cfg; "
-            "fi'"
-            )) return false;
+    // The menu itself is generated once, after everything else is in place
+    markBootFileDirty(GrubConfig);
+    emit logMessage("os-prober enabled; the GRUB menu is generated at the end.");
+    return true;
+}
+
+// genfstab, then keep only the leading comments and the first real entry
+// (same filter the old awk one-liner applied), written straight into the target.
+bool SystemWorker::writeTargetFstab()
+{
+    QString generated;
+    if (!runCommandCapture({"genfstab", "-U", "/mnt"}, &generated))
+        return false;
+
+    QStringList kept;
+    for (const QString &line : generated.split('\n')) {
+        kept << line;
+        const QString t = line.trimmed();
+        if (!t.isEmpty() && !t.startsWith('#'))
+            break;
+    }
 
-    emit logMessage("GRUB menu generated with os-prober results.");
+    // Under replay the target tree is not ours to touch
+    if (!CommandRunner::instance().isLive()) {
+        emit logMessage("Replay: not writing /mnt/etc/fstab.");
+        return true;
+    }
+    QFile fstab("/mnt/etc/fstab");
+    if (!fstab.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        emit errorOccurred(QString("Failed to write /mnt/etc/fstab: %1").arg(fstab.errorString()));
+        return false;
+    }
+    fstab.write(kept.join('\n').toUtf8());
+    fstab.write("\n");
+    fstab.close();
+    emit logMessage("fstab written to target.");
     return true;
 }
 
-void SystemWorker::run() {
-    emit logMessage("\xF0\x9F\x9A\x80 Starting system installation...");
+// --- Install steps ---------------------------------------------------------
+// Each one is a node in the graph built by run(); see the declared inputs,
+// outputs and resources there.
 
-    if (!ensureTargetMounts())
-        return;
+// What extractRootfs() unpacks: the downloaded ISO, a copy older versions
+// left in the target, or only the root filesystem image the wizard fetched
+static QString rootfsSource()
+{
+    for (const QString &path : {QDir::tempPath() + "/archlinux.iso", kLegacyIso,
+                                QDir::tempPath() + "/airootfs.sfs"}) {
+        if (QFile::exists(path))
+            return path;
+    }
+    return QString();
+}
 
-    QString isoPath = "/mnt/archlinux.iso";
-    if (!QFile::exists(isoPath)) {
-        QString tmpIso = QDir::tempPath() + "/archlinux.iso";
-        if (QFile::exists(tmpIso)) {
-            if (!runCommand(QString("sudo cp %1 %2").arg(tmpIso, isoPath)))
-                return;
-        } else {
-            emit errorOccurred("Arch Linux ISO not found");
-            return;
+bool SystemWorker::extractRootfs()
+{
+    const QString source = rootfsSource();
+    if (source.endsWith(".sfs")) {
+        QString error;
+        if (!unsquash(source, 0, &error)) {
+            emit errorOccurred("Extracting the rootfs failed: " + error);
+            return false;
         }
+        emit logMessage("Rootfs extracted from " + source + ".");
+        return true;
     }
 
-    QDir().mkdir("/mnt/archiso");
-    QDir().mkdir("/mnt/rootfs");
+    const QString isoPath = source.isEmpty() ? QDir::tempPath() + "/archlinux.iso" : source;
+    if (CommandRunner::instance().isLive() && !QFile::exists(isoPath)) {
+        emit errorOccurred("Arch Linux ISO not found");
+        return false;
+    }
 
-    if (!runCommand(QString("sudo mount -o loop %1 /mnt/archiso").arg(isoPath)))
-        return;
+    // unsquashfs reads the squashfs in place at its offset inside the ISO:
+    // no copy of the image and no loop device
+    QString error;
+    IsoImage iso(isoPath);
+    const IsoImage::Extent sfs = iso.find(kAirootfs, &error);
+    bool extracted = false;
+    if (sfs.isValid()) {
+        emit logMessage(QString("Found %1 at offset %2 (%3 MiB).")
+                            .arg(kAirootfs).arg(sfs.offset).arg(sfs.size >> 20));
+        extracted = unsquash(isoPath, sfs.offset, &error);
+    }
 
-    QString squashfsPath = "/mnt/archiso/arch/x86_64/airootfs.sfs";
-    if (!runCommand(QString("sudo unsquashfs -f -d /mnt %1").arg(squashfsPath)))
+    // Everything up to here is quiet; the fallback decides what the user
+    // hears, and reports the in-place failure along with its own
+    if (!extracted) {
+        emit logMessage("Reading the ISO directly failed (" + error + "); loop-mounting it instead.");
+        const QString directError = error;
+        const bool live = CommandRunner::instance().isLive();
+        const QString mountPoint = QDir::tempPath() + "/archaid-iso";
+        if (live)
+            QDir().mkpath(mountPoint);
+        if (CommandRunner::instance().execute("mount", {"-o", "loop,ro", isoPath, mountPoint}) != 0) {
+            if (live)
+                QDir().rmdir(mountPoint);
+            emit errorOccurred("Extracting the rootfs failed: " + directError
+                               + "; loop-mounting " + isoPath + " failed too.");
+            return false;
+        }
+        extracted = unsquash(mountPoint + "/" + kAirootfs, 0, &error);
+        CommandRunner::instance().execute("umount", {"-l", mountPoint});
+        if (live)
+            QDir().rmdir(mountPoint);
+        if (!extracted) {
+            emit errorOccurred("Extracting the rootfs failed: " + error + " (reading the ISO in place: "
+                               + directError + ")");
+            return false;
+        }
+    }
+
+    // The legacy copy must not stay behind in the target
+    if (isoPath == kLegacyIso && CommandRunner::instance().isLive())
+        QFile::remove(kLegacyIso);
+    emit logMessage("Rootfs extracted from the ISO.");
+    return true;
+}
+
+// Unpacks a squashfs into /mnt, passing its progress on. A superblock that
+// can't be read only matters for a live install; replays don't have the ISO.
+bool SystemWorker::unsquash(const QString &image, qint64 offset, QString *error)
+{
+    SquashfsExtractor extractor(image, offset);
+    if (extractor.readSuperblock(error)) {
+        const SquashfsExtractor::Superblock &sb = extractor.superblock();
+        emit logMessage(QString("Squashfs: %1 inodes, %2 MiB, %3 compression.")
+                            .arg(sb.inodes).arg(sb.bytesUsed >> 20)
+                            .arg(SquashfsExtractor::compressionName(sb.compression)));
+    } else if (CommandRunner::instance().isLive()) {
+        return false;
+    }
+
+    int lastLogged = 0;
+    return extractor.extract("/mnt", [&](const SquashfsExtractor::Progress &p) {
+        emit extractionProgress(p.percent, p.estimatedFilesDone, p.filesTotal);
+        if (p.percent >= lastLogged + 10) {
+            lastLogged = p.percent - p.percent % 10;
+            emit logMessage(QString("Extracting rootfs: %1% (about %2 of %3 files)")
+                                .arg(p.percent).arg(p.estimatedFilesDone).arg(p.filesTotal));
+        }
+    }, [this](const QString &block) { emit logMessage(block); }, error);
+}
+
+// Probes candidate mirrors while the rootfs is being extracted. Candidates
+// come from ARCHAID_MIRROR_CANDIDATES (a mirrorlist file, e.g. pointing at
+// local stand-ins), else archlinux.org's mirror status, else the host's
+// mirrorlist. A mirror typed into the wizard is kept first if it answers.
+bool SystemWorker::rankMirrors()
+{
+    if (!CommandRunner::instance().isLive() || installsOffline())
+        return true;
+
+    QStringList candidates;
+    const QString candidateFile = qEnvironmentVariable("ARCHAID_MIRROR_CANDIDATES");
+    if (!candidateFile.isEmpty()) {
+        QFile f(candidateFile);
+        if (f.open(QIODevice::ReadOnly))
+            candidates = MirrorRanker::parseMirrorlist(QString::fromUtf8(f.readAll()));
+    } else {
+        candidates = MirrorRanker::statusCandidates(kMirrorCandidates, 5000);
+        if (candidates.isEmpty()) {
+            QFile f("/etc/pacman.d/mirrorlist");
+            if (f.open(QIODevice::ReadOnly))
+                candidates = MirrorRanker::parseMirrorlist(QString::fromUtf8(f.readAll())).mid(0, kMirrorCandidates);
+        }
+    }
+
+    QString pinned;
+    if (!customMirrorUrl.isEmpty()) {
+        pinned = customMirrorUrl.endsWith('/') ? customMirrorUrl : customMirrorUrl + '/';
+        pinned += "$repo/os/$arch";
+        candidates.removeAll(pinned);
+        candidates.prepend(pinned);
+    }
+    if (candidates.isEmpty()) {
+        emit logMessage("No mirror candidates found; keeping the ISO's mirrorlist.");
+        return true;
+    }
+
+    InstallTrace::Span span(QStringLiteral("network"), QStringLiteral("rank mirrors"));
+    span.setArg(QStringLiteral("candidates"), candidates.size());
+    emit logMessage(QString("Ranking %1 mirrors…").arg(candidates.size()));
+
+    MirrorRanker ranker;
+    ranker.setCandidates(candidates);
+    QList<MirrorRanker::Probe> ranking = ranker.rank();
+    for (int i = 0; i < ranking.size(); ++i) {
+        if (ranking.at(i).server == pinned && ranking.at(i).ok) {
+            ranking.move(i, 0);
+            break;
+        }
+    }
+
+    m_rankedMirrorlist = MirrorRanker::formatMirrorlist(ranking, kMirrorsKept);
+    if (m_rankedMirrorlist.isEmpty()) {
+        emit logMessage("No mirror answered the probe; keeping the ISO's mirrorlist.");
+        return true;
+    }
+    const MirrorRanker::Probe &best = ranking.first();
+    span.setArg(QStringLiteral("best"), best.server);
+    emit logMessage(QString("Fastest mirror: %1 (%2 ms, %3 MiB/s)")
+                        .arg(best.server)
+                        .arg(best.latencyUs / 1000)
+                        .arg(best.bytesPerSecond() / (1024 * 1024), 0, 'f', 1));
+    return true;
+}
+
+// Brings the offline repository up to date from its sources, mounts it
+// read-only into the target and writes the pacman.conf every pacman step
+// uses from here on. Runs on every install, so a rerun mounts it again.
+bool SystemWorker::prepareOfflineRepository()
+{
+    OfflineRepository repo(m_offlineRepo);
+    const bool live = CommandRunner::instance().isLive();
+    if (live && !m_offlineSources.isEmpty()) {
+        InstallTrace::Span span(QStringLiteral("offline"), QStringLiteral("build offline repository"));
+        QString error;
+        int added = 0;
+        int skipped = 0;
+        if (!repo.build(m_offlineSources, kHostSyncDir, &error, &added, &skipped)) {
+            emit errorOccurred("Offline repository: " + error);
+            return false;
+        }
+        span.setArg(QStringLiteral("added"), added);
+        span.setArg(QStringLiteral("skipped"), skipped);
+        if (added > 0)
+            emit logMessage(QString("Added %1 packages to the offline repository %2.").arg(added).arg(repo.dir()));
+        if (skipped > 0)
+            emit logMessage(QString("Left %1 packages without a valid signature out of the offline repository.").arg(skipped));
+    }
+    if (live && !repo.exists()) {
+        emit errorOccurred("No offline repository database at " + repo.databasePath());
+        return false;
+    }
+
+    // A repository that lacks part of the transaction would fail it halfway;
+    // the network is the better bet then
+    if (live) {
+        InstallTrace::Span span(QStringLiteral("offline"), QStringLiteral("check offline repository"));
+        QString error;
+        const QStringList needed = PackagePlan(desktopEnv, m_firmware).packages() + QStringList{"archlinux-keyring"};
+        if (!repo.covers(needed, "/mnt/var/lib/pacman/local", &error)) {
+            span.setArg(QStringLiteral("ok"), false);
+            emit logMessage("The offline repository can't serve this install (" + error
+                            + "); installing from the network instead.");
+            m_offlineFallback.storeRelease(1);
+            return true;
+        }
+    }
+
+    if (live)
+        QDir().mkpath("/mnt" + kOfflineMount);
+    if (CommandRunner::instance().execute("mount", {"--bind", "-o", "ro", repo.dir(), "/mnt" + kOfflineMount}) != 0) {
+        emit errorOccurred("Could not mount the offline repository into the target.");
+        return false;
+    }
+
+    ConfigTransaction tx;
+    tx.writeFile("offline pacman.conf", kOfflineConfig, OfflineRepository::pacmanConfig(kOfflineMount), true);
+    if (!commitTransaction(tx, "offline repository"))
+        return false;
+    m_pacmanConfig = kOfflineConfig;
+    emit logMessage("Installing offline from " + repo.dir());
+    return true;
+}
+
+void SystemWorker::releaseOfflineRepository()
+{
+    if (m_pacmanConfig.isEmpty())
         return;
+    m_pacmanConfig.clear();
+    CommandRunner::instance().execute("umount", {"/mnt" + kOfflineMount});
+    if (CommandRunner::instance().isLive()) {
+        QFile::remove("/mnt" + kOfflineConfig);
+        QDir().rmdir("/mnt" + kOfflineMount);
+        QDir().rmdir("/mnt/var/cache/archaid");
+    }
+}
 
-    emit logMessage("ISO mounted and rootfs extracted");
-    runCommand("sudo umount -Rfl /mnt/archiso");
+// Finds libeatmydata for the target: its own, a copy of the host's (glibc
+// runs older builds fine), or, when allowInstall is set, the package.
+// Sessions pick the preload up with their next command.
+bool SystemWorker::enableFsyncShim(bool allowInstall)
+{
+    if (!m_suppressFsync || !m_fsyncShim.isEmpty() || !CommandRunner::instance().isLive())
+        return true;
 
-    runCommand("sudo rm -f /mnt/etc/resolv.conf");
-    runCommand("sudo cp /etc/resolv.conf /mnt/etc/resolv.conf");
+    QString shim;
+    if (QFileInfo::exists("/mnt" + kFsyncShim)) {
+        shim = kFsyncShim;
+    } else {
+        for (const QString &host : {QStringLiteral("/usr/lib/libeatmydata.so"),
+                                    QStringLiteral("/usr/lib/x86_64-linux-gnu/libeatmydata.so"),
+                                    QStringLiteral("/usr/lib64/libeatmydata.so")}) {
+            QFile::remove("/mnt" + kCopiedFsyncShim);
+            if (QFileInfo::exists(host) && QFile::copy(host, "/mnt" + kCopiedFsyncShim)) {
+                shim = kCopiedFsyncShim;
+                break;
+            }
+        }
+    }
+    if (shim.isEmpty() && allowInstall
+        && runInTarget(pacmanCommand({"pacman", "-S", "--noconfirm", "--needed", "libeatmydata"}))
+        && QFileInfo::exists("/mnt" + kFsyncShim)) {
+        shim = kFsyncShim;
+        m_fsyncShimInstalled = true;
+    }
+    if (shim.isEmpty()) {
+        if (allowInstall)
+            emit logMessage("libeatmydata is not available; target commands keep their fsync calls.");
+        return false;
+    }
 
-    runCommand(
-        "sudo arch-chroot /mnt bash -lc \"set -e; "
-        "for d in /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync; do "
-        "  if [ -L \\\"$d\\\" ] || { [ -e \\\"$d\\\" ] && [ ! -d \\\"$d\\\" ]; }; then rm -rf \\\"$d\\\"; fi; "
-        "done; "
-        "mkdir -p /var/cache/pacman/pkg /var/lib/pacman/sync; "
-        "chown root:root /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync; "
-        "chmod 0755 /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync;\"");
+    QMutexLocker locker(&m_targetLock);
+    m_fsyncShim = shim;
+    emit logMessage("fsync suppressed for target commands; the target is synced once at the end.");
+    return true;
+}
 
+void SystemWorker::releaseFsyncShim()
+{
+    QString shim;
+    {
+        QMutexLocker locker(&m_targetLock);
+        shim.swap(m_fsyncShim);
+    }
+    if (m_fsyncShimInstalled) {
+        runInTarget(pacmanCommand({"pacman", "-R", "--noconfirm", "libeatmydata"}));
+        m_fsyncShimInstalled = false;
+    } else if (shim == kCopiedFsyncShim) {
+        QFile::remove("/mnt" + kCopiedFsyncShim);
+    }
+}
+
+// One syncfs() per target filesystem in place of all the skipped fsyncs
+void SystemWorker::syncTarget()
+{
+    if (!CommandRunner::instance().isLive())
+        return;
+    InstallTrace::Span span(QStringLiteral("mount"), QStringLiteral("sync target"));
+    QMutexLocker locker(&m_targetLock);
+    for (const QString &path : {QStringLiteral("/mnt"), QStringLiteral("/mnt/boot/efi")}) {
+        if (!isMountPoint(path))
+            continue;
+        const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        if (::syncfs(fd) != 0)
+            emit logMessage("syncfs failed on " + path);
+        ::close(fd);
+    }
+}
+
+bool SystemWorker::preparePacman()
+{
+    // Through the runner, so a replay neither touches /mnt nor loses the step
+    if (CommandRunner::instance().execute("cp", {"--remove-destination", "/etc/resolv.conf", "/mnt/etc/resolv.conf"}) != 0)
+        emit logMessage("Could not copy /etc/resolv.conf into the target.");
 
     // Ensure pacman cache and database directories are real directories on the
     // target filesystem (the live ISO uses tmpfs-backed symlinks which break
     // pacman's space checks once copied over).
-    if (!runCommand(
-            "sudo arch-chroot /mnt bash -lc \""
-            "set -e;"
-            "for d in /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync; do "
-            "  if [ -L \\\"$d\\\" ] || { [ -e \\\"$d\\\" ] && [ ! -d \\\"$d\\\" ]; }; then rm -rf \\\"$d\\\"; fi; "
-            "done;"
-            "mkdir -p /var/cache/pacman/pkg /var/lib/pacman/sync;"
-            "chown root:root /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync;"
-            "chmod 0755 /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync;"
-            "\""))
-        return;
+    if (!runScriptInTarget(
+            "set -e\n"
+            "for d in /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync; do\n"
+            "  if [ -L \"$d\" ] || { [ -e \"$d\" ] && [ ! -d \"$d\" ]; }; then rm -rf \"$d\"; fi\n"
+            "done\n"
+            "mkdir -p /var/cache/pacman/pkg /var/lib/pacman/sync\n"
+            "chown root:root /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync\n"
+            "chmod 0755 /var/cache/pacman /var/cache/pacman/pkg /var/lib/pacman /var/lib/pacman/sync"))
+        return false;
+
+    // Ranked mirrors and parallel downloads before the first transaction
+    ConfigTransaction tx;
+    if (!m_rankedMirrorlist.isEmpty())
+        tx.writeFile("mirrorlist", "/etc/pacman.d/mirrorlist", m_rankedMirrorlist.toUtf8());
+    TargetConfig::setParallelDownloads(tx, kParallelDownloads);
+    if (!commitTransaction(tx, "pacman mirrors"))
+        return false;
+
+    if (m_reuseHostCache && !installsOffline())
+        seedSyncDatabases();
+    enableFsyncShim(false);
 
+    if (!QFile::exists("/mnt/usr/bin/pacman") && installsOffline()) {
+        emit errorOccurred("The extracted rootfs has no pacman, and an offline install can't fetch the bootstrap.");
+        return false;
+    }
     if (!QFile::exists("/mnt/usr/bin/pacman")) {
-    QString mirrorUrl = customMirrorUrl;
+        QString mirrorUrl = customMirrorUrl;
         QString bootstrapUrl;
 
         if (!mirrorUrl.isEmpty()) {
@@ -996,104 +1389,707 @@ void SystemWorker::run() {
         }
 
         qDebug() << "Using Arch bootstrap URL:" << bootstrapUrl;
+        if (!streamBootstrap(QUrl(bootstrapUrl)))
+            return false;
+    }
+    return true;
+}
 
-        if (!runCommand(QString("sudo wget -O /tmp/arch-bootstrap.tar.gz %1").arg(bootstrapUrl)))
-            return;
-        if (!runCommand("sudo tar -xzf /tmp/arch-bootstrap.tar.gz -C /mnt --strip-components=1"))
-            return;
+// Unpacks the bootstrap tarball into /mnt as it downloads; see TarStream
+bool SystemWorker::streamBootstrap(const QUrl &url)
+{
+    if (!CommandRunner::instance().isLive()) {
+        emit logMessage("Replay: not downloading the bootstrap tarball.");
+        return true;
+    }
+
+    emit logMessage(QString("Downloading and unpacking %1").arg(url.toString()));
+    InstallTrace::Span span(QStringLiteral("network"), QStringLiteral("bootstrap tarball"));
+    span.setArg(QStringLiteral("url"), url.toString());
+
+    TarStream stream(url, "/mnt", {"--strip-components=1"});
+    qint64 bytes = 0;
+    int lastLogged = 0;
+    QString error;
+    const bool ok = stream.run([&](qint64 received, qint64 total) {
+        bytes = received;
+        const int percent = total > 0 ? int(received * 100 / total) : 0;
+        if (percent >= lastLogged + 10) {
+            lastLogged = percent - percent % 10;
+            emit logMessage(QString("Bootstrap: %1 of %2 MiB unpacked")
+                                .arg(received >> 20).arg(total >> 20));
+        }
+    }, [this](const QString &msg) { emit logMessage(msg); }, &error);
+    span.setArg(QStringLiteral("bytes"), bytes);
+
+    if (!ok) {
+        emit errorOccurred("Bootstrap tarball: " + error);
+        return false;
     }
+    emit logMessage("Bootstrap unpacked into /mnt.");
+    return true;
+}
+
+// First Server of the target's mirrorlist: where a refresh fetches from
+static QString primaryMirror()
+{
+    QFile f("/mnt/etc/pacman.d/mirrorlist");
+    if (!f.open(QIODevice::ReadOnly))
+        return QString();
+    while (!f.atEnd()) {
+        const QString line = QString::fromUtf8(f.readLine()).trimmed();
+        if (line.startsWith("Server"))
+            return line.section('=', 1).trimmed();
+    }
+    return QString();
+}
 
-    runCommand("sudo arch-chroot /mnt pacman-key --init");
-    runCommand("sudo arch-chroot /mnt pacman-key --populate archlinux");
-    runCommand("sudo arch-chroot /mnt pacman -Sy --noconfirm archlinux-keyring");
+// Where syncDatabases() keeps the databases last fetched from mirror
+static QString snapshotDir(const QString &mirror)
+{
+    return kSyncSnapshots + "/"
+           + QCryptographicHash::hash(mirror.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+}
 
-    // Remove leftover firmware files from the live ISO to avoid conflicts
-    runCommand("sudo rm -rf /mnt/usr/lib/firmware/nvidia");
+// A snapshot directory with databases, refreshed within the window
+static bool isFreshSnapshot(const QString &dir, int windowMinutes)
+{
+    const QFileInfo stamp(dir + "/mirror");
+    if (windowMinutes <= 0 || !stamp.exists() || QDir(dir).entryList({"*.db"}, QDir::Files).isEmpty())
+        return false;
+    const qint64 ageSecs = stamp.lastModified().secsTo(QDateTime::currentDateTime());
+    return ageSecs >= 0 && ageSecs < windowMinutes * 60;
+}
 
-    emit logMessage("Installing base, linux, linux-firmware…");
-    // Reinstall the kernel even if the ISO's rootfs already contains the
-    // package so /boot/vmlinuz-linux is ensured to exist
-    if (!runCommand("sudo arch-chroot /mnt pacman -Sy --noconfirm --needed base linux linux-firmware"))
+// The install's only sync-database refresh; every later pacman call uses
+// -S/-Su against this snapshot. A refresh from the same mirror that is
+// younger than the snapshot window is copied in from the host instead.
+bool SystemWorker::syncDatabases()
+{
+    const QString mirror = primaryMirror();
+    const bool live = CommandRunner::instance().isLive();
+    const bool cacheable = live && !installsOffline() && m_syncWindowMinutes > 0 && !mirror.isEmpty();
+    const QString snapshot = snapshotDir(mirror);
+
+    if (cacheable && isFreshSnapshot(snapshot, m_syncWindowMinutes)) {
+        const qint64 ageSecs = QFileInfo(snapshot + "/mirror").lastModified().secsTo(QDateTime::currentDateTime());
+        QStringList paths;
+        for (const QString &db : QDir(snapshot).entryList({"*.db"}, QDir::Files))
+            paths << snapshot + "/" + db;
+        if (runCommand(QStringList{"cp", "-p", "--"} + paths + QStringList{"/mnt/var/lib/pacman/sync/"})) {
+            emit logMessage(QString("Reusing the sync databases fetched %1 min ago from %2.")
+                                .arg(ageSecs / 60).arg(mirror));
+            m_syncReused.storeRelease(1);
+            return true;
+        }
+    }
+    return refreshSyncDatabases();
+}
+
+// pacman -Sy, and a new snapshot of what it fetched
+bool SystemWorker::refreshSyncDatabases()
+{
+    m_syncReused.storeRelease(0);
+    const QString mirror = primaryMirror();
+    const bool cacheable = CommandRunner::instance().isLive() && !installsOffline()
+                           && m_syncWindowMinutes > 0 && !mirror.isEmpty();
+    const QString snapshot = snapshotDir(mirror);
+
+    InstallTrace::Span span(QStringLiteral("network"), QStringLiteral("sync databases"));
+    if (!runInTarget(pacmanCommand({"pacman", "-Sy"})))
+        return false;
+
+    if (cacheable) {
+        QDir(snapshot).removeRecursively();
+        QDir().mkpath(snapshot);
+        const QDir sync("/mnt/var/lib/pacman/sync");
+        QStringList paths;
+        for (const QString &db : sync.entryList({"*.db"}, QDir::Files))
+            paths << sync.filePath(db);
+        QFile f(snapshot + "/mirror");
+        if (!paths.isEmpty()
+            && runCommand(QStringList{"cp", "-p", "--"} + paths + QStringList{snapshot + "/"})
+            && f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            f.write(mirror.toUtf8() + '\n');
+    }
+    return true;
+}
+
+// A mirror that moved on since a reused snapshot was taken answers 404 for
+// the package versions it lists. A transaction against such databases
+// gets one fresh -Sy and a second try before it counts as failed.
+bool SystemWorker::runPacmanInTarget(const QStringList &argv)
+{
+    if (!m_syncReused.loadAcquire())
+        return runInTarget(argv);
+    if (runInTarget(argv, true))
+        return true;
+    emit logMessage("pacman failed against the reused sync databases; refreshing them and trying again.");
+    return refreshSyncDatabases() && runInTarget(argv);
+}
+
+bool SystemWorker::populateKeyring()
+{
+    {
+        InstallTrace::Span span(QStringLiteral("keyring"), QStringLiteral("init keyring"));
+        if (!runInTarget({"pacman-key", "--init"}) || !runInTarget({"pacman-key", "--populate", "archlinux"}))
+            return false;
+    }
+    // Kept apart from the main transaction: pacman checks every signature
+    // against the keyring it starts with, so a newer keyring has to land
+    // first or packages signed by new keys are rejected.
+    if (!runPacmanInTarget(pacmanCommand({"pacman", "-S", "--noconfirm", "--needed", "archlinux-keyring"})))
+        return false;
+    // Last chance for the shim before the big transaction
+    enableFsyncShim(true);
+    return true;
+}
+
+// Bind-mounts each non-empty host package cache read-only under
+// /mnt/var/cache/archaid; returns the in-target paths that got mounted
+QStringList SystemWorker::mountPackageCaches(const QStringList &hostDirs)
+{
+    const bool live = CommandRunner::instance().isLive();
+    QStringList mounted;
+    for (const QString &hostDir : hostDirs) {
+        if (live && QDir(hostDir).isEmpty())
+            continue;
+        const QString inTarget = QString("/var/cache/archaid/cache%1").arg(mounted.size());
+        if (live)
+            QDir().mkpath("/mnt" + inTarget);
+        if (CommandRunner::instance().execute("mount", {"--bind", "-o", "ro", hostDir, "/mnt" + inTarget}) != 0) {
+            emit logMessage("Could not use package cache " + hostDir);
+            continue;
+        }
+        emit logMessage("Using package cache " + hostDir);
+        mounted << inTarget;
+    }
+    return mounted;
+}
+
+void SystemWorker::unmountPackageCaches(const QStringList &mountPoints)
+{
+    for (const QString &inTarget : mountPoints) {
+        CommandRunner::instance().execute("umount", {"/mnt" + inTarget});
+        if (CommandRunner::instance().isLive())
+            QDir().rmdir("/mnt" + inTarget);
+    }
+    if (!mountPoints.isEmpty() && CommandRunner::instance().isLive())
+        QDir().rmdir("/mnt/var/cache/archaid");
+}
+
+// Copies the host's sync databases into the target where they are newer, so
+// the one -Sy of the install finds them current (pacman only fetches a
+// database the mirror has changed since the local copy's timestamp)
+void SystemWorker::seedSyncDatabases()
+{
+    if (!CommandRunner::instance().isLive())
+        return;
+    const QDir hostSync(kHostSyncDir);
+    QStringList newer;
+    for (const QFileInfo &db : hostSync.entryInfoList({"*.db"}, QDir::Files)) {
+        const QFileInfo target("/mnt/var/lib/pacman/sync/" + db.fileName());
+        if (!target.exists() || target.lastModified() < db.lastModified())
+            newer << db.absoluteFilePath();
+    }
+    if (newer.isEmpty())
+        return;
+    if (CommandRunner::instance().execute("cp", QStringList{"-p", "--"} + newer + QStringList{"/mnt/var/lib/pacman/sync/"}) == 0)
+        emit logMessage(QString("Reused %1 sync databases from the host.").arg(newer.size()));
+}
+
+// Copies packages the target downloaded into the host cache, so the next
+// install on this machine finds them there. Skipped when the host cache
+// can't take them (the archiso's cache lives in a small RAM overlay).
+void SystemWorker::writeBackPackages()
+{
+    if (!CommandRunner::instance().isLive() || !QDir(kHostPackageCache).exists())
         return;
 
-    // Ensure mkinitcpio presets do not reference the live ISO configuration
-    QString presetContent =
-        "# mkinitcpio preset file for the 'linux' package\n"
-        "ALL_config=\"/etc/mkinitcpio.conf\"\n"
-        "ALL_kver=\"/boot/vmlinuz-linux\"\n"
-        "\n"
-        "PRESETS=(\n"
-        "  default\n"
-        "  fallback\n"
-        ")\n"
-        "\n"
-        "default_image=\"/boot/initramfs-linux.img\"\n"
-        "fallback_image=\"/boot/initramfs-linux-fallback.img\"\n"
-        "fallback_options=\"-S autodetect\"\n";
-    QFile presetFile("/tmp/linux.preset");
-    if (presetFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        presetFile.write(presetContent.toUtf8());
-        presetFile.close();
-    }
-    runCommand("sudo cp /tmp/linux.preset /mnt/etc/mkinitcpio.d/linux.preset");
-
-    runCommand("sudo arch-chroot /mnt systemctl enable systemd-timesyncd.service");
-    runCommand("sudo arch-chroot /mnt rm -f /etc/mkinitcpio.conf.d/archiso.conf");
-    runCommand("sudo arch-chroot /mnt sed -i 's/archiso[^ ]* *//g' /etc/mkinitcpio.conf");
-    runCommand("sudo arch-chroot /mnt rm -f /boot/initramfs-linux*");
-    runCommand("sudo arch-chroot /mnt mkinitcpio -P");
-
-    runCommand("sudo arch-chroot /mnt bash -c 'echo archlinux > /etc/hostname'");
-    runCommand("sudo arch-chroot /mnt sed -i 's/^#en_US.UTF-8/en_US.UTF-8/' /etc/locale.gen");
-    runCommand("sudo arch-chroot /mnt locale-gen");
-    runCommand("sudo arch-chroot /mnt bash -c 'echo LANG=en_US.UTF-8 > /etc/locale.conf'");
-    runCommand("sudo arch-chroot /mnt ln -sf /usr/share/zoneinfo/UTC /etc/localtime");
-    runCommand("sudo arch-chroot /mnt hwclock --systohc");
-    runCommand("sudo arch-chroot /mnt mkdir -p /boot/grub");
-
-    emit logMessage("Installing GRUB…");
-    if (!runCommand("sudo arch-chroot /mnt pacman -Sy --noconfirm grub os-prober networkmanager dialog --needed"))
+    const QDir targetCache("/mnt/var/cache/pacman/pkg");
+    QStringList fresh;
+    qint64 bytes = 0;
+    for (const QFileInfo &pkg : targetCache.entryInfoList({"*.pkg.tar.*"}, QDir::Files)) {
+        if (pkg.fileName().endsWith(".part") || QFile::exists(kHostPackageCache + "/" + pkg.fileName()))
+            continue;
+        fresh << pkg.absoluteFilePath();
+        bytes += pkg.size();
+    }
+    if (fresh.isEmpty())
+        return;
+
+    const qint64 available = QStorageInfo(kHostPackageCache).bytesAvailable();
+    if (available < bytes + 512LL * 1024 * 1024) {
+        emit logMessage(QString("Not copying %1 MiB of new packages back to the host cache: only %2 MiB free.")
+                            .arg(bytes >> 20).arg(available >> 20));
+        return;
+    }
+    if (CommandRunner::instance().execute("cp", QStringList{"-n", "--"} + fresh + QStringList{kHostPackageCache + "/"}) == 0)
+        emit logMessage(QString("Copied %1 new packages back to the host cache.").arg(fresh.size()));
+}
+
+// The selected firmware, or the linux-firmware meta package when the synced
+// repositories predate the split packages
+QStringList SystemWorker::availableFirmware()
+{
+    bool split = false;
+    for (const QString &pkg : std::as_const(m_firmware))
+        split = split || pkg.startsWith("linux-firmware-");
+    if (!split)
+        return m_firmware;
+
+    QString answer;
+    captureInTarget({"bash", "-c", ProcessExecutor::shellJoin(pacmanCommand({"pacman", "-Si", HardwareProbe::firmwareBasePackage()}))
+                                       + " >/dev/null 2>&1 && echo split || echo meta"},
+                    &answer);
+    if (answer.trimmed() == "split")
+        return m_firmware;
+
+    emit logMessage("The repositories have no split firmware packages; installing linux-firmware.");
+    QStringList firmware{"linux-firmware"};
+    for (const QString &pkg : std::as_const(m_firmware)) {
+        if (!pkg.startsWith("linux-firmware"))
+            firmware << pkg;   // microcode
+    }
+    return firmware;
+}
+
+// The live rootfs carries every firmware and microcode package. Dropping the
+// unselected ones before the transaction also keeps -u from updating them.
+void SystemWorker::removeUnselectedFirmware(const QStringList &firmware)
+{
+    QString installed;
+    if (!captureInTarget({"pacman", "-Qq"}, &installed))
+        return;
+    const QStringList known = HardwareProbe::knownPackages();
+    QStringList unneeded;
+    for (const QString &pkg : installed.split('\n', Qt::SkipEmptyParts)) {
+        const QString name = pkg.trimmed();
+        if (known.contains(name) && !firmware.contains(name))
+            unneeded << name;
+    }
+    if (unneeded.isEmpty())
         return;
+    emit logMessage("Removing firmware this machine doesn't need: " + unneeded.join(' '));
+    // -dd: the linux-firmware meta package depends on every split package
+    runInTarget(pacmanCommand({"pacman", "-Rdd", "--noconfirm"} + unneeded));
+}
+
+// Base, kernel, bootloader tooling and desktop in one -Su transaction
+bool SystemWorker::installPackages()
+{
+    const QStringList firmware = availableFirmware();
+    const PackagePlan plan(desktopEnv, firmware);
+    if (!plan.isValid()) {
+        emit errorOccurred(QString("Unknown desktop environment: %1").arg(desktopEnv));
+        return false;
+    }
+
+    // Remove leftover firmware files from the live ISO to avoid conflicts.
+    // Split firmware is owned by its package and removed through pacman.
+    if (CommandRunner::instance().isLive() && firmware.contains("linux-firmware"))
+        QDir("/mnt/usr/lib/firmware/nvidia").removeRecursively();
+
+    // Naming any CacheDir on the command line replaces pacman.conf's, so the
+    // target's own cache goes first and stays the one new downloads land in
+    removeUnselectedFirmware(firmware);
+    deferBootHooks();
+    emit packageTransactionStarting();
+    QStringList argv = pacmanCommand(plan.transaction());
+    QStringList hostCaches = m_packageCaches;
+    if (m_reuseHostCache && QDir(kHostPackageCache).exists())
+        hostCaches << kHostPackageCache;
+    const QStringList caches = mountPackageCaches(hostCaches);
+    if (!caches.isEmpty()) {
+        argv << "--cachedir" << "/var/cache/pacman/pkg";
+        for (const QString &dir : caches)
+            argv << "--cachedir" << dir;
+    }
+
+    emit logMessage(QString("Installing %1 packages in one transaction…").arg(plan.packages().size()));
+    const bool installed = runPacmanInTarget(argv);
+    markBootFileDirty(Initramfs);
+    unmountPackageCaches(caches);
+    if (!installed)
+        return false;
+    if (m_reuseHostCache && !installsOffline())
+        writeBackPackages();
+    // Split firmware that came with the rootfs was a dependency of the meta
+    // package, which is gone now; left as a dependency it is an orphan, and
+    // the first "pacman -Rns $(pacman -Qdtq)" removes it
+    if (!firmware.isEmpty()
+        && !runInTarget(pacmanCommand(QStringList{"pacman", "-D", "--asexplicit"} + firmware), true))
+        emit logMessage(QString("Warning: could not mark %1 as explicitly installed; pacman lists them as "
+                                "orphans (pacman -Qdt) until they are marked with pacman -D --asexplicit.")
+                            .arg(firmware.join(' ')));
+
+    // The live rootfs has the kernel package registered but its /boot
+    // emptied, and --needed won't reinstall it
+    return runScriptInTarget(kInstallKernels + "[ -e /boot/vmlinuz-linux ]");
+}
+
+// Golden images -------------------------------------------------------------
+// The tree right after the package transaction is the same for every
+// install of one desktop and firmware set, so it is archived once and later
+// installs unpack it instead of running extraction and packages.
+// Locale, hostname, users, passwords, bootloader and fstab all come later.
+
+QByteArray SystemWorker::goldenImageKey(const QString &syncDir)
+{
+    const QString source = rootfsSource();
+    const QByteArray databases = GoldenImageCache::databaseDigest(syncDir);
+    if (source.isEmpty() || databases.isEmpty())
+        return QByteArray();
+    InstallTrace::Span span(QStringLiteral("golden"), QStringLiteral("digest rootfs source"));
+    const QByteArray digest = GoldenImageCache(m_goldenDir).fileDigest(source);
+    if (digest.isEmpty())
+        return QByteArray();
+    return GoldenImageCache::key(digest, PackagePlan(desktopEnv, m_firmware).packages(), databases);
+}
+
+// An image is only trusted while the sync snapshot it was built against is
+// within the snapshot window; past that the mirrors may have newer packages
+// and the install goes the long way
+QByteArray SystemWorker::findGoldenImage()
+{
+    if (m_goldenDir.isEmpty() || !m_offlineRepo.isEmpty() || !CommandRunner::instance().isLive())
+        return QByteArray();
+    const GoldenImageCache cache(m_goldenDir);
+    if (cache.isEmpty())
+        return QByteArray();
+    const QDir snapshots(kSyncSnapshots);
+    for (const QString &name : snapshots.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        const QString dir = snapshots.filePath(name);
+        if (!isFreshSnapshot(dir, m_syncWindowMinutes))
+            continue;
+        const QByteArray key = goldenImageKey(dir);
+        if (cache.contains(key))
+            return key;
+    }
+    return QByteArray();
+}
+
+bool SystemWorker::deployGoldenImage()
+{
+    const GoldenImageCache cache(m_goldenDir);
+    emit logMessage("Unpacking the golden image " + cache.imagePath(m_goldenKey));
+    QString error;
+    if (!cache.deploy("/mnt", m_goldenKey, &error)) {
+        emit errorOccurred("Golden image: " + error);
+        return false;
+    }
+    enableFsyncShim(false);
+    // The image carries no keyring: each machine gets its own master key
+    InstallTrace::Span span(QStringLiteral("keyring"), QStringLiteral("init keyring"));
+    if (!runInTarget({"pacman-key", "--init"}) || !runInTarget({"pacman-key", "--populate", "archlinux"}))
+        return false;
+    // Captured with the boot hooks masked and before this machine had an
+    // initramfs; the later pacman steps need the same masks
+    deferBootHooks();
+    markBootFileDirty(Initramfs);
+    return true;
+}
+
+// Runs between the package transaction and the first personalizing step.
+// A capture that fails only costs the next install its shortcut.
+bool SystemWorker::captureGoldenImage()
+{
+    if (m_goldenDir.isEmpty() || installsOffline() || !CommandRunner::instance().isLive())
+        return true;
+    if (m_fsyncShimInstalled)
+        return true;   // this tree carries libeatmydata for this install only
+    // findGoldenImage() only looks at fresh snapshots, so an image keyed on
+    // databases that never made it into one could not be found again
+    const QString snapshot = snapshotDir(primaryMirror());
+    if (!isFreshSnapshot(snapshot, m_syncWindowMinutes)
+        || GoldenImageCache::databaseDigest(snapshot) != GoldenImageCache::databaseDigest("/mnt/var/lib/pacman/sync"))
+        return true;
+    const QByteArray key = goldenImageKey(snapshot);
+    GoldenImageCache cache(m_goldenDir);
+    if (key.isEmpty() || cache.contains(key))
+        return true;
 
-    emit logMessage("Enabling NetworkManager to start at boot…");
-    if (!runCommand("sudo arch-chroot /mnt systemctl enable NetworkManager.service"))
-    return;
+    InstallTrace::Span span(QStringLiteral("golden"), QStringLiteral("capture golden image"));
+    emit logMessage("Saving the package tree as a golden image for later installs…");
+    QString error;
+    if (cache.capture("/mnt", key, &error))
+        emit logMessage("Golden image saved to " + cache.imagePath(key));
+    else
+        emit logMessage("Golden image not saved: " + error);
+    return true;
+}
+
+bool SystemWorker::configureBaseSystem()
+{
+    // Post-install configuration: file edits happen in-process on /mnt, the
+    // few steps that need target binaries share one session round-trip.
+    ConfigTransaction baseConfig;
+
+    // Ensure mkinitcpio presets do not reference the live ISO configuration;
+    // without these edits the initramfs can't boot the target, so they are fatal
+    baseConfig.writeFile("mkinitcpio preset", "/etc/mkinitcpio.d/linux.preset",
+                         "# mkinitcpio preset file for the 'linux' package\n"
+                         "ALL_config=\"/etc/mkinitcpio.conf\"\n"
+                         "ALL_kver=\"/boot/vmlinuz-linux\"\n"
+                         "\n"
+                         "PRESETS=(\n"
+                         "  default\n"
+                         "  fallback\n"
+                         ")\n"
+                         "\n"
+                         "default_image=\"/boot/initramfs-linux.img\"\n"
+                         "fallback_image=\"/boot/initramfs-linux-fallback.img\"\n"
+                         "fallback_options=\"-S autodetect\"\n", true);
+    TargetConfig::stripArchisoHooks(baseConfig);
+    baseConfig.removeMatching("remove live initramfs images", "/boot", "initramfs-linux*");
+    baseConfig.writeFile("hostname", "/etc/hostname", "archlinux\n");
+    baseConfig.replaceInFile("enable en_US.UTF-8 in locale.gen", "/etc/locale.gen",
+                             QRegularExpression("^#en_US.UTF-8", QRegularExpression::MultilineOption),
+                             "en_US.UTF-8");
+    baseConfig.writeFile("locale.conf", "/etc/locale.conf", "LANG=en_US.UTF-8\n");
+    baseConfig.symlink("localtime", "/usr/share/zoneinfo/UTC", "/etc/localtime");
+    baseConfig.replaceInFile("sudoers wheel group", "/etc/sudoers",
+                             QRegularExpression("^# %wheel ALL=\\(ALL:ALL\\) ALL", QRegularExpression::MultilineOption),
+                             "%wheel ALL=(ALL:ALL) ALL");
+    baseConfig.makeDir("grub directory", "/boot/grub");
+
+    baseConfig.run("enable systemd-timesyncd", {"systemctl", "enable", "systemd-timesyncd.service"});
+    baseConfig.run("enable NetworkManager", {"systemctl", "enable", "NetworkManager.service"});
+    baseConfig.run("locale-gen", {"locale-gen"});
+    baseConfig.run("hwclock", {"hwclock", "--systohc"});
+
+    const bool ok = commitTransaction(baseConfig, "Base system configuration");
+    markBootFileDirty(Initramfs);   // presets and hooks changed, even if only in part
+    return ok;
+}
 
-    runCommand("sudo arch-chroot /mnt sed -i '/2025-05-01-10-09-37-00/d' /etc/default/grub");
-    runCommand("sudo arch-chroot /mnt bash -c \"echo 'GRUB_DISABLE_LINUX_UUID=false' >> /etc/default/grub\"");
+bool SystemWorker::installBootloader()
+{
+    runInTarget({"sed", "-i", "/2025-05-01-10-09-37-00/d", "/etc/default/grub"});
+    runScriptInTarget("echo 'GRUB_DISABLE_LINUX_UUID=false' >> /etc/default/grub");
 
-    QString grubCmd;
+    QStringList grubCmd;
     if (useEfi) {
-        grubCmd = "sudo arch-chroot /mnt grub-install --target=x86_64-efi --efi-directory=/boot/efi --bootloader-id=GRUB";
+        grubCmd = QStringList{"grub-install", "--target=x86_64-efi", "--efi-directory=/boot/efi", "--bootloader-id=GRUB"};
     } else {
-        grubCmd = QString("sudo arch-chroot /mnt grub-install --target=i386-pc /dev/%1").arg(drive);
+        grubCmd = QStringList{"grub-install", "--target=i386-pc", QString("/dev/%1").arg(drive)};
     }
 
-    emit logMessage(grubCmd);
+    emit logMessage(ProcessExecutor::shellJoin(grubCmd));
 
-        if (!runCommand(grubCmd))
-        return;
+    if (!runInTarget(grubCmd))
+        return false;
 
-    if (!generateGrubWithOsProber())
-        return;
-    if (!runCommand("sudo arch-chroot /mnt pacman -Syu --noconfirm"))
-        return;
-    emit logMessage("System packages updated");
+    return generateGrubWithOsProber();
+}
 
+bool SystemWorker::createUsers()
+{
     emit logMessage("Adding user and configuring system.");
     emit logMessage("This will take a few…");
-    runCommand(QString("sudo arch-chroot /mnt useradd -m -G wheel %1").arg(username));
-    runCommand(QString("sudo arch-chroot /mnt bash -c \"echo '%1:%2' | chpasswd\"" ).arg(username, password));
-    runCommand(QString("sudo arch-chroot /mnt bash -c \"echo 'root:%1' | chpasswd\"" ).arg(rootPassword));
-    runCommand("sudo arch-chroot /mnt sed -i 's/^# %wheel ALL=(ALL:ALL) ALL/%wheel ALL=(ALL:ALL) ALL/' /etc/sudoers");
+    // Skip useradd when a resumed install already created the account
+    QFile passwd("/mnt/etc/passwd");
+    bool exists = false;
+    if (passwd.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        const QByteArray prefix = username.toUtf8() + ':';
+        while (!passwd.atEnd() && !exists)
+            exists = passwd.readLine().startsWith(prefix);
+        passwd.close();
+    }
+    if (!exists && !runInTarget({"useradd", "-m", "-G", "wheel", username}))
+        return false;
+    return setTargetPassword(username, password) && setTargetPassword("root", rootPassword);
+}
+
+// Masks the boot-file hooks by shadowing them in /etc/pacman.d/hooks with
+// links to /dev/null, the way pacman documents disabling a hook
+void SystemWorker::deferBootHooks()
+{
+    if (!CommandRunner::instance().isLive())
+        return;
+    QStringList hooks{kMkinitcpioHook};
+    for (const QString &name : QDir("/mnt/usr/share/libalpm/hooks").entryList({"*.hook"}, QDir::Files)) {
+        if (isDeferredHook(name) && !hooks.contains(name))
+            hooks << name;
+    }
+    QDir().mkpath("/mnt/etc/pacman.d/hooks");
+    for (const QString &name : std::as_const(hooks)) {
+        const QString path = "/mnt/etc/pacman.d/hooks/" + name;
+        if (!QFileInfo::exists(path) && !QFileInfo(path).isSymLink())
+            QFile::link("/dev/null", path);
+    }
+}
+
+// Removes only our masks, so hooks an admin overrides stay overridden
+void SystemWorker::restoreBootHooks()
+{
+    if (!CommandRunner::instance().isLive())
+        return;
+    const QDir dir("/mnt/etc/pacman.d/hooks");
+    for (const QFileInfo &hook : dir.entryInfoList({"*.hook"}, QDir::System | QDir::Files)) {
+        if (isDeferredHook(hook.fileName()) && hook.isSymLink() && hook.symLinkTarget() == "/dev/null")
+            QFile::remove(hook.absoluteFilePath());
+    }
+}
+
+// The final phase: each boot file that is stale (or missing, after a resumed
+// install) is built exactly once. Initramfs first, since grub-mkconfig lists
+// the images that exist when it runs.
+bool SystemWorker::regenerateBootFiles()
+{
+    restoreBootHooks();
+    const int dirty = m_dirtyBootFiles.fetchAndStoreOrdered(0);
+
+    if ((dirty & Initramfs) || !QFileInfo::exists("/mnt/boot/initramfs-linux.img")) {
+        InstallTrace::Span span(QStringLiteral("boot"), QStringLiteral("mkinitcpio"));
+        if (!runScriptInTarget(kInstallKernels))
+            return false;
+        if (!runInTarget({"mkinitcpio", "-P"}))
+            emit logMessage("mkinitcpio reported errors; check the initramfs images.");
+    }
+    if ((dirty & GrubConfig) || !QFileInfo::exists("/mnt/boot/grub/grub.cfg")) {
+        InstallTrace::Span span(QStringLiteral("boot"), QStringLiteral("grub-mkconfig"));
+        if (!runScriptInTarget(grubConfigScript()))
+            return false;
+        emit logMessage("GRUB menu generated with os-prober results.");
+    }
+    return true;
+}
 
-    if (!installDesktopAndDM()) return;
+void SystemWorker::run() {
+    emit logMessage("\xF0\x9F\x9A\x80 Starting system installation...");
 
-    runCommand("sudo arch-chroot /mnt bash -c 'rm -f /etc/fstab'");
-    runCommand("sudo bash -c 'genfstab -U /mnt > /mnt/etc/fstab'");
-    runCommand("sudo bash -c \"awk '!/^#|^$/{print; exit} 1' /mnt/etc/fstab > /mnt/etc/fstab.clean && mv /mnt/etc/fstab.clean /mnt/etc/fstab\"");
+    // Whatever path we leave by, the chroot sessions' mounts go away once
+    // and the timing trace gets written
+    struct SessionCloser {
+        SystemWorker *worker;
+        ~SessionCloser()
+        {
+            worker->restoreBootHooks();
+            worker->releaseFsyncShim();
+            worker->releaseOfflineRepository();
+            if (worker->m_suppressFsync)
+                worker->syncTarget();
+            worker->closeChrootSessions();
+            if (InstallTrace::write())
+                emit worker->logMessage(QString("Timing trace written to %1").arg(InstallTrace::defaultPath()));
+        }
+    } sessionCloser{this};
+    InstallTrace::setThreadName(QStringLiteral("system worker"));
+    InstallTrace::Span installSpan(QStringLiteral("install"), QStringLiteral("system installation"));
+
+    {
+        QMutexLocker locker(&m_targetLock);
+        if (!ensureTargetMounts())
+            return;
+    }
+
+    // Artifacts:  rootfs -> pacman -> keyring -> packages -> package-tree -> ...
+    // Resources:  "pacman" = the target's package database lock,
+    //             "accounts" = /etc/passwd & co. (pacman's sysusers hooks
+    //             write them too, so every pacman step holds it as well).
+    // Params and verify() feed the install journal: a step is skipped on a
+    // rerun only if its settings are unchanged and its results still exist.
+    InstallScheduler scheduler;
+    InstallJournal journal;
+    if (CommandRunner::instance().isLive()) {   // a replay must not trust the host's /mnt
+        // Without fsync nothing a step wrote is known to be on disk when its
+        // record is, so that mode starts from scratch and records nothing
+        if (m_suppressFsync)
+            journal.reset(journal.target());
+        else
+            scheduler.setJournal(&journal);
+    }
+    scheduler.setLogHandler([this](const QString &msg) { emit logMessage(msg); });
+
+    auto step = [&](const QString &name, const QStringList &inputs, const QStringList &outputs,
+                    const QStringList &resources, bool (SystemWorker::*fn)(),
+                    const QJsonObject &params, std::function<bool()> verify, bool checkpoint = true) {
+        InstallScheduler::Step s;
+        s.name = name;
+        s.inputs = inputs;
+        s.outputs = outputs;
+        s.resources = resources;
+        s.action = [this, fn]() { return (this->*fn)(); };
+        s.params = params;
+        s.verify = std::move(verify);
+        s.checkpoint = checkpoint;
+        scheduler.addStep(s);
+    };
+    auto exists = [](const QString &path) {
+        return [path]() { return QFileInfo::exists(path); };
+    };
+    const QStringList pacmanLock = {"pacman", "accounts"};
+
+    // "package-tree" is the target once every package is in, before anything
+    // machine-specific; a golden image provides it in one step
+    m_goldenKey = findGoldenImage();
+    if (!m_goldenKey.isEmpty()) {
+        emit logMessage("A golden image matches this install; skipping extraction and package installation.");
+        step("deploy golden image", {}, {"package-tree"}, pacmanLock,
+             &SystemWorker::deployGoldenImage, {{"image", QString::fromLatin1(m_goldenKey)}}, nullptr, false);
+    } else {
+        step("extract rootfs", {}, {"rootfs"}, {},
+             &SystemWorker::extractRootfs, {}, exists("/mnt/usr/lib/os-release"));
+        // Whether mirrors are needed at all is only known once the offline
+        // repository has passed or failed its dry run
+        QStringList rankInputs;
+        QStringList pacmanInputs = {"rootfs", "mirror-ranking"};
+        if (!m_offlineRepo.isEmpty()) {
+            step("offline repository", {"rootfs"}, {"offline-repo"}, {},
+                 &SystemWorker::prepareOfflineRepository, {}, nullptr, false);
+            rankInputs << "offline-repo";
+            pacmanInputs << "offline-repo";
+        }
+        // Network only, so without an offline repository it overlaps the
+        // extraction; rerun every time since mirror speeds don't keep
+        step("rank mirrors", rankInputs, {"mirror-ranking"}, {},
+             &SystemWorker::rankMirrors, {}, nullptr, false);
+        step("prepare pacman", pacmanInputs, {"pacman"}, {},
+             &SystemWorker::preparePacman, {{"mirror", customMirrorUrl}},
+             []() { return QFileInfo::exists("/mnt/usr/bin/pacman")
+                           && !QFileInfo("/mnt/var/lib/pacman").isSymLink(); });
+        // Always runs: a database snapshot from an earlier attempt may be stale
+        step("sync databases", {"pacman"}, {"sync-db"}, pacmanLock,
+             &SystemWorker::syncDatabases, {}, nullptr, false);
+        step("keyring", {"pacman", "sync-db"}, {"keyring"}, pacmanLock,
+             &SystemWorker::populateKeyring, {}, exists("/mnt/etc/pacman.d/gnupg/trustdb.gpg"));
+        step("packages", {"keyring"}, {"packages"}, pacmanLock,
+             &SystemWorker::installPackages, {{"packages", QJsonArray::fromStringList(PackagePlan(desktopEnv, m_firmware).packages())},
+                                              {"offline", m_offlineRepo}},
+             []() { return QFileInfo::exists("/mnt/boot/vmlinuz-linux")
+                           && QFileInfo::exists("/mnt/usr/bin/grub-install"); });
+        // No-op unless a golden image cache is set up; nothing may touch the
+        // tree while it is archived
+        step("capture golden image", {"packages"}, {"package-tree"}, pacmanLock,
+             &SystemWorker::captureGoldenImage, {}, nullptr, false);
+    }
+    step("base configuration", {"package-tree"}, {"base-config"}, {},
+         &SystemWorker::configureBaseSystem, {}, exists("/mnt/etc/locale.conf"));
+    step("bootloader", {"package-tree", "base-config"}, {"bootloader"}, {},
+         &SystemWorker::installBootloader, {{"efi", useEfi}, {"drive", drive}},
+         exists("/mnt/boot/grub/grubenv"));
+    // Cheap and idempotent; rerun so changed passwords are applied on a retry
+    step("users", {"package-tree"}, {"users"}, {"accounts"},
+         &SystemWorker::createUsers, {{"user", username}}, nullptr, false);
+    // pacman only for the Cinnamon terminal fallback
+    step("desktop", {"package-tree", "users"}, {"desktop"}, pacmanLock,
+         &SystemWorker::installDesktopAndDM, {{"desktop", desktopEnv}, {"user", username}}, nullptr);
+    step("fstab", {"package-tree"}, {"fstab"}, {},
+         &SystemWorker::writeTargetFstab, {}, nullptr, false);
+    // Everything that can leave the initramfs or GRUB menu stale comes first
+    step("boot files", {"package-tree", "base-config", "bootloader", "desktop"}, {"boot-files"}, {},
+         &SystemWorker::regenerateBootFiles, {},
+         []() { return QFileInfo::exists("/mnt/boot/initramfs-linux.img")
+                       && QFileInfo::exists("/mnt/boot/grub/grub.cfg"); });
+
+    emit logMessage(QString("Running install steps with %1 parallel job(s).").arg(m_jobs));
+    if (!scheduler.run(m_jobs)) {
+        if (scheduler.failedSteps().isEmpty())
+            emit errorOccurred(scheduler.errorString());   // graph problem, not a step failure
+        return;
+    }
 
     emit logMessage("\xE2\x9C\x85 All tasks completed");
     emit finished();
 }
-
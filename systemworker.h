@@ -1,14 +1,25 @@
 #ifndef SYSTEMWORKER_H
 #define SYSTEMWORKER_H
 
+#include <QAtomicInt>
+#include <QHash>
 #include <QObject>
+#include <QRecursiveMutex>
+#include <QSet>
 #include <QString>
 #include <QStringList>
+#include <QUrl>
+#include "chrootsession.h"
+#include "configtransaction.h"
+#include "mounttable.h"
+
+class QThread;
 
 class SystemWorker : public QObject {
     Q_OBJECT
 public:
     explicit SystemWorker(QObject *parent = nullptr);
+    ~SystemWorker() override;
 
     void setParameters(const QString &drive,
                        const QString &username,
@@ -17,11 +28,40 @@ public:
                        const QString &desktopEnv,
                        bool useEfi);
     void setCustomMirrorUrl(const QString &url) { customMirrorUrl = url; }
+    // Upper bound on install steps running at the same time
+    void setParallelJobs(int jobs);
+    // Host directory of already-downloaded packages, offered read-only to
+    // the target's pacman as an extra CacheDir
+    void addPackageCache(const QString &hostDir) { m_packageCaches << hostDir; }
+    // Seed the target from the host's own pacman cache and sync databases,
+    // and copy what the install downloads back into that cache
+    void setReuseHostCache(bool reuse) { m_reuseHostCache = reuse; }
+    // Install without network access, from the local repository at dir
+    // (see OfflineRepository), first adding whatever sourceDirs hold
+    void setOfflineRepository(const QString &dir, const QStringList &sourceDirs = QStringList());
+    // Run target commands with fsync() and friends turned into no-ops
+    // (libeatmydata preloaded) and sync the target once at the end. A crash
+    // part-way means starting over: the install journal isn't used.
+    void setSuppressFsync(bool suppress) { m_suppressFsync = suppress; }
+    // Firmware and microcode to install (see HardwareProbe); other firmware
+    // packages the live rootfs carries are removed from the target
+    void setFirmwarePackages(const QStringList &packages) { m_firmware = packages; }
+    // Sync databases fetched from the same mirror within this many minutes
+    // are reused instead of refreshed (0: always refresh)
+    void setSyncSnapshotWindow(int minutes) { m_syncWindowMinutes = minutes; }
+    // Keep the finished package tree in dir (see GoldenImageCache) and start
+    // later installs of the same system from it; empty disables
+    void setGoldenImageCache(const QString &dir) { m_goldenDir = dir; }
 
 signals:
     void logMessage(const QString &msg);
     void errorOccurred(const QString &msg);
     void finished();
+    // Emitted from the worker thread right before pacman starts downloading
+    void packageTransactionStarting();
+    // Rootfs extraction; unsquashfs reports only the percentage, the file
+    // count is that share of the image's inodes
+    void extractionProgress(int percent, quint32 estimatedFilesDone, quint32 filesTotal);
 
 public slots:
     void run();
@@ -32,8 +72,8 @@ private:
     QString m_targetPartition;  // <— add this single field
     QString normalizePartitionPath(const QString &in) const;
     void setTargetPartition(const QString &sel);
-    bool neutralizeLoginNoise();
-    bool runCommandCapture(const QString &command, QString *output);
+    void neutralizeLoginNoise(ConfigTransaction &tx);
+    bool runCommandCapture(const QStringList &argv, QString *output);
     bool applyLxqtIconTheme(const QString &user);
     bool installGrubRobust(const QString &targetDisk, bool efiInstall);
     QString customMirrorUrl;
@@ -45,9 +85,90 @@ private:
     QString desktopEnv;
     bool useEfi = false;
     bool generateGrubWithOsProber();
-    bool runCommand(const QString &cmd);
+    bool runCommand(const QStringList &argv);
+    // quiet: a failure is the caller's to report
+    bool runInTarget(const QStringList &argv, bool quiet = false);
+    bool runScriptInTarget(const QString &script);
+    bool commitTransaction(ConfigTransaction &tx, const QString &what);
+    bool captureInTarget(const QStringList &argv, QString *output);
+    bool setTargetPassword(const QString &user, const QString &secret);
+    bool finishTargetCommand(int code, const QString &display);
+    int runLoggedInSession(ChrootSession *session, const QString &command, const QString &recordAs = QString());
+    ChrootSession *prepareTarget();
+    bool writeTargetFstab();
+    ChrootSession *openChrootSession();
+    void retireChrootSessions();
+    void closeChrootSessions();
+
+    // Install steps (nodes of the graph built in run())
+    bool extractRootfs();
+    bool unsquash(const QString &image, qint64 offset, QString *error);
+    bool rankMirrors();
+    bool prepareOfflineRepository();
+    bool preparePacman();
+    bool streamBootstrap(const QUrl &url);
+    bool syncDatabases();
+    bool refreshSyncDatabases();
+    bool runPacmanInTarget(const QStringList &argv);
+    bool populateKeyring();
+    bool installPackages();
+    QByteArray goldenImageKey(const QString &syncDir);
+    QByteArray findGoldenImage();
+    bool deployGoldenImage();
+    bool captureGoldenImage();
+    QStringList availableFirmware();
+    void removeUnselectedFirmware(const QStringList &firmware);
+    bool configureBaseSystem();
+    bool installBootloader();
+    bool createUsers();
+    bool regenerateBootFiles();
+
+    // Boot files are rebuilt once, by regenerateBootFiles(); until then the
+    // pacman hooks that would rebuild them are masked and steps only mark
+    // what they made stale
+    enum BootFile { Initramfs = 1, GrubConfig = 2 };
+    void markBootFileDirty(BootFile file) { m_dirtyBootFiles.fetchAndOrOrdered(file); }
+    void deferBootHooks();
+    void restoreBootHooks();
+
+    QStringList mountPackageCaches(const QStringList &hostDirs);
+    void unmountPackageCaches(const QStringList &mountPoints);
+    void seedSyncDatabases();
+    void writeBackPackages();
+    void releaseOfflineRepository();
+    bool enableFsyncShim(bool allowInstall);
+    void releaseFsyncShim();
+    void syncTarget();
+    // argv with the offline pacman.conf added when installing offline
+    QStringList pacmanCommand(const QStringList &argv) const;
+    // An offline repository was asked for and passed its dry run (so far)
+    bool installsOffline() const { return !m_offlineRepo.isEmpty() && !m_offlineFallback.loadAcquire(); }
+
+    int m_jobs;
+    QStringList m_packageCaches;
+    bool m_reuseHostCache = false;
+    QString m_rankedMirrorlist;   // from rankMirrors(), written by preparePacman()
+    QString m_offlineRepo;
+    QStringList m_offlineSources;
+    QAtomicInt m_offlineFallback;  // set when the repository can't serve the install
+    QString m_pacmanConfig;       // in-target pacman.conf while the offline repo is mounted
+    bool m_suppressFsync = false;
+    QString m_fsyncShim;          // in-target path of the preloaded shim, once active
+    bool m_fsyncShimInstalled = false;   // came from pacman, removed again at the end
+    QAtomicInt m_dirtyBootFiles;
+    QStringList m_firmware{QStringLiteral("linux-firmware")};
+    int m_syncWindowMinutes = 60;
+    QAtomicInt m_syncReused;      // the target's sync databases came from a snapshot
+    QString m_goldenDir;
+    QByteArray m_goldenKey;       // image deployGoldenImage() unpacks
+    QRecursiveMutex m_targetLock;   // mount checks + session bookkeeping
+    ChrootSession m_chroot;  // owns the API mounts shared by all step shells
+    QHash<QThread *, ChrootSession *> m_threadSessions;
+    QSet<QThread *> m_staleSessions;   // shells still on mounts that went away
+    MountTable m_mounts;     // cached /proc/self/mountinfo
+    quint64 m_verifiedGeneration = 0;   // m_mounts generation the target was verified at
     bool ensureTargetMounts();
-    static bool isMountPoint(const QString &path);
+    bool isMountPoint(const QString &path);
 };
 
 #endif // SYSTEMWORKER_H
@@ -0,0 +1,24 @@
+#include "targetconfig.h"
+#include "configtransaction.h"
+#include <QRegularExpression>
+
+void TargetConfig::stripArchisoHooks(ConfigTransaction &tx)
+{
+    tx.removeMatching("drop archiso mkinitcpio drop-in", "/etc/mkinitcpio.conf.d", "archiso.conf", true);
+    // A hook ends at blanks, the end of its line or the closing parenthesis
+    // of HOOKS=(...); only the blanks after it go with it
+    tx.replaceInFile("strip archiso hooks", "/etc/mkinitcpio.conf",
+                     QRegularExpression("archiso[^ \\t\\n)]*[ \\t]*"), QString(), true);
+}
+
+void TargetConfig::setParallelDownloads(ConfigTransaction &tx, int downloads)
+{
+    // [ \t], not \s: a match must not run on into the next line
+    tx.replaceInFile("parallel downloads", "/etc/pacman.conf",
+                     QRegularExpression("^#?[ \\t]*ParallelDownloads[ \\t]*=.*$", QRegularExpression::MultilineOption),
+                     QString("ParallelDownloads = %1").arg(downloads));
+    tx.replaceInFile("parallel downloads (add)", "/etc/pacman.conf",
+                     QRegularExpression("^\\[options\\]\n(?![\\s\\S]*^ParallelDownloads)",
+                                        QRegularExpression::MultilineOption),
+                     QString("[options]\nParallelDownloads = %1\n").arg(downloads));
+}
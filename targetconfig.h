@@ -0,0 +1,21 @@
+#ifndef TARGETCONFIG_H
+#define TARGETCONFIG_H
+
+class ConfigTransaction;
+
+// Edits to configuration files the target inherits from the live image.
+//
+// The patterns have to cope with whatever layout the files come in, so they
+// live here rather than inline in SystemWorker, where they can be run against
+// a scratch tree (see tests/).
+class TargetConfig {
+public:
+    // Removes the archiso hooks from mkinitcpio.conf and its archiso drop-in;
+    // both steps are fatal, an initramfs built with them doesn't boot
+    static void stripArchisoHooks(ConfigTransaction &tx);
+    // Sets ParallelDownloads in pacman.conf, uncommenting an existing line or
+    // adding one under [options]
+    static void setParallelDownloads(ConfigTransaction &tx, int downloads);
+};
+
+#endif // TARGETCONFIG_H
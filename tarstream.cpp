@@ -0,0 +1,220 @@
+#include "tarstream.h"
+#include "processreactor.h"
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSocketNotifier>
+#include <QThread>
+#include <csignal>
+
+static const int kMaxResumes = 5;
+static const int kTransferTimeoutMs = 30000;
+// Bounds what Qt buffers ahead of tar when the disk is the slower side, and
+// what is queued for tar's stdin before reading from the reply pauses
+static const qint64 kReadBufferBytes = 4 * 1024 * 1024;
+static const int kOutputTail = 4096;
+
+TarStream::TarStream(const QUrl &url, const QString &destination, const QStringList &extraArgs)
+    : m_url(url), m_destination(destination), m_extraArgs(extraArgs) {}
+
+QStringList TarStream::tarCommand() const
+{
+    // tar can't sniff the compression of a pipe
+    const QString path = m_url.path();
+    QString compression;
+    if (path.endsWith(".gz") || path.endsWith(".tgz"))
+        compression = "--gzip";
+    else if (path.endsWith(".zst"))
+        compression = "--zstd";
+    else if (path.endsWith(".xz"))
+        compression = "--xz";
+
+    QStringList argv{"tar", "-x", "-f", "-"};
+    if (!compression.isEmpty())
+        argv << compression;
+    return argv + QStringList{"-C", m_destination} + m_extraArgs;
+}
+
+bool TarStream::run(const ProgressHandler &onProgress, const LogHandler &onLog, QString *error)
+{
+    ProcessReactor reactor;
+    int tar = 0;
+    bool tarDone = false;
+    ProcessExecutor::Result tarResult;
+    QByteArray tarOutput;
+
+    auto startTar = [&]() {
+        ProcessExecutor::Options opts;
+        opts.usePty = false;
+        opts.pipeStdin = true;
+        tarDone = false;
+        tarOutput.resize(0);
+        tar = reactor.start(tarCommand(), opts, [&](const char *data, qsizetype size) {
+            tarOutput.append(data, size);
+            if (tarOutput.size() > kOutputTail)
+                tarOutput.remove(0, tarOutput.size() - kOutputTail);
+        }, [&](const ProcessExecutor::Result &r) {
+            tarResult = r;
+            tarDone = true;
+        });
+        return tar > 0;
+    };
+    auto tarFailure = [&]() {
+        if (!tarResult.started)
+            return "tar could not be started: " + tarResult.error;
+        return QString("tar failed (exit %1): %2").arg(tarResult.exitCode)
+            .arg(QString::fromUtf8(tarOutput).trimmed());
+    };
+
+    if (!startTar()) {
+        *error = tarFailure();
+        return false;
+    }
+
+    QNetworkAccessManager nam;
+    qint64 received = 0;
+    qint64 total = -1;
+    QByteArray validator;   // ETag or Last-Modified of the first response
+    int resumes = 0;
+    bool ok = false;
+
+    for (;;) {
+        QNetworkRequest req(m_url);
+        req.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+        req.setTransferTimeout(kTransferTimeoutMs);
+        if (received > 0) {
+            req.setRawHeader("Range", "bytes=" + QByteArray::number(received) + "-");
+            if (!validator.isEmpty())
+                req.setRawHeader("If-Range", validator);
+        }
+        QNetworkReply *reply = nam.get(req);
+        reply->setReadBufferSize(kReadBufferBytes);
+
+        QEventLoop loop;
+        bool headersSeen = false;
+        bool fatal = false;
+        auto onHeaders = [&]() {
+            headersSeen = true;
+            const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (status == 200 && received > 0) {
+                // No resume: the server starts over, and so does tar
+                onLog("The server can't resume; unpacking from the start again.");
+                reactor.closeStdin(tar);
+                reactor.kill(tar, SIGTERM);
+                while (!tarDone && reactor.runOnce(-1)) {}
+                received = 0;
+                if (!startTar()) {
+                    *error = tarFailure();
+                    fatal = true;
+                }
+            } else if (status != 200 && status != 206) {
+                *error = QString("HTTP %1 for %2").arg(status).arg(m_url.toString());
+                fatal = true;
+            }
+            if (total < 0 && status == 200)
+                total = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+            else if (total < 0 && status == 206)
+                total = reply->rawHeader("Content-Range").split('/').value(1).toLongLong();
+            if (total <= 0)
+                total = -1;
+            if (validator.isEmpty()) {
+                validator = reply->rawHeader("ETag");
+                if (validator.isEmpty() || validator.startsWith("W/"))
+                    validator = reply->rawHeader("Last-Modified");
+            }
+            if (fatal)
+                reply->abort();
+        };
+
+        // Hands tar what the reply has buffered while tar keeps up. Past the
+        // limit the reply is left alone: its read buffer fills and the
+        // socket stops until tar catches up. Nothing here blocks, so tar's
+        // output is always read and tar can't stall on it.
+        auto pump = [&]() {
+            while (!fatal && reactor.pendingInput(tar) < kReadBufferBytes && reply->bytesAvailable() > 0) {
+                const QByteArray data = reply->read(kReadBufferBytes);
+                if (!reactor.write(tar, data)) {
+                    while (!tarDone && reactor.runOnce(-1)) {}
+                    *error = tarFailure();
+                    fatal = true;
+                    reply->abort();
+                    return;
+                }
+                received += data.size();
+                if (onProgress)
+                    onProgress(received, total);
+            }
+        };
+
+        QSocketNotifier tarEvents(reactor.pollFd(), QSocketNotifier::Read);
+        QObject::connect(&tarEvents, &QSocketNotifier::activated, &loop, [&]() {
+            reactor.runOnce(0);   // tar's output, its exit, queued input
+            if (!headersSeen || fatal)
+                return;
+            if (tarDone) {
+                // Gone before the end of its input
+                *error = tarFailure();
+                fatal = true;
+                reply->abort();
+                return;
+            }
+            pump();
+        });
+        QObject::connect(reply, &QNetworkReply::readyRead, &loop, [&]() {
+            if (!headersSeen)
+                onHeaders();
+            if (!fatal)
+                pump();
+        });
+        QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        tarEvents.setEnabled(false);
+
+        // The reply can finish with data still waiting behind a busy tar
+        while (!fatal && reply->bytesAvailable() > 0) {
+            pump();
+            if (!fatal && reply->bytesAvailable() > 0 && !reactor.runOnce(-1))
+                break;
+        }
+
+        if (!headersSeen && !fatal && reply->error() == QNetworkReply::NoError)
+            onHeaders();
+        const QNetworkReply::NetworkError netError = reply->error();
+        const QString netErrorString = reply->errorString();
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        reply->deleteLater();
+
+        if (fatal)
+            break;
+        if (netError == QNetworkReply::NoError && (total < 0 || received == total)) {
+            ok = true;
+            break;
+        }
+        // Client errors won't get better by asking again
+        if (status >= 400 && status < 500) {
+            *error = QString("HTTP %1 for %2").arg(status).arg(m_url.toString());
+            break;
+        }
+        if (++resumes > kMaxResumes) {
+            *error = "download failed: " + (netError != QNetworkReply::NoError
+                                                ? netErrorString : QStringLiteral("transfer cut short"));
+            break;
+        }
+        onLog(QString("Download interrupted at %1 MiB (%2); resuming.")
+                  .arg(received >> 20)
+                  .arg(netError != QNetworkReply::NoError ? netErrorString : QStringLiteral("cut short")));
+        QThread::msleep(1000 * resumes);
+    }
+
+    // End of input lets tar finish; after a failure it is stopped instead
+    reactor.closeStdin(tar);
+    if (!ok)
+        reactor.kill(tar, SIGTERM);
+    while (!tarDone && reactor.runOnce(-1)) {}
+    if (ok && (!tarResult.started || tarResult.exitCode != 0)) {
+        *error = tarFailure();
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,36 @@
+#ifndef TARSTREAM_H
+#define TARSTREAM_H
+
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <functional>
+
+// Downloads a compressed tarball and unpacks it while it arrives.
+//
+// The body goes from QNetworkAccessManager straight into tar's stdin; tar
+// runs the decompressor as its own process, so network, decompression and
+// disk writes overlap and nothing is staged on disk. A transfer that breaks
+// off resumes with a Range request (If-Range keeps it to the same file);
+// if the server sends the whole file again instead, tar is restarted on it.
+// Blocking; meant for a worker thread.
+class TarStream {
+public:
+    using ProgressHandler = std::function<void(qint64 received, qint64 total)>;   // total -1: unknown
+    using LogHandler = std::function<void(const QString &)>;
+
+    // tar -x -f - <compression> -C destination <extraArgs>; the compression
+    // flag is picked from the URL's suffix (.gz, .zst, .xz)
+    TarStream(const QUrl &url, const QString &destination, const QStringList &extraArgs = {});
+
+    bool run(const ProgressHandler &onProgress, const LogHandler &onLog, QString *error);
+
+private:
+    QStringList tarCommand() const;
+
+    QUrl m_url;
+    QString m_destination;
+    QStringList m_extraArgs;
+};
+
+#endif // TARSTREAM_H
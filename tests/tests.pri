@@ -0,0 +1,11 @@
+# Shared by the unit tests; each one builds the installer sources it needs
+# straight from the tree
+
+QT       += testlib
+QT       -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+ARCHAID_SRC = $$PWD/..
+INCLUDEPATH += $$ARCHAID_SRC
@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_configtransaction \
+    tst_isoimage \
+    tst_linesplitter \
+    tst_mirrorranker \
+    tst_mounttable \
+    tst_targetconfig
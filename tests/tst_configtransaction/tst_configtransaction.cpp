@@ -0,0 +1,111 @@
+#include "chrootsession.h"
+#include "configtransaction.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// File steps only: the session handed to commit() is never opened
+class TestConfigTransaction : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void fatalFailureStops();
+    void nonFatalFailureContinues();
+    void replaceFollowsTargetSymlink();
+    void writeReplacesSymlink();
+
+private:
+    QString host(const QString &path) const { return m_root->path() + path; }
+    bool writeFile(const QString &path, const QByteArray &content);
+    QByteArray readFile(const QString &path) const;
+    bool commit(ConfigTransaction &tx);
+
+    QScopedPointer<QTemporaryDir> m_root;
+};
+
+void TestConfigTransaction::init()
+{
+    m_root.reset(new QTemporaryDir);
+    QVERIFY(m_root->isValid());
+}
+
+bool TestConfigTransaction::writeFile(const QString &path, const QByteArray &content)
+{
+    QDir().mkpath(QFileInfo(host(path)).absolutePath());
+    QFile f(host(path));
+    return f.open(QIODevice::WriteOnly) && f.write(content) == content.size();
+}
+
+QByteArray TestConfigTransaction::readFile(const QString &path) const
+{
+    QFile f(host(path));
+    return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+}
+
+bool TestConfigTransaction::commit(ConfigTransaction &tx)
+{
+    ChrootSession session(m_root->path());
+    return tx.commit(session, nullptr);
+}
+
+void TestConfigTransaction::fatalFailureStops()
+{
+    ConfigTransaction tx(m_root->path());
+    tx.replaceInFile("missing", "/etc/missing.conf", QRegularExpression("a"), "b", true);
+    tx.writeFile("after", "/etc/after", "x\n");
+    QVERIFY(!commit(tx));
+
+    QCOMPARE(tx.results().size(), 2);
+    QVERIFY(tx.results().at(0).ran);
+    QVERIFY(!tx.results().at(0).ok);
+    QVERIFY(!tx.results().at(0).message.isEmpty());
+    QVERIFY(!tx.results().at(1).ran);
+    QVERIFY(!QFile::exists(host("/etc/after")));
+}
+
+void TestConfigTransaction::nonFatalFailureContinues()
+{
+    ConfigTransaction tx(m_root->path());
+    tx.replaceInFile("missing", "/etc/missing.conf", QRegularExpression("a"), "b");
+    tx.writeFile("after", "/etc/after", "x\n");
+    QVERIFY(commit(tx));
+
+    QVERIFY(!tx.results().at(0).ok);
+    QVERIFY(tx.results().at(1).ok);
+    QCOMPARE(readFile("/etc/after"), QByteArray("x\n"));
+}
+
+// An absolute link target is inside the target, not on the host
+void TestConfigTransaction::replaceFollowsTargetSymlink()
+{
+    QVERIFY(writeFile("/usr/share/app/app.conf", "Color=no\n"));
+    QVERIFY(QDir().mkpath(host("/etc")));
+    QVERIFY(QFile::link("/usr/share/app/app.conf", host("/etc/app.conf")));
+
+    ConfigTransaction tx(m_root->path());
+    tx.replaceInFile("color", "/etc/app.conf", QRegularExpression("^Color=no$", QRegularExpression::MultilineOption),
+                     "Color=yes", true);
+    QVERIFY(commit(tx));
+    QCOMPARE(readFile("/usr/share/app/app.conf"), QByteArray("Color=yes\n"));
+    QVERIFY(QFileInfo(host("/etc/app.conf")).isSymLink());
+}
+
+void TestConfigTransaction::writeReplacesSymlink()
+{
+    QVERIFY(writeFile("/usr/share/app/app.conf", "shared\n"));
+    QVERIFY(QDir().mkpath(host("/etc")));
+    QVERIFY(QFile::link("/usr/share/app/app.conf", host("/etc/app.conf")));
+
+    ConfigTransaction tx(m_root->path());
+    tx.writeFile("own copy", "/etc/app.conf", "local\n", true);
+    QVERIFY(commit(tx));
+    QVERIFY(!QFileInfo(host("/etc/app.conf")).isSymLink());
+    QCOMPARE(readFile("/etc/app.conf"), QByteArray("local\n"));
+    QCOMPARE(readFile("/usr/share/app/app.conf"), QByteArray("shared\n"));
+}
+
+QTEST_GUILESS_MAIN(TestConfigTransaction)
+#include "tst_configtransaction.moc"
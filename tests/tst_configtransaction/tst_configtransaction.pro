@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = tst_configtransaction
+
+SOURCES += \
+    tst_configtransaction.cpp \
+    $$ARCHAID_SRC/chrootsession.cpp \
+    $$ARCHAID_SRC/commandrunner.cpp \
+    $$ARCHAID_SRC/configtransaction.cpp \
+    $$ARCHAID_SRC/installtrace.cpp \
+    $$ARCHAID_SRC/linesplitter.cpp \
+    $$ARCHAID_SRC/processexecutor.cpp \
+    $$ARCHAID_SRC/processreactor.cpp
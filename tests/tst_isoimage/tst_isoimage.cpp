@@ -0,0 +1,198 @@
+#include "isoimage.h"
+#include <QtEndian>
+#include <QtTest>
+
+static const int kSector = 2048;
+
+// Sectors of the synthetic image
+enum { PrimaryVd = 16, Terminator = 17, RootDir = 18, ArchDir = 19, PlatformDir = 20, FileData = 21, ImageSectors = 24 };
+
+// A directory record (ECMA-119 9.1) with an optional System Use area
+static QByteArray record(const QByteArray &isoName, quint32 block, quint32 size, int flags,
+                         const QByteArray &systemUse = QByteArray())
+{
+    QByteArray r(33, '\0');
+    r += isoName;
+    if (isoName.size() % 2 == 0)
+        r += '\0';
+    r += systemUse;
+    if (r.size() % 2)
+        r += '\0';
+    r[0] = char(r.size());
+    qToLittleEndian<quint32>(block, r.data() + 2);
+    qToBigEndian<quint32>(block, r.data() + 6);
+    qToLittleEndian<quint32>(size, r.data() + 10);
+    qToBigEndian<quint32>(size, r.data() + 14);
+    r[25] = char(flags);
+    r[32] = char(isoName.size());
+    return r;
+}
+
+// Rock Ridge NM entry; flag 0x01: the name continues in the next one
+static QByteArray nm(const QByteArray &name, int flags = 0)
+{
+    QByteArray e("NM");
+    e += char(5 + name.size());
+    e += char(1);
+    e += char(flags);
+    e += name;
+    return e;
+}
+
+static QByteArray directory(quint32 self, quint32 parent, const QList<QByteArray> &entries)
+{
+    QByteArray d = record(QByteArray(1, '\0'), self, kSector, 0x02)
+                   + record(QByteArray(1, '\1'), parent, kSector, 0x02);
+    for (const QByteArray &e : entries)
+        d += e;
+    d.resize(kSector, '\0');
+    return d;
+}
+
+class TestIsoImage : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void rockRidgeName();
+    void caseInsensitive();
+    void continuedRockRidgeName();
+    void isoNameWithoutRockRidge_data();
+    void isoNameWithoutRockRidge();
+    void notAFile_data();
+    void notAFile();
+    void notAnIso();
+
+private:
+    IsoImage::Reader reader() const;
+
+    QByteArray m_image;
+};
+
+void TestIsoImage::initTestCase()
+{
+    m_image = QByteArray(ImageSectors * kSector, '\0');
+    auto put = [this](int sector, const QByteArray &data) {
+        m_image.replace(sector * kSector, data.size(), data);
+    };
+
+    QByteArray pvd(kSector, '\0');
+    pvd[0] = char(1);
+    pvd.replace(1, 5, "CD001");
+    qToLittleEndian<quint16>(kSector, pvd.data() + 128);
+    qToBigEndian<quint16>(kSector, pvd.data() + 130);
+    pvd.replace(156, 34, record(QByteArray(1, '\0'), RootDir, kSector, 0x02));
+    put(PrimaryVd, pvd);
+
+    QByteArray terminator(kSector, '\0');
+    terminator[0] = char(255);
+    terminator.replace(1, 5, "CD001");
+    put(Terminator, terminator);
+
+    put(RootDir, directory(RootDir, RootDir, {
+        record("ARCH", ArchDir, kSector, 0x02, nm("arch")),
+        record("README.TXT;1", FileData + 1, 11, 0),
+        record("VERSION.;1", FileData + 2, 5, 0),
+    }));
+    put(ArchDir, directory(ArchDir, RootDir, {
+        record("X86_64", PlatformDir, kSector, 0x02, nm("x86_64")),
+    }));
+    // 8.3 names that only the Rock Ridge name gets right
+    put(PlatformDir, directory(PlatformDir, ArchDir, {
+        record("AIROOTFS.SFS;1", FileData, 1234, 0, nm("airootfs.sfs")),
+        record("BOOTLOAD.EFI;1", FileData, 99, 0, nm("boot", 0x01) + nm("loader.efi")),
+        record("SPLIT.IMG;1", FileData, 4096, 0x80, nm("split.img")),
+    }));
+}
+
+IsoImage::Reader TestIsoImage::reader() const
+{
+    const QByteArray image = m_image;
+    return [image](qint64 offset, qint64 size, QByteArray *out) {
+        if (offset < 0 || offset + size > image.size())
+            return false;
+        *out = image.mid(offset, size);
+        return true;
+    };
+}
+
+void TestIsoImage::rockRidgeName()
+{
+    IsoImage iso(reader(), "test.iso");
+    QString error;
+    QVERIFY2(iso.open(&error), qPrintable(error));
+    const IsoImage::Extent e = iso.find("arch/x86_64/airootfs.sfs", &error);
+    QVERIFY2(e.isValid(), qPrintable(error));
+    QCOMPARE(e.offset, qint64(FileData) * kSector);
+    QCOMPARE(e.size, qint64(1234));
+}
+
+void TestIsoImage::caseInsensitive()
+{
+    IsoImage iso(reader(), "test.iso");
+    QVERIFY(iso.find("ARCH/X86_64/AIROOTFS.SFS").isValid());
+}
+
+void TestIsoImage::continuedRockRidgeName()
+{
+    IsoImage iso(reader(), "test.iso");
+    const IsoImage::Extent e = iso.find("arch/x86_64/bootloader.efi");
+    QVERIFY(e.isValid());
+    QCOMPARE(e.size, qint64(99));
+    QVERIFY(!iso.find("arch/x86_64/bootload.efi").isValid());
+}
+
+void TestIsoImage::isoNameWithoutRockRidge_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("sector");
+
+    QTest::newRow("version suffix") << "readme.txt" << int(FileData + 1);
+    QTest::newRow("trailing dot") << "version" << int(FileData + 2);
+}
+
+void TestIsoImage::isoNameWithoutRockRidge()
+{
+    QFETCH(QString, path);
+    QFETCH(int, sector);
+
+    IsoImage iso(reader(), "test.iso");
+    const IsoImage::Extent e = iso.find(path);
+    QVERIFY(e.isValid());
+    QCOMPARE(e.offset, qint64(sector) * kSector);
+}
+
+void TestIsoImage::notAFile_data()
+{
+    QTest::addColumn<QString>("path");
+
+    QTest::newRow("missing") << "arch/x86_64/initramfs-linux.img";
+    QTest::newRow("directory") << "arch/x86_64";
+    QTest::newRow("below a file") << "readme.txt/arch";
+    QTest::newRow("multi-extent") << "arch/x86_64/split.img";
+}
+
+void TestIsoImage::notAFile()
+{
+    QFETCH(QString, path);
+
+    IsoImage iso(reader(), "test.iso");
+    QString error;
+    QVERIFY(!iso.find(path, &error).isValid());
+    QVERIFY(!error.isEmpty());
+}
+
+void TestIsoImage::notAnIso()
+{
+    const QByteArray zeros(ImageSectors * kSector, '\0');
+    IsoImage iso([zeros](qint64 offset, qint64 size, QByteArray *out) {
+        *out = zeros.mid(offset, size);
+        return out->size() == size;
+    }, "zeros.img");
+    QString error;
+    QVERIFY(!iso.open(&error));
+    QVERIFY(!error.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestIsoImage)
+#include "tst_isoimage.moc"
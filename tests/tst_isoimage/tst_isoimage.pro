@@ -0,0 +1,7 @@
+include(../tests.pri)
+
+TARGET = tst_isoimage
+
+SOURCES += \
+    tst_isoimage.cpp \
+    $$ARCHAID_SRC/isoimage.cpp
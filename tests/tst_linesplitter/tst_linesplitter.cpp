@@ -0,0 +1,119 @@
+#include "linesplitter.h"
+#include <QtTest>
+
+class TestLineSplitter : public QObject {
+    Q_OBJECT
+
+private slots:
+    void splitsAcrossChunks();
+    void dropsCarriageReturn();
+    void capsCarriedLines();
+    void finishAndClear();
+    void batchesLines();
+    void flushesFullBlocks();
+    void flushesOnDestruction();
+
+private:
+    LineSplitter::LineHandler collect()
+    {
+        return [this](const char *data, qsizetype size) { m_lines << QByteArray(data, int(size)); };
+    }
+    void feed(LineSplitter &splitter, const QByteArray &chunk)
+    {
+        splitter.feed(chunk.constData(), chunk.size(), collect());
+    }
+
+    QList<QByteArray> m_lines;
+};
+
+void TestLineSplitter::splitsAcrossChunks()
+{
+    m_lines.clear();
+    LineSplitter splitter;
+    feed(splitter, "one\ntwo\nthr");
+    QCOMPARE(m_lines, QList<QByteArray>({"one", "two"}));
+    feed(splitter, "ee\n\nfo");
+    feed(splitter, "u");
+    splitter.finish(collect());
+    QCOMPARE(m_lines, QList<QByteArray>({"one", "two", "three", "", "fou"}));
+}
+
+void TestLineSplitter::dropsCarriageReturn()
+{
+    m_lines.clear();
+    LineSplitter splitter;
+    feed(splitter, "a\r\nb\r");
+    feed(splitter, "\n");
+    QCOMPARE(m_lines, QList<QByteArray>({"a", "b"}));
+}
+
+void TestLineSplitter::capsCarriedLines()
+{
+    m_lines.clear();
+    LineSplitter splitter(4);
+    // Complete within the chunk: handed out whole
+    feed(splitter, "abcdefghij\n");
+    // Carried over: cut into maxLine pieces as it grows
+    feed(splitter, "abcdefghij");
+    feed(splitter, "\n");
+    QCOMPARE(m_lines, QList<QByteArray>({"abcdefghij", "abcd", "efgh", "ij"}));
+}
+
+void TestLineSplitter::finishAndClear()
+{
+    m_lines.clear();
+    LineSplitter splitter;
+    splitter.finish(collect());
+    QVERIFY(m_lines.isEmpty());
+
+    feed(splitter, "partial");
+    splitter.clear();
+    feed(splitter, "next\n");
+    splitter.finish(collect());
+    QCOMPARE(m_lines, QList<QByteArray>({"next"}));
+}
+
+void TestLineSplitter::batchesLines()
+{
+    QStringList blocks;
+    LineBatcher batcher([&blocks](const QString &block) { blocks << block; });
+    batcher.flush();
+    QVERIFY(blocks.isEmpty());
+
+    batcher.add(QStringLiteral("first"));
+    batcher.add(" \t", 2);
+    batcher.add(QString::fromUtf8("zweite Zeile \xC3\xA4"));
+    QVERIFY(blocks.isEmpty());
+    batcher.flush();
+    QCOMPARE(blocks, QStringList{QString::fromUtf8("first\nzweite Zeile \xC3\xA4")});
+
+    // Only blank lines: nothing to hand on
+    batcher.add(QString());
+    batcher.flush();
+    QCOMPARE(blocks.size(), 1);
+}
+
+void TestLineSplitter::flushesFullBlocks()
+{
+    QStringList blocks;
+    LineBatcher batcher([&blocks](const QString &block) { blocks << block; }, 2);
+    batcher.add(QStringLiteral("a"));
+    batcher.add(QStringLiteral("b"));
+    batcher.add(QStringLiteral("c"));
+    QCOMPARE(blocks, QStringList{QStringLiteral("a\nb")});
+    batcher.flush();
+    QCOMPARE(blocks, QStringList({QStringLiteral("a\nb"), QStringLiteral("c")}));
+}
+
+void TestLineSplitter::flushesOnDestruction()
+{
+    QStringList blocks;
+    {
+        LineBatcher batcher([&blocks](const QString &block) { blocks << block; });
+        batcher.add(QStringLiteral("last words"));
+    }
+    QCOMPARE(blocks, QStringList{QStringLiteral("last words")});
+}
+
+QTEST_GUILESS_MAIN(TestLineSplitter)
+#include "tst_linesplitter.moc"
@@ -0,0 +1,7 @@
+include(../tests.pri)
+
+TARGET = tst_linesplitter
+
+SOURCES += \
+    tst_linesplitter.cpp \
+    $$ARCHAID_SRC/linesplitter.cpp
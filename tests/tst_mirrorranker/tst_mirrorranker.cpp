@@ -0,0 +1,207 @@
+#include "mirrorranker.h"
+#include <QNetworkProxy>
+#include <QRegularExpression>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtTest>
+#include <memory>
+
+// A mirror on 127.0.0.1 that answers every request with zeros, after a
+// header delay and at a throughput of chunkBytes per chunkIntervalMs.
+// Runs on the test thread; rank()'s event loop drives it.
+class StandIn : public QObject {
+public:
+    struct Behaviour {
+        int headerDelayMs = 0;
+        qint64 chunkBytes = 64 * 1024;
+        int chunkIntervalMs = 1;
+        bool honoursRange = true;
+        qint64 fileBytes = 4 * 1024 * 1024;
+    };
+
+    explicit StandIn(const Behaviour &behaviour) : m_behaviour(behaviour)
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket *socket = m_server.nextPendingConnection())
+                serve(socket);
+        });
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    bool isListening() const { return m_server.isListening(); }
+    QString server() const
+    {
+        return QString("http://127.0.0.1:%1/$repo/os/$arch").arg(m_server.serverPort());
+    }
+    // The whole response body went out
+    bool completedBody() const { return m_completed; }
+
+private:
+    void serve(QTcpSocket *socket)
+    {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        auto request = std::make_shared<QByteArray>();
+        connect(socket, &QTcpSocket::readyRead, socket, [this, socket, request]() {
+            if (request->endsWith("\r\n\r\n"))
+                return;   // already answering
+            *request += socket->readAll();
+            if (request->contains("\r\n\r\n"))
+                QTimer::singleShot(m_behaviour.headerDelayMs, socket, [this, socket, request]() {
+                    respond(socket, *request);
+                });
+        });
+    }
+
+    void respond(QTcpSocket *socket, const QByteArray &request)
+    {
+        static const QRegularExpression range(QStringLiteral("^Range: *bytes=0-(\\d+)\\r$"),
+                                              QRegularExpression::MultilineOption
+                                                  | QRegularExpression::CaseInsensitiveOption);
+        const QRegularExpressionMatch m = range.match(QString::fromLatin1(request));
+        const bool partial = m_behaviour.honoursRange && m.hasMatch();
+        const qint64 length = partial ? qMin(m.captured(1).toLongLong() + 1, m_behaviour.fileBytes)
+                                      : m_behaviour.fileBytes;
+        QByteArray headers = partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+        if (partial)
+            headers += "Content-Range: bytes 0-" + QByteArray::number(length - 1) + "/"
+                       + QByteArray::number(m_behaviour.fileBytes) + "\r\n";
+        headers += "Content-Length: " + QByteArray::number(length) + "\r\nConnection: close\r\n\r\n";
+        socket->write(headers);
+
+        auto left = std::make_shared<qint64>(length);
+        auto *timer = new QTimer(socket);
+        connect(timer, &QTimer::timeout, socket, [this, socket, timer, left]() {
+            if (socket->state() != QAbstractSocket::ConnectedState) {
+                timer->stop();
+                return;
+            }
+            const qint64 n = qMin(m_behaviour.chunkBytes, *left);
+            socket->write(QByteArray(int(n), '\0'));
+            *left -= n;
+            if (*left == 0) {
+                timer->stop();
+                m_completed = true;
+                socket->disconnectFromHost();
+            }
+        });
+        timer->start(m_behaviour.chunkIntervalMs);
+    }
+
+    Behaviour m_behaviour;
+    QTcpServer m_server;
+    bool m_completed = false;
+};
+
+class TestMirrorRanker : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void ranksByEstimatedFetchTime();
+    void cutsOffServersIgnoringRange();
+    void mirrorlistRoundTrip();
+    void parsesCommentedServers();
+};
+
+void TestMirrorRanker::initTestCase()
+{
+    // The stand-ins are local; an http_proxy from the environment must not apply
+    QNetworkProxy::setApplicationProxy(QNetworkProxy::NoProxy);
+}
+
+void TestMirrorRanker::ranksByEstimatedFetchTime()
+{
+    StandIn::Behaviour fastMirror;
+    StandIn::Behaviour slowMirror;
+    slowMirror.headerDelayMs = 150;
+    slowMirror.chunkBytes = 4 * 1024;
+    slowMirror.chunkIntervalMs = 10;
+    StandIn::Behaviour stalledMirror;
+    stalledMirror.headerDelayMs = 5000;
+
+    StandIn fast(fastMirror), slow(slowMirror), stalled(stalledMirror);
+    QVERIFY(fast.isListening() && slow.isListening() && stalled.isListening());
+
+    MirrorRanker ranker;
+    ranker.setCandidates({stalled.server(), slow.server(), fast.server()});
+    ranker.setTimeout(1000);
+    ranker.setSampleBytes(64 * 1024);
+    const QList<MirrorRanker::Probe> ranking = ranker.rank();
+
+    QCOMPARE(ranking.size(), 3);
+    QCOMPARE(ranking.at(0).server, fast.server());
+    QVERIFY(ranking.at(0).ok);
+    QCOMPARE(ranking.at(0).bytes, qint64(64 * 1024));
+
+    QCOMPARE(ranking.at(1).server, slow.server());
+    QVERIFY(ranking.at(1).ok);
+    QVERIFY(ranking.at(1).latencyUs >= 150 * 1000);
+    QVERIFY(ranking.at(1).estimatedSeconds() > ranking.at(0).estimatedSeconds());
+
+    QCOMPARE(ranking.at(2).server, stalled.server());
+    QVERIFY(!ranking.at(2).ok);
+    QCOMPARE(ranking.at(2).error, QStringLiteral("timed out"));
+}
+
+void TestMirrorRanker::cutsOffServersIgnoringRange()
+{
+    StandIn::Behaviour behaviour;
+    behaviour.honoursRange = false;
+    behaviour.chunkBytes = 16 * 1024;
+    behaviour.chunkIntervalMs = 5;
+    behaviour.fileBytes = 8 * 1024 * 1024;   // 2.5 s at that rate
+    StandIn mirror(behaviour);
+    QVERIFY(mirror.isListening());
+
+    MirrorRanker ranker;
+    ranker.setCandidates({mirror.server()});
+    ranker.setTimeout(2000);
+    ranker.setSampleBytes(64 * 1024);
+    const QList<MirrorRanker::Probe> ranking = ranker.rank();
+
+    QCOMPARE(ranking.size(), 1);
+    QVERIFY2(ranking.at(0).ok, qPrintable(ranking.at(0).error));
+    QVERIFY(ranking.at(0).bytes >= 64 * 1024);
+    QVERIFY(ranking.at(0).bytes < behaviour.fileBytes);
+    QVERIFY(!mirror.completedBody());
+}
+
+void TestMirrorRanker::mirrorlistRoundTrip()
+{
+    QList<MirrorRanker::Probe> ranking;
+    const QStringList servers = {"https://a.example/archlinux/$repo/os/$arch",
+                                 "https://b.example/$repo/os/$arch",
+                                 "http://c.example/arch/$repo/os/$arch"};
+    for (const QString &server : servers) {
+        MirrorRanker::Probe p;
+        p.server = server;
+        p.ok = true;
+        p.latencyUs = 40000;
+        p.bytes = 256 * 1024;
+        p.transferUs = 100000;
+        ranking << p;
+    }
+    MirrorRanker::Probe failed;
+    failed.server = "https://down.example/$repo/os/$arch";
+    failed.error = "timed out";
+    ranking << failed;
+
+    QCOMPARE(MirrorRanker::parseMirrorlist(MirrorRanker::formatMirrorlist(ranking, 10)), servers);
+    QCOMPARE(MirrorRanker::parseMirrorlist(MirrorRanker::formatMirrorlist(ranking, 2)), servers.mid(0, 2));
+    QVERIFY(MirrorRanker::formatMirrorlist({failed}, 10).isEmpty());
+}
+
+void TestMirrorRanker::parsesCommentedServers()
+{
+    const QString text = "## Germany\n"
+                         "#Server = https://a.example/$repo/os/$arch\n"
+                         "  # Server=https://b.example/$repo/os/$arch\n"
+                         "Server = https://a.example/$repo/os/$arch\n"
+                         "#Include = /etc/pacman.d/other\n";
+    QCOMPARE(MirrorRanker::parseMirrorlist(text),
+             QStringList({"https://a.example/$repo/os/$arch", "https://b.example/$repo/os/$arch"}));
+}
+
+QTEST_GUILESS_MAIN(TestMirrorRanker)
+#include "tst_mirrorranker.moc"
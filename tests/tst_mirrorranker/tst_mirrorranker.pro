@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+QT += network
+
+TARGET = tst_mirrorranker
+
+SOURCES += \
+    tst_mirrorranker.cpp \
+    $$ARCHAID_SRC/mirrorranker.cpp
@@ -0,0 +1,82 @@
+#include "mounttable.h"
+#include <QtTest>
+
+class TestMountTable : public QObject {
+    Q_OBJECT
+
+private slots:
+    void parsesFields();
+    void unescapesMountPoints();
+    void topmostMountWins();
+    void skipsMalformedLines();
+    void readsOwnNamespace();
+};
+
+void TestMountTable::parsesFields()
+{
+    const auto table = MountTable::parse(
+        "22 1 0:21 / / rw,relatime - ext4 /dev/sda2 rw\n"
+        "36 22 8:1 / /boot/efi rw,relatime shared:5 master:1 - vfat /dev/sda1 rw,fmask=0022\n");
+    QCOMPARE(table.size(), 2);
+
+    const MountTable::Entry root = table.value("/");
+    QCOMPARE(root.source, QStringLiteral("/dev/sda2"));
+    QCOMPARE(root.fsType, QStringLiteral("ext4"));
+    QCOMPARE(root.options, QStringLiteral("rw,relatime"));
+
+    // Any number of optional fields before the "-"
+    const MountTable::Entry esp = table.value("/boot/efi");
+    QCOMPARE(esp.mountPoint, QStringLiteral("/boot/efi"));
+    QCOMPARE(esp.source, QStringLiteral("/dev/sda1"));
+    QCOMPARE(esp.fsType, QStringLiteral("vfat"));
+}
+
+void TestMountTable::unescapesMountPoints()
+{
+    const auto table = MountTable::parse(
+        "40 22 8:3 / /mnt/my\\040disk rw - ext4 /dev/sdb1 rw\n"
+        "41 22 8:4 / /mnt/tab\\011and\\134slash rw - ext4 /dev/disk/by-label/a\\040b rw\n"
+        "42 22 8:5 / /mnt/not\\99octal rw - ext4 /dev/sdc1 rw\n");
+    QVERIFY(table.contains("/mnt/my disk"));
+    QCOMPARE(table.value("/mnt/my disk").source, QStringLiteral("/dev/sdb1"));
+    QVERIFY(table.contains("/mnt/tab\tand\\slash"));
+    QCOMPARE(table.value("/mnt/tab\tand\\slash").source, QStringLiteral("/dev/disk/by-label/a b"));
+    // Not an escape: kept as it is
+    QVERIFY(table.contains("/mnt/not\\99octal"));
+}
+
+void TestMountTable::topmostMountWins()
+{
+    const auto table = MountTable::parse(
+        "50 22 8:2 / /mnt rw - ext4 /dev/sda2 rw\n"
+        "51 50 0:30 / /mnt/proc rw - proc proc rw\n"
+        "52 22 8:17 / /mnt rw - btrfs /dev/sdb1 rw\n");
+    QCOMPARE(table.size(), 2);
+    QCOMPARE(table.value("/mnt").source, QStringLiteral("/dev/sdb1"));
+    QCOMPARE(table.value("/mnt").fsType, QStringLiteral("btrfs"));
+}
+
+void TestMountTable::skipsMalformedLines()
+{
+    const auto table = MountTable::parse(
+        "\n"
+        "60 22 8:2 / /short rw\n"
+        "61 22 8:2 / /nosource rw - ext4\n"
+        "62 22 8:2 / /ok rw - ext4 /dev/sda3 rw");
+    QCOMPARE(table.size(), 1);
+    QCOMPARE(table.value("/ok").source, QStringLiteral("/dev/sda3"));
+}
+
+void TestMountTable::readsOwnNamespace()
+{
+    MountTable table;
+    QVERIFY(table.isMountPoint("/"));
+    QVERIFY(table.generation() > 0);
+    const quint64 generation = table.generation();
+    // Nothing was mounted in between
+    QVERIFY(!table.refreshIfChanged());
+    QCOMPARE(table.generation(), generation);
+}
+
+QTEST_GUILESS_MAIN(TestMountTable)
+#include "tst_mounttable.moc"
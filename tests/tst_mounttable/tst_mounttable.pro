@@ -0,0 +1,7 @@
+include(../tests.pri)
+
+TARGET = tst_mounttable
+
+SOURCES += \
+    tst_mounttable.cpp \
+    $$ARCHAID_SRC/mounttable.cpp
@@ -0,0 +1,138 @@
+#include "chrootsession.h"
+#include "configtransaction.h"
+#include "targetconfig.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// The edits only hold file steps, so the session is never opened
+class TestTargetConfig : public QObject {
+    Q_OBJECT
+
+private slots:
+    void archisoHooks_data();
+    void archisoHooks();
+    void archisoDropIn();
+    void parallelDownloads_data();
+    void parallelDownloads();
+
+private:
+    static bool writeFile(const QString &path, const QByteArray &content);
+    static QByteArray readFile(const QString &path);
+    static bool commit(ConfigTransaction &tx, const QString &root);
+};
+
+bool TestTargetConfig::writeFile(const QString &path, const QByteArray &content)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile f(path);
+    return f.open(QIODevice::WriteOnly) && f.write(content) == content.size();
+}
+
+QByteArray TestTargetConfig::readFile(const QString &path)
+{
+    QFile f(path);
+    return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+}
+
+bool TestTargetConfig::commit(ConfigTransaction &tx, const QString &root)
+{
+    ChrootSession session(root);
+    return tx.commit(session, nullptr);
+}
+
+void TestTargetConfig::archisoHooks_data()
+{
+    QTest::addColumn<QByteArray>("original");
+    QTest::addColumn<QByteArray>("expected");
+
+    QTest::newRow("middle")
+        << QByteArray("HOOKS=(base udev archiso archiso_loop_mnt block filesystems)\n")
+        << QByteArray("HOOKS=(base udev block filesystems)\n");
+    QTest::newRow("before closing parenthesis")
+        << QByteArray("HOOKS=(base udev block archiso)\nCOMPRESSION=\"zstd\"\n")
+        << QByteArray("HOOKS=(base udev block )\nCOMPRESSION=\"zstd\"\n");
+    QTest::newRow("tabs")
+        << QByteArray("HOOKS=(base\tarchiso_pxe_common\tblock)\n")
+        << QByteArray("HOOKS=(base\tblock)\n");
+    QTest::newRow("end of line")
+        << QByteArray("HOOKS=(base archiso\n  block)\n")
+        << QByteArray("HOOKS=(base \n  block)\n");
+    QTest::newRow("no archiso")
+        << QByteArray("HOOKS=(base udev autodetect block filesystems fsck)\n")
+        << QByteArray("HOOKS=(base udev autodetect block filesystems fsck)\n");
+}
+
+void TestTargetConfig::archisoHooks()
+{
+    QFETCH(QByteArray, original);
+    QFETCH(QByteArray, expected);
+
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QVERIFY(writeFile(root.filePath("etc/mkinitcpio.conf"), original));
+
+    ConfigTransaction tx(root.path());
+    TargetConfig::stripArchisoHooks(tx);
+    QVERIFY(commit(tx, root.path()));
+    QCOMPARE(readFile(root.filePath("etc/mkinitcpio.conf")), expected);
+}
+
+void TestTargetConfig::archisoDropIn()
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QVERIFY(writeFile(root.filePath("etc/mkinitcpio.conf"), "HOOKS=(base udev)\n"));
+    QVERIFY(writeFile(root.filePath("etc/mkinitcpio.conf.d/archiso.conf"), "HOOKS+=(archiso)\n"));
+    QVERIFY(writeFile(root.filePath("etc/mkinitcpio.conf.d/local.conf"), "COMPRESSION=\"zstd\"\n"));
+
+    ConfigTransaction tx(root.path());
+    TargetConfig::stripArchisoHooks(tx);
+    QVERIFY(commit(tx, root.path()));
+    QVERIFY(!QFile::exists(root.filePath("etc/mkinitcpio.conf.d/archiso.conf")));
+    QVERIFY(QFile::exists(root.filePath("etc/mkinitcpio.conf.d/local.conf")));
+}
+
+void TestTargetConfig::parallelDownloads_data()
+{
+    QTest::addColumn<QByteArray>("original");
+    QTest::addColumn<QByteArray>("expected");
+
+    QTest::newRow("commented")
+        << QByteArray("[options]\n#ParallelDownloads = 5\nColor\n")
+        << QByteArray("[options]\nParallelDownloads = 3\nColor\n");
+    QTest::newRow("commented with space")
+        << QByteArray("[options]\n# ParallelDownloads = 5\nColor\n")
+        << QByteArray("[options]\nParallelDownloads = 3\nColor\n");
+    QTest::newRow("set")
+        << QByteArray("[options]\nParallelDownloads=10\n")
+        << QByteArray("[options]\nParallelDownloads = 3\n");
+    // The next line must survive an empty value
+    QTest::newRow("empty value")
+        << QByteArray("[options]\n#ParallelDownloads =\nColor\n")
+        << QByteArray("[options]\nParallelDownloads = 3\nColor\n");
+    QTest::newRow("missing")
+        << QByteArray("[options]\nHoldPkg = pacman glibc\n\n[core]\nInclude = /etc/pacman.d/mirrorlist\n")
+        << QByteArray("[options]\nParallelDownloads = 3\nHoldPkg = pacman glibc\n\n[core]\n"
+                      "Include = /etc/pacman.d/mirrorlist\n");
+}
+
+void TestTargetConfig::parallelDownloads()
+{
+    QFETCH(QByteArray, original);
+    QFETCH(QByteArray, expected);
+
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QVERIFY(writeFile(root.filePath("etc/pacman.conf"), original));
+
+    ConfigTransaction tx(root.path());
+    TargetConfig::setParallelDownloads(tx, 3);
+    QVERIFY(commit(tx, root.path()));
+    QCOMPARE(readFile(root.filePath("etc/pacman.conf")), expected);
+}
+
+QTEST_GUILESS_MAIN(TestTargetConfig)
+#include "tst_targetconfig.moc"